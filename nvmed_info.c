@@ -15,20 +15,62 @@
 
 struct nvmed_info_cmd main_cmds[] = {
 	{"identify", 1, "IDENTIFY Command", nvmed_info_identify},
+	{"publish", 2, "Publish Health to Shared Memory", nvmed_info_publish},
+	{"plm", 2, "Predictable Latency Mode", nvmed_info_plm},
 	{"pci", 1, "PCI Registers", nvmed_info_pci},
 	{"features", 1, "FEATURES Command", nvmed_info_features},
 	{"logs", 1, "LOG PAGES Command", nvmed_info_logs},
+	{"events", 1, "Asynchronous Events", nvmed_info_events},
+	{"advise", 2, "Tuning Advisors", nvmed_info_advise},
+	{"apst", 2, "APST Analysis", nvmed_info_apst},
+	{"thermal", 1, "Thermal Throttling and Thresholds", nvmed_info_thermal},
+	{"qos", 1, "Arbitration QoS Profiles", nvmed_info_qos},
+	{"serve", 3, "Query Server on a Unix Socket", nvmed_info_serve},
+	{"snapshot", 2, "Save a Snapshot", nvmed_info_snapshot},
+	{"directives", 3, "Directives and Streams", nvmed_info_directives},
+	{"diff", 1, "Changes since a Snapshot", nvmed_info_diff},
+	{"history", 1, "SMART History", nvmed_info_history},
 	{"all", 1, "Print All Information", nvmed_info_all},
 	{NULL, 0, NULL, NULL}
 };
 
-int dev_fd;
+// Commands that work on files alone and take the place of <device_path>
+struct nvmed_info_cmd file_cmds[] = {
+	{"diff", 4, "Changes between two Snapshots", nvmed_info_diff},
+	{"history", 7, "SMART History query and info", nvmed_info_history},
+	{NULL, 0, NULL, NULL}
+};
+
+// Commands that open only the handles they need; called with a NULL nvmed
+struct nvmed_info_cmd lazy_cmds[] = {
+	{"summary", 2, "Controller Summary, from sysfs first", nvmed_info_summary},
+	{"probe", 2, "Read Latency Probe on User-level Queues", nvmed_info_probe},
+	{NULL, 0, NULL, NULL}
+};
+
+NVMED_INFO *dev_info;
 
 int main (int argc, char **argv)
 {
 	NVMED	*nvmed;
 	char	*dev_path;
 	struct nvmed_info_cmd *c;
+	char	name[64], *fields = NULL;
+	int		i, j, profile = 0, rc = 0;
+
+	// --profile and --fields may appear anywhere after the device path
+	if (argc > 2) {
+		for (i = j = 2; i < argc; i++) {
+			if (!strcmp(argv[i], "--profile"))
+				profile = 1;
+			else if (!strcmp(argv[i], "--fields") && i + 1 < argc)
+				fields = argv[++i];
+			else
+				argv[j++] = argv[i];
+		}
+		argv[j] = NULL;
+		argc = j;
+	}
 
 	if (argc < 2)
 	{
@@ -36,14 +78,43 @@ int main (int argc, char **argv)
 		return -1;
 	}
 
+	c = cmd_lookup(file_cmds, argv[1]);
+	if (c)
+		return (c->cmd_fn(NULL, &argv[2]) < 0)? -1 : 0;
+
 	dev_path = argv[1];
-	nvmed = nvmed_open(dev_path, 0);
-	dev_fd = open(dev_path, O_RDWR);
-	if (nvmed == NULL || dev_fd < 0) {
+	dev_info = nvmed_info_ctx_open(dev_path);
+	if (dev_info == NULL) {
 		printf("%s: Cannot open the NVMe device \"%s\"\n", argv[0], dev_path);
 		return -1;
 	}
+	if (profile)
+		nvmed_info_prof_start(dev_info);
+
+	// Only the handles the requested fields need are opened
+	if (fields) {
+		rc = nvmed_info_fields(fields, &argv[2]);
+		if (profile)
+			nvmed_info_prof_report(dev_info, "fields");
+		nvmed_info_ctx_close(dev_info);
+		return (rc < 0)? -1 : 0;
+	}
 
+	c = (argc > 2)? cmd_lookup(lazy_cmds, argv[2]) : NULL;
+	if (c) {
+		rc = c->cmd_fn(NULL, &argv[3]);
+		if (profile)
+			nvmed_info_prof_report(dev_info, c->cmd_name);
+		nvmed_info_ctx_close(dev_info);
+		return (rc < 0)? -1 : 0;
+	}
+
+	nvmed = nvmed_info_ctx_nvmed(dev_info);
+	if (nvmed == NULL) {
+		printf("%s: Cannot open the NVMe device \"%s\"\n", argv[0], dev_path);
+		nvmed_info_ctx_close(dev_info);
+		return -1;
+	}
 
 	if (argc == 2) 
 		main_cmds[0].cmd_fn(nvmed, &argv[2]);
@@ -53,9 +124,13 @@ int main (int argc, char **argv)
 			return nvmed_info_usage(argv[1], argv[2]);
 		c->cmd_fn(nvmed, &argv[3]);
 	}
-	
-	nvmed_close(nvmed);
-	close(dev_fd);
+
+	if (profile) {
+		snprintf(name, sizeof(name), "%s%s%s", (argc > 2)? argv[2] : main_cmds[0].cmd_name,
+			(argc > 3)? " " : "", (argc > 3)? argv[3] : "");
+		nvmed_info_prof_report(dev_info, name);
+	}
+	nvmed_info_ctx_close(dev_info);
 	return 0;
 
 }
@@ -70,10 +145,15 @@ int nvmed_info_usage (char *arg0, char *invalid_cmd)
 
 	PRINT_NVMED_INFO;
 	printf("Usage: %s <device_path> <command> <args> ...\n", arg0);
+	printf("       %s diff <snapshot A> <snapshot B>\n", arg0);
+	printf("       %s history query|info|forecast <file> <args> ...\n", arg0);
+	printf("       %s <device_path> --fields <page.field>,... [--nsid N] [--plan]\n", arg0);
 	while (c->cmd_name) {
 		printf("\t%-12s\t%s\n", c->cmd_name, c->cmd_help);
 		c++;
 	}
+	for (c = lazy_cmds; c->cmd_name; c++)
+		printf("\t%-12s\t%s\n", c->cmd_name, c->cmd_help);
 
 	return -1;
 }
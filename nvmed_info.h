@@ -11,6 +11,7 @@ extern "C" {
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <errno.h>
+#include "nvmed_info_lib.h"
 
 #define NVMED_INFO_VERSION	"0.9"
 #define NVME_SPEC_VERSION	"1.2.1"
@@ -54,43 +55,98 @@ struct nvme_passthru_cmd {
 #define NVME_IOCTL_ADMIN_CMD	_IOWR('N', 0x41, struct nvme_admin_cmd)
 
 //extern char *nvme_sc[];
-extern int dev_fd;
+extern NVMED_INFO *dev_info;
 
 #define pow2(x)		(1 << (x))
 
-// CNS values for IDENTIFY command (Figure 86, p.96)
-#define CNS_NAMESPACE	0
-#define CNS_CONTROLLER	1
-
-#define FEATURE_SEL_CURRENT     (0)
-#define FEATURE_SEL_DEFAULT     (1 << 8)
-#define FEATURE_SEL_SAVED       (2 << 8)
-#define FEATURE_SEL_SUPPORTED   (3 << 8)
-
-#define FEATURE_ARBITRATION                     (0x01)
-#define FEATURE_POWER_MANAGEMENT                (0x02)
-#define FEATURE_LBA_RANGE_TYPE                  (0x03)
-#define FEATURE_TEMPERATURE_THRESHOLD           (0x04)
-#define FEATURE_ERROR_RECOVERY                  (0x05)
-#define FEATURE_VOLATILE_WRITE_CACHE            (0x06)
-#define FEATURE_NUMBER_OF_QUEUES                (0x07)
-#define FEATURE_INTERRUPT_COALESCING            (0x08)
-#define FEATURE_INTERRUPT_VECTOR_CONFIG         (0x09)
-#define FEATURE_WRITE_ATOMICITY_NORMAL          (0x0a)
-#define FEATURE_ASYNC_EVENT_CONFIG              (0x0b)
-#define FEATURE_AUTO_POWER_STATE_TRANSITION     (0x0c)
-#define FEATURE_HOST_MEMORY_BUFFER              (0x0d)
-#define FEATURE_KEEP_ALIVE_TIMER				(0x0f)
-#define FEATURE_SW_PROGRESS_MARKER              (0x80)
-#define FEATURE_HOST_IDENTIFIER                 (0x81)
-#define FEATURE_RESERVATION_NOTI_MASK			(0x82)
-#define FEATURE_RESERVATION_PERSISTENCE         (0x83)
-
-#define LOG_ERROR_INFO                          (0x01)
-#define LOG_SMART_INFO                          (0x02)
-#define LOG_FIRMWARE_SLOT_INFO                  (0x03)
-#define LOG_CHANGED_NAMESPACE_LIST              (0x04)
-#define LOG_COMMAND_EFFECTS                     (0x05)
+// A set of features applied as a whole by nvmed_info_feature_txn_apply()
+#define FEATURE_TXN_MAX			16
+#define FEATURE_TXN_DATA_MAX	256
+
+struct feature_txn {
+	int fid;
+	int datalen;
+	__u32 mask;							// bits of Dword 11 to be changed
+	__u32 value;
+	__u32 verify_mask;					// bits to be checked after applying
+	__u32 old;							// snapshot of the current value
+	__u32 saved;						// snapshot of the saved value
+	__u32 next;
+	int applied;
+	int has_data;						// next_data replaces the data structure
+	__u8 old_data[FEATURE_TXN_DATA_MAX];
+	__u8 saved_data[FEATURE_TXN_DATA_MAX];
+	__u8 next_data[FEATURE_TXN_DATA_MAX];
+};
+
+// Snapshot file: a header followed by the raw pages as returned by the device.
+// Header fields are little-endian.
+#define SNAPSHOT_MAGIC		"NVMEDSNP"
+#define SNAPSHOT_VERSION	1
+
+struct snapshot {
+	char magic[8];
+	__u32 version;
+	__u32 nsid;
+	__u64 time;							// seconds since the Epoch
+	__u8 ctrl[4096];					// IDENTIFY Controller
+	__u8 ns[4096];						// IDENTIFY Namespace
+	__u8 smart[512];					// SMART / Health Information
+	__u8 regs[64];						// Controller registers (BAR0)
+};
+
+// Fields compared by diff: where the field lives in the raw page, and where
+// its decoded value lives in the structure filled by the decoder.  Arrays
+// repeat count times, stride bytes apart in the page.
+enum { DIFF_U8, DIFF_U16, DIFF_U32, DIFF_U64, DIFF_INT, DIFF_STR, DIFF_BYTES };
+
+struct diff_field {
+	const char *name;
+	int off, len;
+	size_t member;
+	int type;
+	int hex;
+	int count, stride;
+	size_t member_stride;
+};
+
+// Phases of --profile
+#define PROF_DECODE			0
+#define PROF_ADMIN			1
+#define PROF_SYSFS			2
+#define PROF_OUTPUT			3
+#define PROF_PHASES			4
+
+// Pages known to nvmed_info_field_lookup()
+#define FIELD_PAGE_CONTROLLER	0
+#define FIELD_PAGE_NAMESPACE	1
+#define FIELD_PAGE_SMART		2
+#define FIELD_PAGE_REGS			3
+#define FIELD_PAGE_LINK			4
+
+// SMART history ring file: a page of header, the time index (one __u64 per
+// slot) and the slots.  Slots hold the raw SMART / Health page or, in the
+// compact format, struct nvmed_info_smart in host byte order.  Sequence
+// number n is stored in slot n % nslots.
+#define HISTORY_MAGIC		"NVMEDHST"
+#define HISTORY_VERSION		1
+#define HISTORY_RAW			0
+#define HISTORY_COMPACT		1
+
+struct history_header {
+	char magic[8];
+	__u32 version;
+	__u32 format;						// HISTORY_RAW or HISTORY_COMPACT
+	__u32 slot_size;					// bytes
+	__u32 nslots;
+	__u32 interval;						// seconds between samples
+	__u32 rsvd;
+	__u64 index_off;					// offset of the time index
+	__u64 data_off;						// offset of slot 0
+	__u64 first;						// oldest sequence number kept
+	__u64 next;							// next sequence number to be written
+	char sn[21];						// Serial Number of the drive
+};
 
 #define PCI_CAP_NEXT(id)	(((id) >> 8) & 0xff)
 #define PCI_CAP_CID(id)		((id) & 0xff)
@@ -144,17 +200,17 @@ extern int dev_fd;
 
 
 #define PH1(offset) \
-	_v = U8(offset); printf ("%04d       %02x           ", offset, p[offset]);
+	_v = U8(offset); P ("%04d       %02x           ", offset, p[offset]);
 
 #define PH2(offset) \
-	_v = U16(offset); printf ("%04d:%04d  %02x %02x        ", offset, offset+1, p[offset], p[offset+1]);
+	_v = U16(offset); P ("%04d:%04d  %02x %02x        ", offset, offset+1, p[offset], p[offset+1]);
 
 #define PH3(offset) \
 	_v = U32(offset) & 0x00ffffff; \
-	printf ("%04d:%04d  %02x %02x %02x     ", offset, offset+2, p[offset], p[offset+1], p[offset+2]);
+	P ("%04d:%04d  %02x %02x %02x     ", offset, offset+2, p[offset], p[offset+1], p[offset+2]);
 
 #define PH4(offset) \
-	_v = U32(offset); printf ("%04d:%04d  %02x %02x %02x %02x  ", offset, offset+3,  \
+	_v = U32(offset); P ("%04d:%04d  %02x %02x %02x %02x  ", offset, offset+3,  \
 			p[offset], p[offset+1], p[offset+2], p[offset+3]);
 
 #define F(start,end)	(__u32) ((end-start==31)? (_v) : (((_v) >> (start)) & ((1 << (end - start + 1)) - 1)))
@@ -186,14 +242,20 @@ extern int dev_fd;
 #endif
 
 
-#define P	printf
+// All output goes through P() so that --profile can time it
+#define P	nvmed_info_printf
 #define SP	' '
-#define S	printf("%26c", ' ')
-#define PRINT_NVMED_INFO	printf("nvmed_info version " NVMED_INFO_VERSION \
+#define S	P("%26c", ' ')
+#define PRINT_NVMED_INFO	P("nvmed_info version " NVMED_INFO_VERSION \
 								" (Compliant to NVMe Spec. " NVME_SPEC_VERSION ")\n\n")
 
 enum print_format { FORMAT_STRING, FORMAT_ID, FORMAT_VALUE };
 
+// Scope of an entry in the features[] and logs[] tables
+#define SCOPE_CONTROLLER	0
+#define SCOPE_NAMESPACE		1
+#define SCOPE_NVM_SET		2		// NVM Set ID in CDW11 (features) or the LSI (logs)
+
 #define PS(offset, end, title)	print_something(FORMAT_STRING, p, offset, end, title, NULL);
 #define PI(offset, end, title)	print_something(FORMAT_ID, p, offset, end, title, NULL);
 #define PV(offset, end, title, unit)	print_something(FORMAT_VALUE, p, offset, end, title, unit);
@@ -201,6 +263,7 @@ enum print_format { FORMAT_STRING, FORMAT_ID, FORMAT_VALUE };
 
 
 // Function prototypes
+extern NVMED *nvmed_info_ctx_nvmed (NVMED_INFO *ctx);
 extern struct nvmed_info_cmd *cmd_lookup (struct nvmed_info_cmd *list, char *str);
 extern int cmd_help (char *invalid_cmd, char *cmd_name, struct nvmed_info_cmd *c);
 extern int nvmed_info_admin_command (NVMED *nvmed, struct nvme_admin_cmd *cmd);
@@ -216,20 +279,33 @@ extern void nvmed_info_identify_parse_namespace (__u8 *p, int nsid);
 extern int nvmed_info_features (NVMED *nvmed, char **cmd_args);
 extern int nvmed_info_features_help (char *s);
 extern int nvmed_info_get_features_issue (NVMED *nvmed, int fid, int nsid, __u8 *p, int len, __u32 *result);
+extern int nvmed_info_get_features_ext_issue (NVMED *nvmed, int fid, int sel, int nsid, __u32 cdw11, __u8 *p, int len, __u32 *result);
+extern int nvmed_info_set_features_issue (NVMED *nvmed, int fid, int nsid, __u32 cdw11, int save, __u8 *p, int len, __u32 *result);
+extern int nvmed_info_feature_txn_add (struct feature_txn *txn, int *n, int fid, __u32 mask, __u32 value);
+extern int nvmed_info_feature_txn_apply (NVMED *nvmed, struct feature_txn *txn, int n, int save);
+extern int nvmed_info_set_features (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_features_save_supported (NVMED *nvmed);
+extern int nvmed_info_features_drift (NVMED *nvmed, char **cmd_args);
+extern void nvmed_info_print_apst_table (__u8 *p);
 extern int nvmed_info_get_features (NVMED *nvmed, char **cmd_args);
 extern void print_something (enum print_format format, __u8 *p, int offset, int len, char *title, char *unit);
 extern int nvmed_info_logs (NVMED *nvmed, char **cmd_args);
 extern int nvmed_info_logs_help (char *s);
 extern int nvmed_info_get_logs_issue (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 *result);
+extern int nvmed_info_get_logs_ext_issue (NVMED *nvmed, int logid, int lsi, __u8 *p, int len, __u32 *result);
 extern int nvmed_info_get_logs (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_logs_print (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 res);
 extern int nvmed_info_logs_error (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
 extern int nvmed_info_logs_smart (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
 extern int nvmed_info_logs_firmware (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
 extern int nvmed_info_logs_namespace (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
 extern int nvmed_info_logs_command (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
+extern int nvmed_info_logs_plm (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
+extern int nvmed_info_logs_plm_aggregate (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 result);
 extern int nvmed_info_pci (NVMED *nvmed, char **cmd_args);
 extern int nvmed_info_pci_config (NVMED *nvmed, char **cmd_args);
 extern int nvmed_info_pci_nvme (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_pci_cmb (NVMED *nvmed, char **cmd_args);
 extern int nvmed_info_pci_help (char *s);
 extern int nvmed_info_pci_open (NVMED *nvmed, char *name, int type, struct pci_info *pci);
 extern int nvmed_info_pci_close (struct pci_info *pci);
@@ -240,6 +316,71 @@ extern void nvmed_info_pci_parse_msicap (NVMED *nvmed, struct pci_info *pci, int
 extern void nvmed_info_pci_parse_msixcap (NVMED *nvmed, struct pci_info *pci, int offset);
 extern void nvmed_info_pci_parse_pxcap (NVMED *nvmed, struct pci_info *pci, int offset);
 extern void nvmed_info_pci_parse_nvme (NVMED *nvmed, struct pci_info *pci);
+extern int nvmed_info_advise (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_advise_help (char *s);
+extern int nvmed_info_advise_queues (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_advise_io (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_advise_format (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_advise_hmb (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_plm (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_plm_help (char *s);
+extern int nvmed_info_plm_status (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_plm_monitor (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_plm_enable (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_plm_disable (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_plm_window (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_directives (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_directives_help (char *s);
+extern int nvmed_info_directives_status (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_directives_enable (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_directives_disable (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_directives_allocate (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_directives_release (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_thermal (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_thermal_help (char *s);
+extern int nvmed_info_thermal_report (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_thermal_set (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_thermal_reset (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_qos (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_qos_help (char *s);
+extern int nvmed_info_qos_status (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_qos_profile (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_apst (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_apst_help (char *s);
+extern int nvmed_info_apst_analyze (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_apst_generate (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_apst_build (struct power_state *ps, int n, long budget_us, long idle_ms, __u8 *table);
+extern int nvmed_info_apst_read (NVMED *nvmed, __u8 *apst, struct power_state *ps, __u32 *apstres);
+extern double nvmed_info_power_state_watts (struct power_state *ps);
+extern int nvmed_info_snapshot (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_snapshot_capture (NVMED *nvmed, int nsid, struct snapshot *s);
+extern int nvmed_info_snapshot_load (char *path, struct snapshot *s);
+extern int nvmed_info_diff (NVMED *nvmed, char **cmd_args);
+extern struct diff_field *nvmed_info_smart_field (const char *name, int *i);
+extern struct diff_field *nvmed_info_field_lookup (const char *name, int *page, int *i);
+extern int nvmed_info_field_page_len (int page);
+extern int nvmed_info_field_format (int page, const __u8 *raw, struct diff_field *f, int i, char *out, int len);
+extern __u64 nvmed_info_diff_value (const __u8 *d, int type);
+extern int nvmed_info_history (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_history_help (char *s);
+extern int nvmed_info_history_record (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_history_query (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_history_info (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_history_forecast (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_publish (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_events (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_serve (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_fields (char *list, char **cmd_args);
+extern int nvmed_info_summary (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_probe (NVMED *nvmed, char **cmd_args);
+extern int nvmed_info_profiling;
+extern int nvmed_info_printf (const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
+extern void nvmed_info_prof_enter (int phase);
+extern void nvmed_info_prof_leave (void);
+extern void nvmed_info_prof_start (NVMED_INFO *ctx);
+extern void nvmed_info_prof_report (NVMED_INFO *ctx, const char *cmd);
+extern long nvmed_info_opt_long (char **cmd_args, char *name, long def);
+extern int nvmed_info_opt_flag (char **cmd_args, char *name);
 extern void print_bytes (__u8 *p, int len);
 
 #endif /* _NVMED_INFO_H */
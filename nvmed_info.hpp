@@ -0,0 +1,380 @@
+// nvmed_info.hpp: header-only C++17 typed views of NVMe pages and registers.
+//
+// A view wraps a pointer to a raw page (IDENTIFY, SMART log, BAR0 or PCI
+// config space) and decodes fields on access.  Every field is a type that
+// carries its byte offset and bit range as compile-time constants, so an
+// access compiles to a load, a shift and a mask.  Loads assemble bytes in
+// little-endian order, which is safe on any host endianness and for any
+// alignment; compilers fold them into a single load on little-endian hosts.
+//
+// Example:
+//	nvmed_info::identify_controller id(page);
+//	unsigned mdts = id.get<nvmed_info::identify_controller::MDTS>();
+//	auto ps3 = id.power_state(3);
+//	unsigned wake_us = ps3.enlat() + ps3.exlat();
+
+#ifndef _NVMED_INFO_HPP
+#define _NVMED_INFO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace nvmed_info {
+
+template <typename T>
+constexpr T load_le (const std::uint8_t *p) noexcept
+{
+	static_assert(std::is_unsigned<T>::value, "fields are unsigned");
+	T v = 0;
+	for (std::size_t i = 0; i < sizeof(T); i++)
+		v |= static_cast<T>(static_cast<T>(p[i]) << (8 * i));
+	return v;
+}
+
+// Bits [Lo,Hi] of the little-endian Storage at byte Offset
+template <std::size_t Offset, typename Storage, unsigned Lo = 0, unsigned Hi = sizeof(Storage) * 8 - 1>
+struct field {
+	static_assert(std::is_unsigned<Storage>::value, "storage must be unsigned");
+	static_assert(Lo <= Hi && Hi < sizeof(Storage) * 8, "bit range out of the storage");
+
+	using storage_type = Storage;
+	static constexpr std::size_t offset = Offset;
+	static constexpr std::size_t end = Offset + sizeof(Storage);
+	static constexpr unsigned lo = Lo;
+	static constexpr unsigned hi = Hi;
+	static constexpr unsigned width = Hi - Lo + 1;
+	static constexpr Storage mask = (width == sizeof(Storage) * 8) ?
+		static_cast<Storage>(~Storage(0)) : static_cast<Storage>((Storage(1) << (width % (sizeof(Storage) * 8))) - 1);
+
+	static constexpr Storage get (const std::uint8_t *p) noexcept
+	{
+		return static_cast<Storage>((load_le<Storage>(p + Offset) >> Lo) & mask);
+	}
+};
+
+template <std::size_t Offset, unsigned Bit, typename Storage = std::uint8_t>
+using flag = field<Offset, Storage, Bit, Bit>;
+
+// 128-bit little-endian counter of SMART / Health and IDENTIFY
+struct u128 {
+	std::uint64_t lo;
+	std::uint64_t hi;
+
+	constexpr std::uint64_t saturated () const noexcept { return hi ? ~std::uint64_t(0) : lo; }
+};
+
+template <std::size_t Offset>
+struct field128 {
+	static constexpr std::size_t offset = Offset;
+	static constexpr std::size_t end = Offset + 16;
+
+	static constexpr u128 get (const std::uint8_t *p) noexcept
+	{
+		return u128{ load_le<std::uint64_t>(p + Offset), load_le<std::uint64_t>(p + Offset + 8) };
+	}
+};
+
+// Base of all views; Size is the length of the underlying page or register block
+template <std::size_t Size>
+class view {
+public:
+	static constexpr std::size_t size = Size;
+
+	constexpr explicit view (const std::uint8_t *p) noexcept : p_(p) {}
+	explicit view (const void *p) noexcept : p_(static_cast<const std::uint8_t *>(p)) {}
+
+	template <typename F>
+	constexpr auto get () const noexcept
+	{
+		static_assert(F::end <= Size, "field lies outside of the view");
+		return F::get(p_);
+	}
+
+	constexpr const std::uint8_t *data () const noexcept { return p_; }
+
+protected:
+	const std::uint8_t *p_;
+};
+
+
+// Power State Descriptor (Figure 91)
+class power_state_descriptor : public view<32> {
+public:
+	using view::view;
+
+	using MP    = field<0, std::uint16_t>;
+	using MXPS  = flag<3, 0>;
+	using NOPS  = flag<3, 1>;
+	using ENLAT = field<4, std::uint32_t>;
+	using EXLAT = field<8, std::uint32_t>;
+	using RRT   = field<12, std::uint8_t, 0, 4>;
+	using RRL   = field<13, std::uint8_t, 0, 4>;
+	using RWT   = field<14, std::uint8_t, 0, 4>;
+	using RWL   = field<15, std::uint8_t, 0, 4>;
+	using IDLP  = field<16, std::uint16_t>;
+	using IPS   = field<18, std::uint8_t, 6, 7>;
+	using ACTP  = field<20, std::uint16_t>;
+	using APW   = field<22, std::uint8_t, 0, 2>;
+	using APS   = field<22, std::uint8_t, 6, 7>;
+
+	constexpr std::uint32_t enlat () const noexcept { return get<ENLAT>(); }
+	constexpr std::uint32_t exlat () const noexcept { return get<EXLAT>(); }
+	constexpr bool non_operational () const noexcept { return get<NOPS>(); }
+	// in units of 0.0001 W
+	constexpr std::uint32_t max_power_100uw () const noexcept { return get<MP>() * (get<MXPS>() ? 1u : 100u); }
+};
+
+// IDENTIFY Controller data structure (Figure 90)
+class identify_controller : public view<4096> {
+public:
+	using view::view;
+
+	using VID     = field<0, std::uint16_t>;
+	using SSVID   = field<2, std::uint16_t>;
+	using RAB     = field<72, std::uint8_t>;
+	using CMIC    = field<76, std::uint8_t>;
+	using MDTS    = field<77, std::uint8_t>;
+	using CNTLID  = field<78, std::uint16_t>;
+	using VER     = field<80, std::uint32_t>;
+	using RTD3R   = field<84, std::uint32_t>;
+	using RTD3E   = field<88, std::uint32_t>;
+	using OAES    = field<92, std::uint32_t>;
+	using CTRATT  = field<96, std::uint32_t>;
+	using OACS    = field<256, std::uint16_t>;
+	using OACS_FORMAT = flag<256, 1, std::uint16_t>;
+	using ACL     = field<258, std::uint8_t>;
+	using AERL    = field<259, std::uint8_t>;
+	using FRMW    = field<260, std::uint8_t>;
+	using LPA     = field<261, std::uint8_t>;
+	using ELPE    = field<262, std::uint8_t>;
+	using NPSS    = field<263, std::uint8_t>;
+	using APSTA   = flag<265, 0>;
+	using WCTEMP  = field<266, std::uint16_t>;
+	using CCTEMP  = field<268, std::uint16_t>;
+	using MTFA    = field<270, std::uint16_t>;
+	using HMPRE   = field<272, std::uint32_t>;
+	using HMMIN   = field<276, std::uint32_t>;
+	using TNVMCAP = field128<280>;
+	using UNVMCAP = field128<296>;
+	using KAS     = field<320, std::uint16_t>;
+	using SQES_MAX = field<512, std::uint8_t, 4, 7>;
+	using SQES_MIN = field<512, std::uint8_t, 0, 3>;
+	using CQES_MAX = field<513, std::uint8_t, 4, 7>;
+	using CQES_MIN = field<513, std::uint8_t, 0, 3>;
+	using MAXCMD  = field<514, std::uint16_t>;
+	using NN      = field<516, std::uint32_t>;
+	using ONCS    = field<520, std::uint16_t>;
+	using ONCS_SAVE = flag<520, 4, std::uint16_t>;
+	using FNA     = field<524, std::uint8_t>;
+	using VWC     = flag<525, 0>;
+	using AWUN    = field<526, std::uint16_t>;
+	using AWUPF   = field<528, std::uint16_t>;
+	using ACWU    = field<532, std::uint16_t>;
+	using SGLS    = field<536, std::uint32_t>;
+
+	static constexpr std::size_t SN = 4, SN_LEN = 20;
+	static constexpr std::size_t MN = 24, MN_LEN = 40;
+	static constexpr std::size_t FR = 64, FR_LEN = 8;
+	static constexpr std::size_t PSD0 = 2048;
+	static constexpr std::size_t MAX_POWER_STATES = 32;
+
+	constexpr power_state_descriptor power_state (unsigned n) const noexcept
+	{
+		return power_state_descriptor(p_ + PSD0 + n * power_state_descriptor::size);
+	}
+	constexpr unsigned power_states () const noexcept { return get<NPSS>() + 1u; }
+};
+
+// LBA Format Data Structure (Figure 94)
+class lba_format : public view<4> {
+public:
+	using view::view;
+
+	using MS    = field<0, std::uint32_t, 0, 15>;
+	using LBADS = field<0, std::uint32_t, 16, 23>;
+	using RP    = field<0, std::uint32_t, 24, 25>;
+
+	constexpr std::uint32_t data_size () const noexcept { return get<LBADS>() ? (1u << get<LBADS>()) : 0u; }
+	constexpr std::uint32_t metadata_size () const noexcept { return get<MS>(); }
+	constexpr unsigned relative_performance () const noexcept { return get<RP>(); }
+};
+
+// IDENTIFY Namespace data structure (Figure 92)
+class identify_namespace : public view<4096> {
+public:
+	using view::view;
+
+	using NSZE   = field<0, std::uint64_t>;
+	using NCAP   = field<8, std::uint64_t>;
+	using NUSE   = field<16, std::uint64_t>;
+	using NSFEAT = field<24, std::uint8_t>;
+	using NLBAF  = field<25, std::uint8_t>;
+	using FLBAS_FORMAT = field<26, std::uint8_t, 0, 3>;
+	using FLBAS_EXTENDED = flag<26, 4>;
+	using MC     = field<27, std::uint8_t>;
+	using DPC    = field<28, std::uint8_t>;
+	using DPS    = field<29, std::uint8_t>;
+	using NMIC   = field<30, std::uint8_t>;
+	using RESCAP = field<31, std::uint8_t>;
+	using NAWUN  = field<34, std::uint16_t>;
+	using NAWUPF = field<36, std::uint16_t>;
+	using NACWU  = field<38, std::uint16_t>;
+	using NABSN  = field<40, std::uint16_t>;
+	using NABO   = field<42, std::uint16_t>;
+	using NABSPF = field<44, std::uint16_t>;
+	using NVMCAP = field128<48>;
+
+	static constexpr std::size_t LBAF0 = 128;
+
+	constexpr lba_format lbaf (unsigned n) const noexcept { return lba_format(p_ + LBAF0 + n * lba_format::size); }
+	constexpr lba_format current_lbaf () const noexcept { return lbaf(get<FLBAS_FORMAT>()); }
+};
+
+// SMART / Health Information log page (Figure 79)
+class smart_log : public view<512> {
+public:
+	using view::view;
+
+	using CRITICAL_WARNING = field<0, std::uint8_t>;
+	using COMPOSITE_TEMP   = field<1, std::uint16_t>;
+	using AVAIL_SPARE      = field<3, std::uint8_t>;
+	using SPARE_THRESH     = field<4, std::uint8_t>;
+	using PERCENT_USED     = field<5, std::uint8_t>;
+	using DATA_UNITS_READ  = field128<32>;
+	using DATA_UNITS_WRITTEN = field128<48>;
+	using HOST_READ_CMDS   = field128<64>;
+	using HOST_WRITE_CMDS  = field128<80>;
+	using CTRL_BUSY_TIME   = field128<96>;
+	using POWER_CYCLES     = field128<112>;
+	using POWER_ON_HOURS   = field128<128>;
+	using UNSAFE_SHUTDOWNS = field128<144>;
+	using MEDIA_ERRORS     = field128<160>;
+	using NUM_ERR_LOG_ENTRIES = field128<176>;
+	using WARNING_TEMP_TIME  = field<192, std::uint32_t>;
+	using CRITICAL_TEMP_TIME = field<196, std::uint32_t>;
+
+	// Temperature Sensor n (1..8), Kelvin; 0 if not implemented
+	constexpr std::uint16_t temp_sensor (unsigned n) const noexcept
+	{
+		return load_le<std::uint16_t>(p_ + 200 + (n - 1) * 2);
+	}
+	// Kelvin to Celsius
+	static constexpr int celsius (std::uint16_t kelvin) noexcept { return static_cast<int>(kelvin) - 273; }
+};
+
+// Controller registers in BAR0 (Figure 3); the view must be a copy of the
+// registers, as MMIO space should be read in 32-bit units only.
+class controller_registers : public view<64> {
+public:
+	using view::view;
+
+	using CAP     = field<0, std::uint64_t>;
+	using MQES    = field<0, std::uint64_t, 0, 15>;
+	using CQR     = field<0, std::uint64_t, 16, 16>;
+	using AMS     = field<0, std::uint64_t, 17, 18>;
+	using TO      = field<0, std::uint64_t, 24, 31>;
+	using DSTRD   = field<0, std::uint64_t, 32, 35>;
+	using NSSRS   = field<0, std::uint64_t, 36, 36>;
+	using CSS     = field<0, std::uint64_t, 37, 44>;
+	using MPSMIN  = field<0, std::uint64_t, 48, 51>;
+	using MPSMAX  = field<0, std::uint64_t, 52, 55>;
+	using VS      = field<8, std::uint32_t>;
+	using CC      = field<20, std::uint32_t>;
+	using CC_EN   = field<20, std::uint32_t, 0, 0>;
+	using CC_CSS  = field<20, std::uint32_t, 4, 6>;
+	using CC_MPS  = field<20, std::uint32_t, 7, 10>;
+	using CC_AMS  = field<20, std::uint32_t, 11, 13>;
+	using CC_SHN  = field<20, std::uint32_t, 14, 15>;
+	using CC_IOSQES = field<20, std::uint32_t, 16, 19>;
+	using CC_IOCQES = field<20, std::uint32_t, 20, 23>;
+	using CSTS    = field<28, std::uint32_t>;
+	using CSTS_RDY = field<28, std::uint32_t, 0, 0>;
+	using CSTS_CFS = field<28, std::uint32_t, 1, 1>;
+	using CSTS_SHST = field<28, std::uint32_t, 2, 3>;
+	using CSTS_NSSRO = field<28, std::uint32_t, 4, 4>;
+	using CSTS_PP  = field<28, std::uint32_t, 5, 5>;
+	using AQA     = field<36, std::uint32_t>;
+	using ASQ     = field<40, std::uint64_t>;
+	using ACQ     = field<48, std::uint64_t>;
+	using CMBLOC_BIR  = field<56, std::uint32_t, 0, 2>;
+	using CMBLOC_OFST = field<56, std::uint32_t, 12, 31>;
+	using CMBSZ_SQS = field<60, std::uint32_t, 0, 0>;
+	using CMBSZ_CQS = field<60, std::uint32_t, 1, 1>;
+	using CMBSZ_LISTS = field<60, std::uint32_t, 2, 2>;
+	using CMBSZ_RDS = field<60, std::uint32_t, 3, 3>;
+	using CMBSZ_WDS = field<60, std::uint32_t, 4, 4>;
+	using CMBSZ_SZU = field<60, std::uint32_t, 8, 11>;
+	using CMBSZ_SZ  = field<60, std::uint32_t, 12, 31>;
+
+	constexpr std::uint32_t mqes () const noexcept { return static_cast<std::uint32_t>(get<MQES>()) + 1; }
+	constexpr std::uint32_t doorbell_stride () const noexcept { return 4u << get<DSTRD>(); }
+	constexpr std::uint64_t mps_min () const noexcept { return std::uint64_t(1) << (12 + get<MPSMIN>()); }
+	constexpr std::uint64_t mps_max () const noexcept { return std::uint64_t(1) << (12 + get<MPSMAX>()); }
+};
+
+// PCI Express Capability structure; the view starts at the capability offset
+class pxcap : public view<60> {
+public:
+	using view::view;
+
+	using CID     = field<0, std::uint16_t, 0, 7>;
+	using NEXT    = field<0, std::uint16_t, 8, 15>;
+	using DPT     = field<2, std::uint16_t, 4, 7>;
+	using VER     = field<2, std::uint16_t, 0, 3>;
+	using DCAP_MPS = field<4, std::uint32_t, 0, 2>;
+	using DCAP_FLRC = field<4, std::uint32_t, 28, 28>;
+	using DC_MPS  = field<8, std::uint16_t, 5, 7>;
+	using DC_MRRS = field<8, std::uint16_t, 12, 14>;
+	using DC_ERO  = field<8, std::uint16_t, 4, 4>;
+	using DC_ENS  = field<8, std::uint16_t, 11, 11>;
+	using LCAP_SLS = field<12, std::uint32_t, 0, 3>;
+	using LCAP_MLW = field<12, std::uint32_t, 4, 9>;
+	using LCAP_ASPMS = field<12, std::uint32_t, 10, 11>;
+	using LC_ASPMC = field<16, std::uint16_t, 0, 1>;
+	using LS_CLS  = field<18, std::uint16_t, 0, 3>;
+	using LS_NLW  = field<18, std::uint16_t, 4, 9>;
+	using DCAP2_LTRS = field<36, std::uint32_t, 11, 11>;
+	using DC2_LTRME = field<40, std::uint32_t, 10, 10>;
+
+	static constexpr std::uint8_t CAP_ID = 0x10;
+
+	constexpr unsigned max_payload () const noexcept { return 128u << get<DC_MPS>(); }
+	constexpr unsigned max_read_request () const noexcept { return 128u << get<DC_MRRS>(); }
+	constexpr bool link_degraded () const noexcept
+	{
+		return get<LS_CLS>() < get<LCAP_SLS>() || get<LS_NLW>() < get<LCAP_MLW>();
+	}
+};
+
+// Finds the PCI Express Capability in a copy of the config space
+inline constexpr const std::uint8_t *find_pxcap (const std::uint8_t *config, std::size_t len) noexcept
+{
+	std::size_t off = config[0x34];
+	for (int hops = 0; off && off + pxcap::size <= len && hops < 48; hops++) {
+		if (config[off] == pxcap::CAP_ID)
+			return config + off;
+		off = config[off + 1];
+	}
+	return nullptr;
+}
+
+
+// Layout checks against the NVMe 1.2.1 figures
+static_assert(identify_controller::MDTS::offset == 77, "MDTS");
+static_assert(identify_controller::NPSS::offset == 263, "NPSS");
+static_assert(identify_controller::SGLS::end == 540, "SGLS");
+static_assert(identify_controller::PSD0 + identify_controller::MAX_POWER_STATES *
+		power_state_descriptor::size == 3072, "PSD31 ends at byte 3071");
+static_assert(identify_namespace::LBAF0 + 16 * lba_format::size == 192, "LBAF15 ends at byte 191");
+static_assert(identify_namespace::NVMCAP::end == 64, "NVMCAP");
+static_assert(smart_log::NUM_ERR_LOG_ENTRIES::end == 192, "Number of Error Information Log Entries");
+static_assert(smart_log::CRITICAL_TEMP_TIME::end == 200, "Critical Composite Temperature Time");
+static_assert(controller_registers::MPSMAX::hi == 55, "CAP.MPSMAX");
+static_assert(controller_registers::CMBSZ_SZ::end == controller_registers::size, "CMBSZ");
+static_assert(pxcap::DC2_LTRME::end <= pxcap::size, "PXDC2");
+static_assert(controller_registers::MQES::mask == 0xffff, "mask");
+
+} // namespace nvmed_info
+
+#endif /* _NVMED_INFO_HPP */
@@ -0,0 +1,694 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd advise_cmds[] = {
+	{"queues", 1, "Queue topology and interrupt coalescing", nvmed_info_advise_queues},
+	{"io", 1, "I/O size and alignment", nvmed_info_advise_io},
+	{"format", 1, "LBA format ranking and Format NVM", nvmed_info_advise_format},
+	{"hmb", 1, "Host Memory Buffer sizing", nvmed_info_advise_hmb},
+	{NULL, 0, NULL, NULL}
+};
+
+int nvmed_info_advise (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	if (cmd_args[0] == NULL)
+		return nvmed_info_advise_queues(nvmed, NULL);
+
+	c = cmd_lookup(advise_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_advise_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_advise_help (char *s)
+{
+	return cmd_help(s, "ADVISE subcommands", advise_cmds);
+}
+
+static unsigned int rounddown_pow2 (unsigned int x)
+{
+	unsigned int r = 1;
+
+	if (x == 0)
+		return 0;
+	while (r <= x / 2)
+		r <<= 1;
+	return r;
+}
+
+// Usage: advise queues [iops|latency]
+int nvmed_info_advise_queues (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_regs regs;
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_features feat;
+	__u32 _v;
+	int rc, latency = 1;
+	int cores, nsqa, ncqa, mqes, cqr, dstrd;
+	int maxcmd, sqes, cqes;
+	int queues, depth, thr, atime;
+	long sq_bytes, cq_bytes;
+
+	if (cmd_args && cmd_args[0]) {
+		if (!strncmp(cmd_args[0], "iops", 1))
+			latency = 0;
+		else if (!strncmp(cmd_args[0], "latency", 1))
+			latency = 1;
+		else {
+			printf("Invalid target \"%s\" (iops or latency)\n", cmd_args[0]);
+			return -1;
+		}
+	}
+
+	rc = nvmed_info_read_regs(dev_info, &regs);
+	if (rc == 0)
+		rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc == 0)
+		rc = nvmed_info_read_features(dev_info, &feat);
+	if (rc) {
+		printf("Cannot read the controller information (%d)\n", rc);
+		return -1;
+	}
+	if ((feat.valid & (1U << FEATURE_NUMBER_OF_QUEUES)) == 0) {
+		printf("Cannot read the Number of Queues feature\n");
+		return -1;
+	}
+
+	mqes = regs.mqes;
+	cqr = regs.cqr;
+	dstrd = regs.dstrd;
+	sqes = pow2(ctrl.sqes & 0x0f);
+	cqes = pow2(ctrl.cqes & 0x0f);
+	maxcmd = ctrl.maxcmd;
+	nsqa = feat.queues.nsqa;
+	ncqa = feat.queues.ncqa;
+	cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores <= 0)
+		cores = 1;
+
+	// One queue pair per core so that no two submitters share a doorbell or a lock
+	queues = cores;
+	if (queues > nsqa)
+		queues = nsqa;
+	if (queues > ncqa)
+		queues = ncqa;
+
+	// Latency is won with shallow queues, IOPS with enough depth to cover the
+	// device parallelism; both are bounded by MQES and by MAXCMD over all queues.
+	depth = latency? 32 : 1024;
+	if (depth > mqes)
+		depth = mqes;
+	if (maxcmd && depth > maxcmd / queues)
+		depth = maxcmd / queues;
+	// CQR requires physically contiguous queues; keep each SQ within 64 KB
+	if (cqr && depth * sqes > 65536)
+		depth = 65536 / sqes;
+	depth = rounddown_pow2(depth);
+	if (depth < 2)
+		depth = 2;
+	sq_bytes = (long) depth * sqes;
+	cq_bytes = (long) depth * cqes;
+
+	// THR is 0's based; TIME is in 100 usec units
+	if (latency) {
+		thr = 0;
+		atime = 0;
+	} else {
+		thr = depth / 8 - 1;
+		if (thr < 0)
+			thr = 0;
+		if (thr > 255)
+			thr = 255;
+		atime = 1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("ADVISE Queues (target: %s)\n", latency? "latency" : "IOPS");
+	P ("Parameter                                 Current       Recommended\n");
+	P ("----------------------------------------  ------------  ------------\n");
+
+	P ("\n[Inputs]\n");
+	P ("%-40s  %12d\n", "Host online cores", cores);
+	P ("%-40s  %12d\n", "Maximum Queue Entries Supported (MQES)", mqes);
+	P ("%-40s  %12s\n", "Contiguous Queues Required (CQR)", cqr? "Yes" : "No");
+	P ("%-40s  %12d\n", "Doorbell Stride (DSTRD) in bytes", pow2(2 + dstrd));
+	P ("%-40s  %12d\n", "Maximum Outstanding Commands (MAXCMD)", maxcmd);
+	P ("%-40s  %12d\n", "Submission Queue Entry Size (SQES)", sqes);
+	P ("%-40s  %12d\n", "Completion Queue Entry Size (CQES)", cqes);
+
+	P ("\n[Queues]\n");
+	P ("%-40s  %12d  %12d\n", "I/O Submission Queues (NSQA)", nsqa, queues);
+	P ("%-40s  %12d  %12d\n", "I/O Completion Queues (NCQA)", ncqa, queues);
+	P ("%-40s  %12s  %12d\n", "Queue depth (entries)", "-", depth);
+	P ("%-40s  %12s  %12d\n", "Outstanding commands (all queues)", "-", depth * queues);
+	P ("%-40s  %12s  %12ld\n", "SQ memory per queue (bytes)", "-", sq_bytes);
+	P ("%-40s  %12s  %12ld\n", "CQ memory per queue (bytes)", "-", cq_bytes);
+
+	P ("\n[Interrupt Coalescing]\n");
+	P ("%-40s  %12u  %12d\n", "Aggregation Threshold (THR+1 entries)", feat.coalescing.thr + 1, thr + 1);
+	P ("%-40s  %12u  %12d\n", "Aggregation Time (100 usec)", feat.coalescing.time, atime);
+	// CD is per vector, and vector 0 serves the admin queue; read vector 1,
+	// which the driver gives to the first I/O completion queue
+	rc = nvmed_info_ctx_get_feature(dev_info, FEATURE_INTERRUPT_VECTOR_CONFIG, FEATURE_SEL_CURRENT,
+			0, 1, NULL, 0, &_v);
+	P ("%-40s  %12s  %12s\n", "Coalescing Disable (CD) for I/O vectors",
+			rc? "-" : YN(16), latency? "Yes" : "No");
+
+	P ("\n[Notes]\n");
+	if (queues < cores)
+		P ("  - The controller allocated only %d queue pairs for %d cores; "
+			"cores must share queues.\n", queues, cores);
+	if (maxcmd && depth * queues >= maxcmd)
+		P ("  - Queue depth is bounded by MAXCMD (%d) across %d queues.\n", maxcmd, queues);
+	if (dstrd == 0 && queues > 1)
+		P ("  - Doorbells are packed 4 bytes apart; %d queue pairs share a 64-byte cache line.\n"
+		   "    Give each core queue IDs that are at least %d apart to avoid false sharing.\n",
+		   64 / 8, 64 / 8);
+	if (cqr)
+		P ("  - Each queue must be physically contiguous (%ld bytes for SQ + CQ).\n",
+			sq_bytes + cq_bytes);
+	if (latency)
+		P ("  - Poll the NVMeDirect completion queues; coalescing only delays interrupts.\n");
+	else
+		P ("  - Coalescing trades up to %d usec of completion latency for fewer interrupts.\n",
+			atime * 100);
+	P ("\n\n");
+
+	return 0;
+}
+
+static int advise_sysfs_ulong (const char *dir, const char *name, unsigned long *v)
+{
+	char path[512], buf[64];
+	FILE *fp;
+	int rc = -1;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return -1;
+	if (fgets(buf, sizeof(buf), fp))
+		rc = (sscanf(buf, "%lu", v) == 1)? 0 : -1;
+	fclose(fp);
+	return rc;
+}
+
+static const char *advise_size (unsigned long v)
+{
+	static char s[4][32];
+	static int n;
+	char *p = s[n++ & 3];
+
+	if (v == 0)
+		snprintf(p, 32, "-");
+	else if (v >= 1024 * 1024 && (v % (1024 * 1024)) == 0)
+		snprintf(p, 32, "%lu MB", v / (1024 * 1024));
+	else if (v >= 1024 && (v % 1024) == 0)
+		snprintf(p, 32, "%lu KB", v / 1024);
+	else
+		snprintf(p, 32, "%lu B", v);
+	return p;
+}
+
+static unsigned long advise_max (unsigned long a, unsigned long b)
+{
+	return (a > b)? a : b;
+}
+
+// Usage: advise io [nsid]
+// Recommends I/O sizes and alignments from MDTS, CAP.MPSMIN, the active LBA
+// format, the atomic write units, the NVMe 1.4 optimal performance fields
+// and the Streams directive, and checks the kernel queue limits and
+// partition offsets
+int nvmed_info_advise_io (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_inventory inv;
+	struct nvmed_info_regs regs;
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_namespace ns;
+	struct nvmed_info_lbaf *lbaf;
+	struct nvmed_info_streams st;
+	char block[256], part[512], *name;
+	unsigned long page, lba, mdts, max_io, io, io_min, align, buf_align;
+	unsigned long awupf, nabsn = 0, nabo = 0, npwg = 0, npwa = 0, npdg = 0, npda = 0, nows = 0;
+	unsigned long hw_kb = 0, max_kb = 0, opt = 0, min_io = 0, lbs = 0, pbs = 0, start;
+	unsigned long sws = 0, sgs = 0;
+	int rc, nsid, have_regs, optperf, streams = 0, parts = 0, misaligned = 0;
+	DIR *dir;
+	struct dirent *d;
+
+	nvmed_info_read_inventory(nvmed_info_ctx_path(dev_info), &inv);
+	nsid = inv.nsid? inv.nsid : 1;
+	if (cmd_args && cmd_args[0]) {
+		nsid = atoi(cmd_args[0]);
+		if (nsid <= 0) {
+			printf("Invalid namespace ID %d\n", nsid);
+			return -1;
+		}
+	}
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc == 0)
+		rc = nvmed_info_read_namespace(dev_info, nsid, &ns);
+	if (rc) {
+		printf("Cannot read the controller information (%d)\n", rc);
+		return -1;
+	}
+	have_regs = (nvmed_info_read_regs(dev_info, &regs) == 0);
+
+	// MDTS is in units of the minimum memory page size
+	page = 1UL << (12 + (have_regs? regs.mpsmin : 0));
+	mdts = ctrl.mdts? page << ctrl.mdts : 0;
+	lbaf = &ns.lbaf[ns.flbas & 0xf];
+	lba = 1UL << lbaf->lbads;
+
+	// Namespace atomic values override the controller ones when NSFEAT bit 1 is set
+	awupf = (ctrl.awupf + 1) * lba;
+	if (ns.nsfeat & 0x2) {
+		awupf = (ns.nawupf + 1) * lba;
+		if (ns.nabsn) {
+			nabsn = (ns.nabsn + 1) * lba;
+			nabo = ns.nabo * lba;
+		}
+	}
+	optperf = (ns.nsfeat & 0x10) != 0;
+	if (optperf) {
+		npwg = (ns.npwg + 1) * lba;
+		npwa = (ns.npwa + 1) * lba;
+		npdg = (ns.npdg + 1) * lba;
+		npda = (ns.npda + 1) * lba;
+		nows = (ns.nows + 1) * lba;
+	}
+	// Streams directive (OACS bit 5): SWS is the unit a stream is written in
+	if ((ctrl.oacs & (1 << 5)) && nvmed_info_read_streams(dev_info, nsid, &st) == 0 && st.supported) {
+		streams = 1;
+		sws = st.sws * lba;
+		sgs = st.sgs * sws;
+	}
+
+	// The kernel queue limits of the block device, if dev_path is one
+	name = strrchr(nvmed_info_ctx_path(dev_info), '/');
+	name = name? name + 1 : (char *) nvmed_info_ctx_path(dev_info);
+	snprintf(block, sizeof(block), "/sys/class/block/%s", name);
+	snprintf(part, sizeof(part), "%s/queue", block);
+	if (advise_sysfs_ulong(part, "max_hw_sectors_kb", &hw_kb) == 0) {
+		advise_sysfs_ulong(part, "max_sectors_kb", &max_kb);
+		advise_sysfs_ulong(part, "optimal_io_size", &opt);
+		advise_sysfs_ulong(part, "minimum_io_size", &min_io);
+		advise_sysfs_ulong(part, "logical_block_size", &lbs);
+		advise_sysfs_ulong(part, "physical_block_size", &pbs);
+	}
+
+	// Largest I/O that is not split, by the controller or by the kernel
+	max_io = mdts? mdts : 1UL << 30;
+	if (hw_kb && hw_kb * 1024 < max_io)
+		max_io = hw_kb * 1024;
+	if (max_kb && max_kb * 1024 < max_io)
+		max_io = max_kb * 1024;
+
+	// Device offsets: the preferred write alignment, never less than a block
+	// or a page; memory buffers: a page, so that PRP lists stay one entry per page
+	align = advise_max(advise_max(npwa, lba), page);
+	buf_align = page;
+	// Smallest I/O that avoids read-modify-write, and the size that streams
+	// best: NOWS when reported, otherwise the largest I/O that is not split
+	io_min = advise_max(align, npwg);
+	io = nows? nows : max_io;
+	io = (io / io_min) * io_min;
+	if (io > max_io)
+		io = (max_io / io_min) * io_min;
+	if (io == 0)
+		io = io_min;
+
+	PRINT_NVMED_INFO;
+	P ("ADVISE I/O (namespace %d)\n", nsid);
+	P ("Parameter                                 Value\n");
+	P ("----------------------------------------  ------------\n");
+
+	P ("\n[Controller]\n");
+	P ("%-40s  %12s%s\n", "Memory Page Size Minimum (CAP.MPSMIN)", advise_size(page),
+		have_regs? "" : " (assumed)");
+	if (have_regs)
+		P ("%-40s  %12s\n", "Memory Page Size Maximum (CAP.MPSMAX)", advise_size(1UL << (12 + regs.mpsmax)));
+	P ("%-40s  %12s\n", "Maximum Data Transfer Size (MDTS)", mdts? advise_size(mdts) : "No limit");
+	P ("%-40s  %12s\n", "Atomic Write Unit Normal (AWUN)", advise_size((ctrl.awun + 1) * lba));
+	P ("%-40s  %12s\n", "Atomic Write Unit Power Fail (AWUPF)", advise_size((ctrl.awupf + 1) * lba));
+
+	P ("\n[Namespace]\n");
+	P ("%-40s  %12s\n", "LBA Data Size (LBAF.LBADS)", advise_size(lba));
+	P ("%-40s  %12u\n", "Metadata Size (LBAF.MS)", lbaf->ms);
+	P ("%-40s  %12u\n", "Relative Performance (LBAF.RP)", lbaf->rp);
+	if (ns.nsfeat & 0x2) {
+		P ("%-40s  %12s\n", "Namespace Atomic Write Unit Normal", advise_size((ns.nawun + 1) * lba));
+		P ("%-40s  %12s\n", "Namespace Atomic Write Unit Power Fail", advise_size(awupf));
+		P ("%-40s  %12s\n", "Atomic Boundary Size Normal (NABSN)", advise_size(nabsn));
+		P ("%-40s  %12s\n", "Atomic Boundary Offset (NABO)", nabsn? advise_size(nabo) : "-");
+	}
+	if (optperf) {
+		P ("%-40s  %12s\n", "Preferred Write Granularity (NPWG)", advise_size(npwg));
+		P ("%-40s  %12s\n", "Preferred Write Alignment (NPWA)", advise_size(npwa));
+		P ("%-40s  %12s\n", "Preferred Deallocate Granularity (NPDG)", advise_size(npdg));
+		P ("%-40s  %12s\n", "Preferred Deallocate Alignment (NPDA)", advise_size(npda));
+		P ("%-40s  %12s\n", "Optimal Write Size (NOWS)", advise_size(nows));
+	} else
+		P ("%-40s  %12s\n", "Optimal I/O fields (NVMe 1.4 NPWG..NOWS)", "Not reported");
+	if (streams) {
+		P ("%-40s  %12s\n", "Streams Directive", st.enabled? "Enabled" : "Disabled");
+		P ("%-40s  %12s\n", "Stream Write Size (SWS)", advise_size(sws));
+		P ("%-40s  %12s\n", "Stream Granularity Size (SGS)", advise_size(sgs));
+		P ("%-40s  %12u\n", "Namespace Streams Allocated (NSA)", st.nsa);
+	}
+
+	if (hw_kb) {
+		P ("\n[Kernel: %s]\n", name);
+		P ("%-40s  %12s\n", "max_hw_sectors_kb", advise_size(hw_kb * 1024));
+		P ("%-40s  %12s\n", "max_sectors_kb", advise_size(max_kb * 1024));
+		P ("%-40s  %12s\n", "optimal_io_size", advise_size(opt));
+		P ("%-40s  %12s\n", "minimum_io_size", advise_size(min_io));
+		P ("%-40s  %12s\n", "logical_block_size", advise_size(lbs));
+		P ("%-40s  %12s\n", "physical_block_size", advise_size(pbs));
+	}
+
+	P ("\n[Recommended]\n");
+	P ("%-40s  %12s\n", "Smallest efficient I/O", advise_size(io_min));
+	P ("%-40s  %12s\n", nows? "Streaming I/O size (NOWS)" : "Streaming I/O size", advise_size(io));
+	P ("%-40s  %12s\n", "Largest I/O without splitting", advise_size(max_io));
+	P ("%-40s  %12s\n", "Device offset alignment", advise_size(align));
+	P ("%-40s  %12s\n", "Memory buffer alignment", advise_size(buf_align));
+	if (npdg)
+		P ("%-40s  %12s\n", "Deallocate (TRIM) granularity", advise_size(advise_max(npdg, npda)));
+	P ("%-40s  %12s\n", "Largest power-fail atomic write", advise_size(awupf));
+	if (streams && sws) {
+		P ("%-40s  %12s\n", "Per-stream write unit (SWS)", advise_size(sws));
+		P ("%-40s  %12s\n", "Stream allocation unit (SGS)", advise_size(sgs));
+	}
+
+	// Partition start offsets are in 512-byte sectors
+	dir = hw_kb? opendir(block) : NULL;
+	if (dir) {
+		while ((d = readdir(dir)) != NULL) {
+			if (strncmp(d->d_name, name, strlen(name)) || !strcmp(d->d_name, name))
+				continue;
+			snprintf(part, sizeof(part), "%s/%s", block, d->d_name);
+			if (advise_sysfs_ulong(part, "start", &start))
+				continue;
+			if (parts++ == 0)
+				P ("\n[Partitions]\n");
+			start *= 512;
+			P ("%-40s  %12lu  %s\n", d->d_name, start,
+				(start % align)? "Misaligned" : "Aligned");
+			misaligned += (start % align) != 0;
+		}
+		closedir(dir);
+	}
+
+	P ("\n[Notes]\n");
+	if (mdts && max_io < mdts)
+		P ("  - The kernel splits I/O above %s although MDTS allows %s.\n",
+			advise_size(max_io), advise_size(mdts));
+	if (hw_kb && mdts && hw_kb * 1024 > mdts)
+		P ("  - max_hw_sectors_kb (%s) exceeds MDTS (%s); larger I/O fails or is split.\n",
+			advise_size(hw_kb * 1024), advise_size(mdts));
+	if (lbs && lbs != lba)
+		P ("  - The kernel logical block size (%lu) differs from the LBA format (%lu).\n", lbs, lba);
+	if (lba < page)
+		P ("  - %lu-byte LBAs are smaller than a %s page; writes below %s may need\n"
+		   "    read-modify-write in the device if it maps by pages.\n",
+			lba, advise_size(page), advise_size(page));
+	if (optperf && opt && opt != nows)
+		P ("  - optimal_io_size (%s) differs from NOWS (%s).\n", advise_size(opt), advise_size(nows));
+	if (nabsn)
+		P ("  - Atomic writes must not cross a %s boundary at offset %s.\n",
+			advise_size(nabsn), advise_size(nabo));
+	if (streams && !st.enabled)
+		P ("  - Streams are supported but disabled; \"directives enable %d\" turns them on so that\n"
+		   "    writes tagged with different stream IDs land in separate media units.\n", nsid);
+	if (streams && sws && io % sws)
+		P ("  - The streaming size %s is not a multiple of SWS (%s); write each stream in\n"
+		   "    multiples of %s.\n", advise_size(io), advise_size(sws), advise_size(sws));
+	if (misaligned)
+		P ("  - %d partition%s not aligned to %s; every I/O to %s splits or\n"
+		   "    read-modify-writes at the device.\n", misaligned, (misaligned == 1)? " is" : "s are",
+			advise_size(align), (misaligned == 1)? "it" : "them");
+	P ("  - Keep every I/O a multiple of %s, aligned to %s on the device and to %s in memory.\n",
+		advise_size(io_min), advise_size(align), advise_size(buf_align));
+	P ("\n\n");
+	return 0;
+}
+
+// Expected throughput of each Relative Performance value, relative to Best
+static const double advise_rp_factor[] = { 1.00, 0.85, 0.70, 0.50 };
+static const char *advise_rp_name[] = { "Best", "Better", "Good", "Degraded" };
+
+// Scores an LBA format for a workload issuing io_size-byte I/O that needs
+// meta bytes of metadata per block; 0 if the format cannot serve it
+static double advise_format_score (struct nvmed_info_lbaf *f, long io_size, long meta)
+{
+	long lba = 1L << f->lbads;
+
+	if (f->lbads < 9 || io_size % lba || f->ms < meta)
+		return 0;
+	// Metadata beyond what the workload needs is transferred for nothing
+	return advise_rp_factor[f->rp & 0x3] * (double) (lba + meta) / (lba + f->ms);
+}
+
+// Usage: advise format [nsid] [--io-size N] [--metadata N] [--apply [--yes]]
+// Ranks the LBA formats of a namespace for a workload and, with --apply,
+// issues Format NVM with the best one after confirmation
+int nvmed_info_advise_format (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_namespace ns;
+	struct nvme_admin_cmd cmd;
+	double score[16], cur_score;
+	int order[16], i, j, t, rc, nsid = 1, best, cur, pi, pil, mset;
+	long io_size, meta;
+	char line[32];
+	__u32 cdw10;
+
+	if (cmd_args && cmd_args[0] && cmd_args[0][0] != '-') {
+		nsid = atoi(cmd_args[0]);
+		if (nsid <= 0) {
+			printf("Invalid namespace ID %d\n", nsid);
+			return -1;
+		}
+	}
+	io_size = nvmed_info_opt_long(cmd_args, "--io-size", 4096);
+	meta = nvmed_info_opt_long(cmd_args, "--metadata", 0);
+	if (io_size < 512 || meta < 0) {
+		printf("Invalid --io-size or --metadata\n");
+		return -1;
+	}
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc == 0)
+		rc = nvmed_info_read_namespace(dev_info, nsid, &ns);
+	if (rc) {
+		printf("Cannot read the controller information (%d)\n", rc);
+		return -1;
+	}
+
+	// Rank by score, then by the larger data size (fewer blocks to map)
+	for (i = 0; i <= ns.nlbaf && i < 16; i++) {
+		score[i] = advise_format_score(&ns.lbaf[i], io_size, meta);
+		order[i] = i;
+	}
+	for (i = 1; i <= ns.nlbaf && i < 16; i++) {
+		for (j = i; j > 0; j--) {
+			if (score[order[j]] < score[order[j-1]] || (score[order[j]] == score[order[j-1]] &&
+					ns.lbaf[order[j]].lbads <= ns.lbaf[order[j-1]].lbads))
+				break;
+			t = order[j];
+			order[j] = order[j-1];
+			order[j-1] = t;
+		}
+	}
+	cur = ns.flbas & 0xf;
+	cur_score = score[cur];
+	best = order[0];
+
+	PRINT_NVMED_INFO;
+	P ("ADVISE Format (namespace %d, %ld-byte I/O, %ld bytes of metadata per block)\n", nsid, io_size, meta);
+	P ("Rank  LBAF  Data Size  Metadata  Relative Performance  Score  Note\n");
+	P ("----  ----  ---------  --------  --------------------  -----  ----\n");
+	for (i = 0; i <= ns.nlbaf && i < 16; i++) {
+		struct nvmed_info_lbaf *f = &ns.lbaf[order[i]];
+
+		P ("%4d  %4d  %9d  %8d  %-20s  %5.2f  %s%s%s\n", i + 1, order[i],
+			f->lbads? 1 << f->lbads : 0, f->ms, advise_rp_name[f->rp & 0x3], score[order[i]],
+			(order[i] == cur)? "current" : "",
+			(order[i] == cur && score[order[i]] == 0)? ", " : "",
+			(score[order[i]] == 0)? (f->lbads < 9? "unsupported" : "does not fit the workload") : "");
+	}
+
+	P ("\n[Recommendation]\n");
+	if (score[best] == 0) {
+		P ("No LBA format fits %ld-byte I/O with %ld bytes of metadata\n\n\n", io_size, meta);
+		return 0;
+	}
+	if (best == cur || score[best] <= cur_score) {
+		P ("The current format (LBAF %d) is already the best for this workload\n\n\n", cur);
+		return 0;
+	}
+	if (cur_score > 0)
+		P ("LBAF %d over the current LBAF %d: about %+.0f%% throughput (estimated from RP and metadata)\n",
+			best, cur, (score[best] / cur_score - 1) * 100);
+	else
+		P ("LBAF %d; the current LBAF %d does not fit this workload\n", best, cur);
+
+	// Keep the protection settings when the new format still carries them
+	mset = (ns.flbas >> 4) & 0x1;
+	pi = (ns.lbaf[best].ms >= 8)? (ns.dps & 0x7) : 0;
+	pil = pi? (ns.dps >> 3) & 0x1 : 0;
+	cdw10 = best | (mset << 4) | (pi << 5) | (pil << 8);
+	P ("Format NVM: NSID %d, CDW10 0x%08x (LBAF %d, MSET %d, PI %d, PIL %d, SES 0)\n",
+		nsid, cdw10, best, mset, pi, pil);
+	P ("  nvme format %s --namespace-id=%d --lbaf=%d --ms=%d --pi=%d --pil=%d --ses=0\n",
+		nvmed_info_ctx_path(dev_info), nsid, best, mset, pi, pil);
+
+	if (!(ctrl.oacs & (1 << 1))) {
+		P ("The controller does not support Format NVM (OACS bit 1)\n\n\n");
+		return 0;
+	}
+	if (ctrl.fna & 0x1)
+		P ("FNA bit 0: the format applies to ALL namespaces of the controller\n");
+
+	if (nvmed_info_opt_flag(cmd_args, "--apply")) {
+		if (!nvmed_info_opt_flag(cmd_args, "--yes")) {
+			printf("\nAll data on %s will be lost. Type the namespace ID (%d) to format: ",
+				(ctrl.fna & 0x1)? "every namespace" : "the namespace", nsid);
+			fflush(stdout);
+			if (fgets(line, sizeof(line), stdin) == NULL || atoi(line) != nsid) {
+				printf("Format cancelled\n");
+				return -1;
+			}
+		}
+
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.opcode = nvme_admin_format_nvm;
+		cmd.nsid = htole32(nsid);
+		cmd.cdw10 = htole32(cdw10);
+		cmd.timeout_ms = 600000;		// formatting may take minutes
+		rc = nvmed_info_ctx_admin(dev_info, &cmd);
+		if (rc) {
+			printf("Format NVM failed (%d)\n", rc);
+			return -1;
+		}
+		rc = nvmed_info_read_namespace(dev_info, nsid, &ns);
+		P ("Namespace %d formatted; FLBAS is now 0x%02x (LBAF %d)\n", nsid,
+			rc? 0 : ns.flbas, rc? -1 : ns.flbas & 0xf);
+	}
+	P ("\n\n");
+	return 0;
+}
+
+// Usage: advise hmb
+// Compares the Host Memory Buffer the host allocated with the preferred
+// (HMPRE) and minimum (HMMIN) sizes
+int nvmed_info_advise_hmb (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_features feat;
+	struct nvmed_info_regs regs;
+	unsigned long pref, min, alloc, page, limit_mb = 0;
+	const char *verdict;
+	int rc, have_limit, have_regs;
+
+	// CC.MPS is only needed for the page size, which Linux sets to 4 KB
+	have_regs = (nvmed_info_read_regs(dev_info, &regs) == 0);
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc == 0)
+		rc = nvmed_info_read_features(dev_info, &feat);
+	if (rc) {
+		printf("Cannot read the controller information (%d)\n", rc);
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("ADVISE Host Memory Buffer\n");
+	if (ctrl.hmpre == 0) {
+		P ("The controller does not request a Host Memory Buffer (HMPRE is 0)\n\n\n");
+		return 0;
+	}
+	if ((feat.valid & (1U << FEATURE_HOST_MEMORY_BUFFER)) == 0) {
+		printf("Cannot read the Host Memory Buffer feature\n");
+		return -1;
+	}
+
+	// HMPRE, HMMIN and HMMINDS are in 4 KB units, HSIZE and BSIZE in CC.MPS pages
+	page = 1UL << (12 + (have_regs? regs.cc_mps : 0));
+	pref = (unsigned long) ctrl.hmpre * 4096;
+	min = (unsigned long) ctrl.hmmin * 4096;
+	alloc = feat.hmb.ehm? (unsigned long) feat.hmb.hsize * page : 0;
+	have_limit = (advise_sysfs_ulong("/sys/module/nvme/parameters", "max_host_mem_size_mb", &limit_mb) == 0);
+
+	P ("\n[Controller]\n");
+	P ("%-44s  %s\n", "Preferred Size (HMPRE)", advise_size(pref));
+	P ("%-44s  %s\n", "Minimum Size (HMMIN)", advise_size(min));
+	P ("%-44s  %s\n", "Minimum Descriptor Entry Size (HMMINDS)", advise_size((unsigned long) ctrl.hmminds * 4096));
+	if (ctrl.hmmaxd)
+		P ("%-44s  %u\n", "Maximum Descriptor Entries (HMMAXD)", ctrl.hmmaxd);
+	else
+		P ("%-44s  %s\n", "Maximum Descriptor Entries (HMMAXD)", "No limit");
+
+	P ("\n[Host]\n");
+	P ("%-44s  %s\n", "Enable Host Memory (EHM)", feat.hmb.ehm? "Yes" : "No");
+	P ("%-44s  %u pages of %s%s\n", "Host Memory Buffer Size (HSIZE)", feat.hmb.hsize,
+		advise_size(page), have_regs? "" : " (assumed)");
+	P ("%-44s  0x%016llx\n", "Descriptor List Address (HMDLA)", (unsigned long long) feat.hmb.hmdla);
+	P ("%-44s  %u\n", "Descriptor List Entry Count (HMDLEC)", feat.hmb.hmdlec);
+	if (have_limit)
+		P ("%-44s  %lu MB\n", "Kernel limit (nvme.max_host_mem_size_mb)", limit_mb);
+	if (pref)
+		P ("%-44s  %.0f%%\n", "Allocated of preferred", 100.0 * alloc / pref);
+
+	// HMDLA is an address in the controller's DMA (IOVA) space, so the list
+	// itself cannot be read from user space
+	if (feat.hmb.ehm && feat.hmb.hmdlec)
+		P ("%-44s  %s\n", "Descriptor List", "Not readable from user space (HMDLA is a DMA address)");
+
+	if (!feat.hmb.ehm)
+		verdict = "DISABLED";
+	else if (alloc < min)
+		verdict = "BELOW MINIMUM";
+	else if (alloc < pref)
+		verdict = "BELOW PREFERRED";
+	else
+		verdict = "OK";
+	P ("\nHost Memory Buffer: %s (%s of %s preferred)\n", verdict,
+		alloc? advise_size(alloc) : "none", advise_size(pref));
+
+	P ("\n[Notes]\n");
+	if (!feat.hmb.ehm)
+		P ("  - The drive runs without its Host Memory Buffer; on a DRAM-less drive the mapping table\n"
+		   "    is paged from NAND and random reads pay for it.\n");
+	else if (alloc < pref)
+		P ("  - The buffer is %s short of HMPRE; random reads outside the cached part of the\n"
+		   "    mapping table are slower.\n", advise_size(pref - alloc));
+	if (have_limit && limit_mb * 1024 * 1024 < pref)
+		P ("  - The kernel caps the buffer at %lu MB; boot with nvme.max_host_mem_size_mb=%lu\n"
+		   "    to allow HMPRE.\n", limit_mb, (pref + 1024 * 1024 - 1) / (1024 * 1024));
+	if (ctrl.hmmaxd && feat.hmb.hmdlec >= ctrl.hmmaxd && alloc < pref)
+		P ("  - The list is at HMMAXD entries; larger contiguous chunks are needed to grow it.\n");
+	if (!feat.hmb.ehm && pref)
+		P ("  - The host driver allocates and enables the buffer at controller reset; check\n"
+		   "    \"dmesg | grep -i 'host memory buffer'\" for why it did not.\n");
+	if (feat.hmb.ehm && alloc >= pref)
+		P ("  - The buffer meets HMPRE.\n");
+	P ("\n\n");
+	return 0;
+}
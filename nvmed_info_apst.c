@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/ioctl.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd apst_cmds[] = {
+	{"analyze", 1, "APST latency impact analysis", nvmed_info_apst_analyze},
+	{"generate", 1, "APST table for a latency budget", nvmed_info_apst_generate},
+	{NULL, 0, NULL, NULL}
+};
+
+int nvmed_info_apst (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	if (cmd_args[0] == NULL)
+		return nvmed_info_apst_analyze(nvmed, NULL);
+
+	c = cmd_lookup(apst_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_apst_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_apst_help (char *s)
+{
+	return cmd_help(s, "APST subcommands", apst_cmds);
+}
+
+double nvmed_info_power_state_watts (struct power_state *ps)
+{
+	return ps->mp * (ps->mxps? 0.0001 : 0.01);
+}
+
+// Reads the power states into ps and the APST data structure into apst.
+// Returns the number of power states, or -1.
+int nvmed_info_apst_read (NVMED *nvmed, __u8 *apst, struct power_state *ps, __u32 *apstres)
+{
+	int rc;
+	struct nvmed_info_controller ctrl;
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+
+	if (!(ctrl.apsta & 0x01)) {
+		printf("The controller does not support autonomous power state transitions (APSTA)\n");
+		return -1;
+	}
+
+	rc = nvmed_info_get_features_issue(nvmed, FEATURE_AUTO_POWER_STATE_TRANSITION, 0,
+			apst, APST_TABLE_SIZE, apstres);
+	if (rc < 0)
+		return -1;
+
+	memcpy(ps, ctrl.psd, sizeof(ctrl.psd));
+	return ctrl.npss + 1;
+}
+
+// Usage: apst analyze [--max-latency-us N] [--iops N]
+int nvmed_info_apst_analyze (NVMED *nvmed, char **cmd_args)
+{
+	__u8 *apst;
+	__u32 res, pm, entry;
+	struct power_state ps[MAX_POWER_STATES];
+	int i, n, cur, next, hops, flagged = 0;
+	long budget, iops;
+	double idle_ms, frac, p99 = 0, p999 = 0;
+	__u32 penalty, worst = 0;
+	int visited[MAX_POWER_STATES];
+
+	budget = nvmed_info_opt_long(cmd_args, "--max-latency-us", 100);
+	iops = nvmed_info_opt_long(cmd_args, "--iops", 100);
+	if (budget <= 0 || iops <= 0) {
+		printf("Invalid --max-latency-us or --iops\n");
+		return -1;
+	}
+
+	apst = (__u8 *) nvmed_get_buffer(nvmed, 1);
+	if (apst == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+
+	n = nvmed_info_apst_read(nvmed, apst, ps, &res);
+	if (n < 0 || nvmed_info_get_features_issue(nvmed, FEATURE_POWER_MANAGEMENT, 0, NULL, 0, &pm) < 0) {
+		nvmed_put_buffer(apst);
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("APST Analysis (latency budget: %ld usec, load: %ld IOPS)\n", budget, iops);
+	P ("APST Enable (APSTE): %s, current Power State (PS): %u\n\n", (res & 0x1)? "Yes" : "No", pm & 0x1f);
+
+	P ("[Power States]\n");
+	P ("PS  Type     Max Power   ENLAT (us)  EXLAT (us)  Wake-up (us)  RRT RRL RWT RWL\n");
+	P ("--  -------  ----------  ----------  ----------  ------------  --- --- --- ---\n");
+	for (i = 0; i < n; i++)
+		P ("%2d  %-7s  %8.4f W  %10u  %10u  %12u  %3d %3d %3d %3d\n", i,
+			ps[i].nops? "non-op" : "op", nvmed_info_power_state_watts(&ps[i]),
+			ps[i].enlat, ps[i].exlat, ps[i].enlat + ps[i].exlat,
+			ps[i].rrt, ps[i].rrl, ps[i].rwt, ps[i].rwl);
+
+	P ("\n[Transitions]\n");
+	P ("From  To  ITPT (ms)  Wake-up (us)  Status\n");
+	P ("----  --  ---------  ------------  ------\n");
+	for (i = 0; i < n; i++) {
+		entry = *((__u32 *) &apst[i * APST_ENTRY_SIZE]);
+		if (APST_ITPT(entry) == 0)
+			continue;
+		next = APST_ITPS(entry);
+		if (next >= n) {
+			P ("%4d  %2d  %9u  %12s  invalid target state\n", i, next, APST_ITPT(entry), "-");
+			continue;
+		}
+		penalty = ps[next].enlat + ps[next].exlat;
+		P ("%4d  %2d  %9u  %12u  %s\n", i, next, APST_ITPT(entry), penalty,
+			(penalty > budget)? "EXCEEDS BUDGET" : "ok");
+		if (penalty > budget)
+			flagged++;
+	}
+
+	// Follow the chain of transitions from the current state as the device
+	// stays idle, and estimate how many requests land in each state assuming
+	// Poisson arrivals: P(idle gap > T) = exp(-IOPS * T).
+	P ("\n[Idle Path from PS %u]\n", pm & 0x1f);
+	P ("Idle (ms)  PS  Wake-up (us)  Requests hit  Tail impact\n");
+	P ("---------  --  ------------  ------------  -----------\n");
+	memset(visited, 0, sizeof(visited));
+	cur = pm & 0x1f;
+	idle_ms = 0;
+	for (hops = 0; (res & 0x1) && cur < n && !visited[cur]; hops++) {
+		visited[cur] = 1;
+		entry = *((__u32 *) &apst[cur * APST_ENTRY_SIZE]);
+		next = APST_ITPS(entry);
+		if (APST_ITPT(entry) == 0 || next >= n)
+			break;
+		idle_ms += APST_ITPT(entry);
+		penalty = ps[next].enlat + ps[next].exlat;
+		frac = exp(-(double) iops * idle_ms / 1000.0);
+		P ("%9.0f  %2d  %12u  %11.4f%%  %s\n", idle_ms, next, penalty, frac * 100,
+			(frac >= 0.01)? "p99 and above" : (frac >= 0.001)? "p99.9 and above" :
+			(frac >= 0.0001)? "p99.99 only" : "negligible");
+		if (frac >= 0.01 && penalty > p99)
+			p99 = penalty;
+		if (frac >= 0.001 && penalty > p999)
+			p999 = penalty;
+		if (penalty > worst)
+			worst = penalty;
+		cur = next;
+	}
+	if (!(res & 0x1))
+		P ("APST is disabled; the controller stays in the host-selected power state\n");
+
+	P ("\n[Summary]\n");
+	P ("Worst-case wake-up penalty on the idle path: %u usec\n", worst);
+	P ("Expected added p99 latency:   %.0f usec\n", p99);
+	P ("Expected added p99.9 latency: %.0f usec\n", p999);
+	P ("Transitions over the %ld usec budget: %d\n", budget, flagged);
+	if (flagged || p999 > budget)
+		P ("WARNING: a latency-sensitive workload can fall into a state whose wake-up exceeds %ld usec\n",
+			budget);
+	P ("Note: bursty arrivals have longer idle gaps than Poisson ones; treat these as lower bounds\n");
+	P ("\n\n");
+
+	nvmed_put_buffer(apst);
+	return 0;
+}
+
+
+// Builds an APST table in which every power state transitions to the next
+// deeper non-operational state whose wake-up (ENLAT + EXLAT) fits in budget_us.
+// The idle time before a transition is at least idle_ms and at least 50 times
+// the wake-up cost, so that transitions cost no more than 2% of the idle time.
+// Returns the number of usable non-operational states.
+int nvmed_info_apst_build (struct power_state *ps, int n, long budget_us, long idle_ms, __u8 *table)
+{
+	int state, usable = 0;
+	__u64 target = 0;
+	__u64 total_us, itpt;
+
+	memset(table, 0, APST_TABLE_SIZE);
+
+	for (state = n - 1; state >= 0; state--) {
+		*((__u64 *) &table[state * APST_ENTRY_SIZE]) = target;
+
+		if (!ps[state].nops)
+			continue;
+		total_us = (__u64) ps[state].enlat + ps[state].exlat;
+		if (total_us > (__u64) budget_us)
+			continue;
+
+		itpt = (total_us * 50 + 999) / 1000;
+		if (itpt < (__u64) idle_ms)
+			itpt = idle_ms;
+		if (itpt > 0xffffff)
+			itpt = 0xffffff;
+		target = (itpt << 8) | ((__u64) state << 3);
+		usable++;
+	}
+	return usable;
+}
+
+// Usage: apst generate --max-latency-us N [--idle-ms M] [--apply] [--save]
+int nvmed_info_apst_generate (NVMED *nvmed, char **cmd_args)
+{
+	__u8 *apst;
+	__u8 table[APST_TABLE_SIZE];
+	__u32 res;
+	struct power_state ps[MAX_POWER_STATES];
+	struct feature_txn txn[1];
+	int n, k, usable, save;
+	long budget, idle_ms;
+
+	budget = nvmed_info_opt_long(cmd_args, "--max-latency-us", -1);
+	idle_ms = nvmed_info_opt_long(cmd_args, "--idle-ms", 100);
+	save = nvmed_info_opt_flag(cmd_args, "--save");
+	if (budget < 0 || idle_ms < 0) {
+		printf("Usage: apst generate --max-latency-us N [--idle-ms M] [--apply] [--save]\n");
+		return -1;
+	}
+
+	apst = (__u8 *) nvmed_get_buffer(nvmed, 1);
+	if (apst == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+
+	n = nvmed_info_apst_read(nvmed, apst, ps, &res);
+	if (n < 0) {
+		nvmed_put_buffer(apst);
+		return -1;
+	}
+	nvmed_put_buffer(apst);
+
+	usable = nvmed_info_apst_build(ps, n, budget, idle_ms, table);
+
+	PRINT_NVMED_INFO;
+	P ("APST Table (latency budget: %ld usec, minimum idle: %ld msec)\n", budget, idle_ms);
+	P ("Bytes      Values       Description\n");
+	P ("---------  -----------  -----------\n");
+	if (usable == 0)
+		P ("No non-operational power state fits in the budget; APST should stay disabled\n");
+	nvmed_info_print_apst_table(table);
+	P ("\n");
+	print_bytes(table, APST_TABLE_SIZE);
+
+	if (nvmed_info_opt_flag(cmd_args, "--apply")) {
+		if (save && !nvmed_info_features_save_supported(nvmed)) {
+			printf("The controller does not support the Save field (ONCS bit 4)\n");
+			return -1;
+		}
+
+		n = 0;
+		k = nvmed_info_feature_txn_add(txn, &n, FEATURE_AUTO_POWER_STATE_TRANSITION,
+				0x1, usable? 0x1 : 0x0);
+		txn[k].verify_mask = 0x1;
+		txn[k].has_data = 1;
+		memcpy(txn[k].next_data, table, APST_TABLE_SIZE);
+
+		if (nvmed_info_feature_txn_apply(nvmed, txn, n, save) < 0)
+			return -1;
+		P ("\nAPST table applied%s (APSTE: %s)\n", save? " and saved" : "", usable? "Yes" : "No");
+	}
+	P ("\n\n");
+
+	return 0;
+}
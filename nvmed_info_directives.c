@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd directives_cmds[] = {
+	{"status", 1, "Supported directives and Streams parameters", nvmed_info_directives_status},
+	{"enable", 1, "Enable the Streams directive for a namespace", nvmed_info_directives_enable},
+	{"disable", 1, "Disable the Streams directive for a namespace", nvmed_info_directives_disable},
+	{"allocate", 1, "Allocate stream resources to a namespace", nvmed_info_directives_allocate},
+	{"release", 1, "Release stream resources or one stream identifier", nvmed_info_directives_release},
+	{NULL, 0, NULL, NULL}
+};
+
+// Optional Admin Command Support (OACS), NVMe 1.3
+#define OACS_DIRECTIVES		(1 << 5)
+
+static int directives_nsid (char *arg)
+{
+	int nsid = arg? atoi(arg) : 1;
+
+	if (nsid <= 0) {
+		printf("Invalid namespace ID %d\n", nsid);
+		return -1;
+	}
+	return nsid;
+}
+
+// Reads the controller and the namespace's streams, failing unless the
+// controller supports the Streams directive
+static int directives_check (int nsid, struct nvmed_info_namespace *ns, struct nvmed_info_streams *st)
+{
+	struct nvmed_info_controller ctrl;
+	int rc;
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+	if (!(ctrl.oacs & OACS_DIRECTIVES)) {
+		printf("The controller does not support Directives (OACS bit 5)\n");
+		return -1;
+	}
+	rc = nvmed_info_read_namespace(dev_info, nsid, ns);
+	if (rc) {
+		printf("IDENTIFY Namespace %d failed (%d)\n", nsid, rc);
+		return -1;
+	}
+	rc = nvmed_info_read_streams(dev_info, nsid, st);
+	if (rc) {
+		printf("Directive Receive for namespace %d failed (%d)\n", nsid, rc);
+		return -1;
+	}
+	if (!st->supported) {
+		printf("The controller does not support the Streams directive\n");
+		return -1;
+	}
+	return 0;
+}
+
+int nvmed_info_directives (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	if (cmd_args[0] == NULL)
+		return nvmed_info_directives_status(nvmed, NULL);
+
+	c = cmd_lookup(directives_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_directives_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_directives_help (char *s)
+{
+	return cmd_help(s, "DIRECTIVES subcommands", directives_cmds);
+}
+
+// Usage: directives status [nsid]
+int nvmed_info_directives_status (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_namespace ns;
+	struct nvmed_info_streams st;
+	__u8 *p;
+	__u32 lba;
+	int nsid, i, open, rc;
+
+	nsid = directives_nsid(cmd_args? cmd_args[0] : NULL);
+	if (nsid < 0 || directives_check(nsid, &ns, &st) < 0)
+		return -1;
+	lba = 1U << ns.lbaf[ns.flbas & 0xf].lbads;
+
+	PRINT_NVMED_INFO;
+	P ("DIRECTIVES (namespace %d)\n", nsid);
+	P ("Directive   Supported  Enabled  Persistent\n");
+	P ("----------  ---------  -------  ----------\n");
+	P ("%-10s  %-9s  %-7s  %s\n", "Identify", "Yes", "Yes", "-");
+	P ("%-10s  %-9s  %-7s  %s\n", "Streams", "Yes", st.enabled? "Yes" : "No", st.persistent? "Yes" : "No");
+
+	P ("\n[Streams, NVM subsystem]\n");
+	P ("%-40s  %u\n", "Max Streams Limit (MSL)", st.msl);
+	P ("%-40s  %u\n", "NVM Subsystem Streams Available (NSSA)", st.nssa);
+	P ("%-40s  %u\n", "NVM Subsystem Streams Open (NSSO)", st.nsso);
+
+	P ("\n[Streams, namespace %d]\n", nsid);
+	P ("%-40s  %u blocks (%llu bytes)\n", "Stream Write Size (SWS)", st.sws,
+		(unsigned long long) st.sws * lba);
+	P ("%-40s  %u SWS (%llu bytes)\n", "Stream Granularity Size (SGS)", st.sgs,
+		(unsigned long long) st.sgs * st.sws * lba);
+	P ("%-40s  %u\n", "Namespace Streams Allocated (NSA)", st.nsa);
+	P ("%-40s  %u\n", "Namespace Streams Open (NSO)", st.nso);
+
+	// Get Status lists the open stream identifiers; it needs the directive enabled
+	p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	if (st.enabled && p) {
+		memset(p, 0, PAGE_SIZE);
+		rc = nvmed_info_ctx_directive(dev_info, NVME_ADMIN_DIRECTIVE_RECV, nsid, DIRECTIVE_STREAMS,
+				DIR_RECV_STREAMS_STATUS, 0, 0, p, PAGE_SIZE, NULL);
+		if (rc)
+			P ("%-40s  Get Status failed (%d)\n", "Open Stream Identifiers", rc);
+		else {
+			open = U16(0);
+			P ("%-40s  %d%s", "Open Stream Identifiers", open, open? ":" : "");
+			for (i = 0; i < open && 2 + i * 2 + 1 < PAGE_SIZE; i++)
+				P (" %u", U16(2 + i * 2));
+			P ("\n");
+		}
+	}
+
+	if (!st.enabled)
+		P ("\nStreams are disabled for namespace %d; \"directives enable %d\" turns them on.\n", nsid, nsid);
+	else if (st.nsa == 0)
+		P ("\nNo stream resources are allocated to namespace %d; writes may still open streams\n"
+		   "from the NVM subsystem pool (NSSA) until it runs out.\n", nsid);
+	P ("\n\n");
+	return 0;
+}
+
+static int directives_enable_issue (char **cmd_args, int enable)
+{
+	struct nvmed_info_namespace ns;
+	struct nvmed_info_streams st;
+	int nsid, rc;
+
+	nsid = directives_nsid(cmd_args? cmd_args[0] : NULL);
+	if (nsid < 0 || directives_check(nsid, &ns, &st) < 0)
+		return -1;
+
+	// Enable Directive: DTYPE in CDW12 bits 15:8, ENDIR in bit 0
+	rc = nvmed_info_ctx_directive(dev_info, NVME_ADMIN_DIRECTIVE_SEND, nsid, DIRECTIVE_IDENTIFY,
+			DIR_SEND_IDENTIFY_ENABLE, 0, (DIRECTIVE_STREAMS << 8) | (enable? 1 : 0), NULL, 0, NULL);
+	if (rc) {
+		printf("Enable Directive failed (%d)\n", rc);
+		return -1;
+	}
+	P ("Streams directive %s for namespace %d\n", enable? "enabled" : "disabled", nsid);
+	return 0;
+}
+
+// Usage: directives enable [nsid]
+int nvmed_info_directives_enable (NVMED *nvmed, char **cmd_args)
+{
+	return directives_enable_issue(cmd_args, 1);
+}
+
+// Usage: directives disable [nsid]
+int nvmed_info_directives_disable (NVMED *nvmed, char **cmd_args)
+{
+	return directives_enable_issue(cmd_args, 0);
+}
+
+// Usage: directives allocate <nsid> <count>
+// Streams are granted from NSSA; the controller may allocate fewer than
+// requested.
+int nvmed_info_directives_allocate (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_namespace ns;
+	struct nvmed_info_streams st;
+	__u32 res;
+	int nsid, count, rc;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL || cmd_args[1] == NULL) {
+		printf("Give the namespace ID and the number of streams\n");
+		return -1;
+	}
+	nsid = directives_nsid(cmd_args[0]);
+	count = atoi(cmd_args[1]);
+	if (nsid < 0 || directives_check(nsid, &ns, &st) < 0)
+		return -1;
+	if (count <= 0 || count > st.msl) {
+		printf("The number of streams must be between 1 and %u (MSL)\n", st.msl);
+		return -1;
+	}
+	if (!st.enabled) {
+		printf("Streams are disabled for namespace %d\n", nsid);
+		return -1;
+	}
+
+	rc = nvmed_info_ctx_directive(dev_info, NVME_ADMIN_DIRECTIVE_RECV, nsid, DIRECTIVE_STREAMS,
+			DIR_RECV_STREAMS_ALLOCATE, 0, count, NULL, 0, &res);
+	if (rc) {
+		printf("Allocate Resources failed (%d)\n", rc);
+		return -1;
+	}
+	P ("%u of %d stream%s allocated to namespace %d\n", le32toh(res) & 0xffff, count,
+		(count == 1)? "" : "s", nsid);
+	return 0;
+}
+
+// Usage: directives release <nsid> [stream]
+// Without a stream identifier, all of the namespace's stream resources are
+// returned to the NVM subsystem.
+int nvmed_info_directives_release (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_namespace ns;
+	struct nvmed_info_streams st;
+	int nsid, sid = 0, rc;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL) {
+		printf("Give the namespace ID\n");
+		return -1;
+	}
+	nsid = directives_nsid(cmd_args[0]);
+	if (cmd_args[1]) {
+		sid = atoi(cmd_args[1]);
+		if (sid <= 0 || sid > 0xffff) {
+			printf("Invalid stream identifier %d\n", sid);
+			return -1;
+		}
+	}
+	if (nsid < 0 || directives_check(nsid, &ns, &st) < 0)
+		return -1;
+
+	rc = nvmed_info_ctx_directive(dev_info, NVME_ADMIN_DIRECTIVE_SEND, nsid, DIRECTIVE_STREAMS,
+			sid? DIR_SEND_STREAMS_RELEASE_ID : DIR_SEND_STREAMS_RELEASE, sid, 0, NULL, 0, NULL);
+	if (rc) {
+		printf("%s failed (%d)\n", sid? "Release Identifier" : "Release Resources", rc);
+		return -1;
+	}
+	if (sid)
+		P ("Stream %d of namespace %d released\n", sid, nsid);
+	else
+		P ("Stream resources of namespace %d released (%u were allocated)\n", nsid, st.nsa);
+	return 0;
+}
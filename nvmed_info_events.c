@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+// The nvme driver keeps its own Asynchronous Event Request outstanding and
+// consumes every completion; it re-arms the request and reports the
+// completion Dword 0 as a "change" uevent of the controller carrying
+// NVME_AEN=0x<result>.  Listening for those uevents sees every event the
+// driver forwards without taking AER slots or admin tags away from it.
+
+// Asynchronous Event Request completion, Dword 0 (Figure 45, p.73)
+#define AER_TYPE(r)			((r) & 0x7)
+#define AER_INFO(r)			(((r) >> 8) & 0xff)
+#define AER_LOG(r)			(((r) >> 16) & 0xff)
+
+#define AER_TYPE_ERROR		0
+#define AER_TYPE_SMART		1
+#define AER_TYPE_NOTICE		2
+#define AER_TYPE_IO			6
+#define AER_TYPE_VENDOR		7
+
+// Asynchronous Event Configuration (Figure 123, p.132); the notices are
+// left as the driver configured them
+#define AEC_SMART			0x1f
+
+// Retain Asynchronous Event (CDW10 bit 15) of GET LOG PAGE
+#define LOG_RAE				(1 << 15)
+
+#define UEVENT_BUF_SIZE		4096
+
+static char *aer_error_info[] = {
+	"Invalid Submission Queue", "Invalid Doorbell Write Value", "Diagnostic Failure",
+	"Persistent Internal Error", "Transient Internal Error", "Firmware Image Load Error", NULL };
+static char *aer_smart_info[] = {
+	"NVM Subsystem Reliability", "Temperature Threshold", "Spare Below Threshold", NULL };
+static char *aer_notice_info[] = {
+	"Namespace Attribute Changed", "Firmware Activation Starting", NULL };
+static char *aer_io_info[] = {
+	"Reservation Log Page Available", NULL };
+
+static struct {
+	NVMED *nvmed;
+	char ctrl[32];						// kernel controller, e.g. "nvme0"
+	long seen;
+	long max;
+} events;
+
+static volatile sig_atomic_t events_stop;
+
+static void events_signal (int sig)
+{
+	events_stop = 1;
+}
+
+static char *events_lookup (char **names, int info)
+{
+	int i;
+
+	for (i = 0; names[i]; i++)
+		if (i == info)
+			return names[i];
+	return "Reserved";
+}
+
+// Reads the first 512 bytes of a log page.  Notice log pages are read with
+// RAE set: the driver reads them too (e.g. the Changed Namespace List to
+// rescan namespaces), and a read without RAE would clear them first.
+static int events_get_log (int lid, int rae, __u8 *p)
+{
+	struct nvme_admin_cmd cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_get_log_page;
+	cmd.nsid = htole32(0xffffffff);
+	cmd.addr = (__u64) htole64((unsigned long) p);
+	cmd.data_len = htole32(512);
+	cmd.cdw10 = htole32(((512 / 4 - 1) << 16) | (rae? LOG_RAE : 0) | lid);
+	return nvmed_info_ctx_admin(dev_info, &cmd);
+}
+
+// Decodes a completion and fetches the log page it points to; reading a
+// SMART / Health or Error log page without RAE is what lets the controller
+// report that event type again
+static void events_handle (__u32 result)
+{
+	int type = AER_TYPE(result), info = AER_INFO(result), lid = AER_LOG(result);
+	__u8 *p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	char when[32];
+	time_t t = time(NULL);
+	char *tname, *iname;
+	int rc;
+
+	switch (type) {
+		case AER_TYPE_ERROR:	tname = "Error Status";		iname = events_lookup(aer_error_info, info);	break;
+		case AER_TYPE_SMART:	tname = "SMART / Health Status";	iname = events_lookup(aer_smart_info, info);	break;
+		case AER_TYPE_NOTICE:	tname = "Notice";			iname = events_lookup(aer_notice_info, info);	break;
+		case AER_TYPE_IO:		tname = "I/O Command Set Specific";	iname = events_lookup(aer_io_info, info);	break;
+		case AER_TYPE_VENDOR:	tname = "Vendor Specific";	iname = "";		break;
+		default:				tname = "Reserved";			iname = "";		break;
+	}
+
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+	P ("[%s] Event 0x%08x: %s (%d), %s (0x%02x), Log Page 0x%02x\n", when, result,
+		tname, type, iname, info, lid);
+
+	if (lid == 0 || p == NULL)
+		return;
+	memset(p, 0, 512);
+	rc = events_get_log(lid, type == AER_TYPE_NOTICE || type == AER_TYPE_IO, p);
+	if (rc) {
+		P ("GET LOG PAGE 0x%02x failed (%d)\n\n", lid, rc);
+		return;
+	}
+	P ("Log Pages  Values      Description\n");
+	P ("---------  ----------  -----------\n");
+	if (nvmed_info_logs_print(events.nvmed, lid, 0, p, 512, 0) < 0)
+		print_bytes(p, 512);
+	P ("\n");
+	fflush(stdout);
+}
+
+// Handles one uevent message: "change@<devpath>" followed by KEY=value
+// strings; returns 1 if it was an event of our controller
+static int events_uevent (char *buf, int len)
+{
+	char *s, *devpath = NULL, *subsystem = NULL, *aen = NULL, *name;
+
+	for (s = buf; s < buf + len; s += strlen(s) + 1) {
+		if (!strncmp(s, "DEVPATH=", 8))
+			devpath = s + 8;
+		else if (!strncmp(s, "SUBSYSTEM=", 10))
+			subsystem = s + 10;
+		else if (!strncmp(s, "NVME_AEN=", 9))
+			aen = s + 9;
+	}
+	if (devpath == NULL || subsystem == NULL || aen == NULL || strcmp(subsystem, "nvme"))
+		return 0;
+	name = strrchr(devpath, '/');
+	if (strcmp(name? name + 1 : devpath, events.ctrl))
+		return 0;
+	events_handle((__u32) strtoul(aen, NULL, 0));
+	return 1;
+}
+
+// Usage: events [--count N]
+int nvmed_info_events (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_inventory inv;
+	struct sockaddr_nl addr;
+	struct pollfd pfd;
+	char buf[UEVENT_BUF_SIZE];
+	__u32 aec, res;
+	int fd, n, rc;
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+	if (nvmed_info_read_inventory(nvmed_info_ctx_path(dev_info), &inv) || inv.ctrl[0] == '\0') {
+		printf("Cannot find the kernel controller of %s\n", nvmed_info_ctx_path(dev_info));
+		return -1;
+	}
+
+	memset(&events, 0, sizeof(events));
+	events_stop = 0;
+	events.nvmed = nvmed;
+	snprintf(events.ctrl, sizeof(events.ctrl), "%s", inv.ctrl);
+	events.max = nvmed_info_opt_long(cmd_args, "--count", 0);
+	if (events.max < 0) {
+		printf("Invalid --count\n");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;					// kernel uevents
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		printf("Cannot listen for kernel uevents\n");
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	// Add the critical warnings to what the driver enabled
+	if (nvmed_info_get_features_issue(nvmed, FEATURE_ASYNC_EVENT_CONFIG, 0, NULL, 0, &aec) < 0 ||
+			nvmed_info_set_features_issue(nvmed, FEATURE_ASYNC_EVENT_CONFIG, 0, aec | AEC_SMART, 0,
+				NULL, 0, &res) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("Waiting for asynchronous events of %s (NVME_AEN uevents of %s)\n\n",
+		nvmed_info_ctx_path(dev_info), events.ctrl);
+	fflush(stdout);
+
+	signal(SIGINT, events_signal);
+	signal(SIGTERM, events_signal);
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (!events_stop && (events.max == 0 || events.seen < events.max)) {
+		if (poll(&pfd, 1, 1000) <= 0)
+			continue;
+		n = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (n <= 0)
+			continue;
+		buf[n] = '\0';
+		events.seen += events_uevent(buf, n);
+	}
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	close(fd);
+
+	nvmed_info_set_features_issue(nvmed, FEATURE_ASYNC_EVENT_CONFIG, 0, aec, 0, NULL, 0, &res);
+	P ("%ld event%s received; Asynchronous Event Configuration restored to 0x%08x\n\n",
+		events.seen, (events.seen == 1)? "" : "s", aec);
+	return 0;
+}
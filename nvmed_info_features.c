@@ -9,6 +9,8 @@
 
 struct nvmed_info_cmd features_cmds[] = {
 	{"get", 1, "GET FEATURES", nvmed_info_get_features},
+	{"set", 1, "SET FEATURES (transactional)", nvmed_info_set_features},
+	{"drift", 1, "Fields differing from default or saved values", nvmed_info_features_drift},
 	{NULL, 0, NULL, NULL}
 };
 
@@ -34,6 +36,8 @@ static struct feature_set features[] = {
 	{FEATURE_AUTO_POWER_STATE_TRANSITION,	0, 	256,	"Autonomous Power State Transition"},
 	{FEATURE_HOST_MEMORY_BUFFER,			0, 	4096,	"Host Memory Buffer"},
 	{FEATURE_KEEP_ALIVE_TIMER,				0,	0,		"Keep Alive Timer"},
+	{FEATURE_PLM_CONFIG,					SCOPE_NVM_SET,	512,	"Predictable Latency Mode Config"},
+	{FEATURE_PLM_WINDOW,					SCOPE_NVM_SET,	0,		"Predictable Latency Mode Window"},
 	{FEATURE_SW_PROGRESS_MARKER,			0, 	0,		"Software Progress Marker"},
 	{FEATURE_HOST_IDENTIFIER,				0, 	4096,	"Host Identifier"},
 	{FEATURE_RESERVATION_NOTI_MASK,			0, 	0,		"Reservation Notification Mask"},
@@ -47,8 +51,8 @@ int nvmed_info_features (NVMED *nvmed, char **cmd_args)
 {
 	struct nvmed_info_cmd *c;
 
-	if (cmd_args[0] == NULL)
-		return nvmed_info_get_features(nvmed, NULL);
+	if (cmd_args[0] == NULL || cmd_args[0][0] == '-')
+		return nvmed_info_get_features(nvmed, cmd_args);
 
 	c = cmd_lookup(features_cmds, cmd_args[0]);
 	if (c)
@@ -65,6 +69,12 @@ int nvmed_info_features_help (char *s)
 }
 
 int nvmed_info_get_features_issue (NVMED *nvmed, int fid, int nsid, __u8 *p, int len, __u32 *result)
+{
+	return nvmed_info_get_features_ext_issue(nvmed, fid, FEATURE_SEL_CURRENT, nsid, 0, p, len, result);
+}
+
+int nvmed_info_get_features_ext_issue (NVMED *nvmed, int fid, int sel, int nsid, __u32 cdw11,
+		__u8 *p, int len, __u32 *result)
 {
 	struct nvme_admin_cmd cmd;
 	int rc;
@@ -74,21 +84,61 @@ int nvmed_info_get_features_issue (NVMED *nvmed, int fid, int nsid, __u8 *p, int
 	if (nsid)
 		cmd.nsid = htole32(nsid);
 	if (p) {
-		cmd.addr = (__u64) htole64(p);
+		cmd.addr = (__u64) htole64((unsigned long) p);
 		cmd.data_len = htole32(len);
 	}
-	cmd.cdw10 = htole32(fid);
+	cmd.cdw10 = htole32(sel | fid);
+	cmd.cdw11 = htole32(cdw11);
 
 	rc = nvmed_info_admin_command(nvmed, &cmd);
 	*result = cmd.result;
 	return rc;
 }
 
+int nvmed_info_set_features_issue (NVMED *nvmed, int fid, int nsid, __u32 cdw11, int save,
+		__u8 *p, int len, __u32 *result)
+{
+	struct nvme_admin_cmd cmd;
+	int rc;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_set_features;
+	if (nsid)
+		cmd.nsid = htole32(nsid);
+	if (p) {
+		cmd.addr = (__u64) htole64((unsigned long) p);
+		cmd.data_len = htole32(len);
+	}
+	cmd.cdw10 = htole32((save? FEATURE_SAVE : 0) | fid);
+	cmd.cdw11 = htole32(cdw11);
+
+	rc = nvmed_info_admin_command(nvmed, &cmd);
+	if (result)
+		*result = cmd.result;
+	return rc;
+}
+
+// Prints the 256-byte APST data structure; entry i describes power state i.
+void nvmed_info_print_apst_table (__u8 *p)
+{
+	int i;
+	__u32 _v;
+
+	for (i = 0; i < APST_TABLE_SIZE; i += APST_ENTRY_SIZE) {
+		if (U64(i) == 0)
+			continue;
+
+		P ("Power State %d\n", i / APST_ENTRY_SIZE);
+			PH1 (i+0);	P ("Idle Transition Power State (ITPS): %u\n", F(3,7));
+			PV (i+1, i+3, "Idle Time Prior to Transition (ITPT)", "(msec)");
+	}
+}
+
 int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 {
 	int rc;
 	__u32 res;
-	int nsid = 1;
+	int nsid = 1, setid;
 	struct feature_set *f;
 	__u8 *p;
 	__u32 _v;
@@ -99,13 +149,18 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 		return -1;
 	}
 
-	if (cmd_args && cmd_args[0]) {
+	if (cmd_args && cmd_args[0] && cmd_args[0][0] != '-') {
 		nsid = atoi(cmd_args[0]);
 		if (nsid <= 0) {
 			printf("Invalid namespace ID %d\n", nsid);
 			return -1;
 		}
 	}
+	setid = nvmed_info_opt_long(cmd_args, "--set", 1);
+	if (setid <= 0 || setid > 0xffff) {
+		printf("Invalid NVM Set ID %d\n", setid);
+		return -1;
+	}
 
 	PRINT_NVMED_INFO;
 	P ("GET FEATURES\n");
@@ -114,7 +169,8 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 
 	f = features;
 	while (f->fname) {
-		rc = nvmed_info_get_features_issue(nvmed, f->fid, f->cns? nsid : 0, 
+		rc = nvmed_info_get_features_ext_issue(nvmed, f->fid, FEATURE_SEL_CURRENT,
+				(f->cns == SCOPE_NAMESPACE)? nsid : 0, (f->cns == SCOPE_NVM_SET)? setid : 0,
 				f->datalen? p : NULL, f->datalen, &res);
 		if (rc < 0) {
 			P ("    %02x     ----N/A---  %s\n", f->fid, f->fname);
@@ -122,9 +178,11 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 			continue;
 		}
 		else {
-			printf ("\n    %02x     0x%08x  %s", f->fid, res, f->fname);
-			if (f->cns)
+			P ("\n    %02x     0x%08x  %s", f->fid, res, f->fname);
+			if (f->cns == SCOPE_NAMESPACE)
 				P (" (Namespace ID: %d)\n", nsid);
+			else if (f->cns == SCOPE_NVM_SET)
+				P (" (NVM Set ID: %d)\n", setid);
 			else
 				P ("\n");
 		}
@@ -190,7 +248,7 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 						P ("Temperature sensor %d\n", F(16,19));
 						break;
 					default:
-						printf ("Reserved\n");
+						P ("Reserved\n");
 				}
 				P ("%24c  Temperature Threshold (TMPTH): %u\n", SP, F(0,15));
 				break;
@@ -212,9 +270,9 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 			case FEATURE_INTERRUPT_COALESCING:	/* Interrupt Coalescing */
 				P ("%24c  Aggregation Time: ", SP);
 				if (F(8,15))
-					printf ("%u (100 msec)\n", F(8,15));
+					P ("%u (100 msec)\n", F(8,15));
 				else 
-					printf ("No delay\n");
+					P ("No delay\n");
 				P ("%24c  Aggreation Threshold (THR): %u (entries)\n", SP, F(0,7));
 				break;
 
@@ -233,20 +291,9 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 				P ("%24c  SMART / Health Critical Warnings: 0x%02x\n", SP, F(0,7));
 				break;
 
-			case FEATURE_AUTO_POWER_STATE_TRANSITION: {	/* Autonomous Power State Transition */
-				int i;
-
+			case FEATURE_AUTO_POWER_STATE_TRANSITION:	/* Autonomous Power State Transition */
 				P ("%24c  Autonomous Power State Transition Enable (APSTE): %s\n", SP, YN(0));
-
-				for (i = 0; i < 256; i += 8) {
-					if (U64(p[i]) == 0) 
-						break;
-
-					P ("Power State %d\n", i/8);
-						PH1 (i*8+0);	P ("Idle Transition Power State (ITPS): %u\n", F(3,7));
-						PV (i*8+1, i*8+3, "Idle Time Prior to Transition (ITPT):", "(msec)");
-				}
-			  	} 
+				nvmed_info_print_apst_table(p);
 				break;
 
 			case FEATURE_HOST_MEMORY_BUFFER: {	/* Host Memory Buffer */
@@ -264,6 +311,26 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 				P ("%24c  Keep Alive Timeout (KATO): %u (msec)\n", SP, F(0,31));
 				break;
 
+			case FEATURE_PLM_CONFIG:	/* Predictable Latency Mode Config */
+				P ("%24c  Predictable Latency Enable (LPE): %s\n", SP, YN(0));
+				P ("Predictable Latency Mode Config Structure\n");
+					PH2 (0);	P ("Enable Event:\n");
+								P ("%26c  DTWIN Reads Warning: %s\n", SP, YN(0));
+								P ("%26c  DTWIN Writes Warning: %s\n", SP, YN(1));
+								P ("%26c  DTWIN Time Warning: %s\n", SP, YN(2));
+								P ("%26c  Autonomous transition, typical or maximum exceeded: %s\n", SP, YN(14));
+								P ("%26c  Autonomous transition, Deterministic Excursion: %s\n", SP, YN(15));
+					PV (32, 39, "DTWIN Reads Threshold", "(4 KiB reads)");
+					PV (40, 47, "DTWIN Writes Threshold", "(Optimal Write Size units)");
+					PV (48, 55, "DTWIN Time Threshold", "(msec)");
+				break;
+
+			case FEATURE_PLM_WINDOW:	/* Predictable Latency Mode Window */
+				P ("%24c  Window Select (WS): %s\n", SP,
+						(F(0,2) == 1)? "Deterministic Window (DTWIN)" :
+						(F(0,2) == 2)? "Non-Deterministic Window (NDWIN)" : "Reserved");
+				break;
+
 			case FEATURE_SW_PROGRESS_MARKER:	/* Software Progress Marker */
 				P ("%24c  Pre-boot Software Load Count (PBSLC): %u\n", SP, F(0,7));
 				break;
@@ -293,3 +360,399 @@ int nvmed_info_get_features (NVMED *nvmed, char **cmd_args)
 	return 0;
 }
 
+
+
+
+// Fields of the Dword 11 / Dword 0 value of each feature.
+// The key selects bits [start,end]; "features set" accepts the settable ones.
+struct feature_field {
+	char *key;
+	int fid;
+	int start;
+	int end;
+	int settable;
+	int verify;			// whether the field is expected to read back as written
+	char *fname;
+};
+
+static struct feature_field feature_fields[] = {
+	{"arb.ab",		FEATURE_ARBITRATION,		0,	2,	1,	1,	"Arbitration Burst (AB)"},
+	{"arb.lpw",		FEATURE_ARBITRATION,		8,	15,	1,	1,	"Low Priority Weight (LPW)"},
+	{"arb.mpw",		FEATURE_ARBITRATION,		16,	23,	1,	1,	"Medium Priority Weight (MPW)"},
+	{"arb.hpw",		FEATURE_ARBITRATION,		24,	31,	1,	1,	"High Priority Weight (HPW)"},
+	// PS may be changed by the controller itself while APST is enabled
+	{"pm.ps",		FEATURE_POWER_MANAGEMENT,	0,	4,	1,	0,	"Power State (PS)"},
+	{"pm.wh",		FEATURE_POWER_MANAGEMENT,	5,	7,	1,	1,	"Workload Hint (WH)"},
+	{"tt.tmpth",	FEATURE_TEMPERATURE_THRESHOLD,	0,	15,	0,	0,	"Temperature Threshold (TMPTH)"},
+	{"err.tler",	FEATURE_ERROR_RECOVERY,		0,	15,	0,	0,	"Time Limited Error Recovery (TLER)"},
+	{"err.dulbe",	FEATURE_ERROR_RECOVERY,		16,	16,	0,	0,	"Deallocated Logical Block Error Enable (DULBE)"},
+	{"vwc.wce",		FEATURE_VOLATILE_WRITE_CACHE,	0,	0,	1,	1,	"Volatile Write Cache Enable (WCE)"},
+	{"nq.nsqa",		FEATURE_NUMBER_OF_QUEUES,	0,	15,	0,	0,	"Number of I/O Submission Queues (NSQA)"},
+	{"nq.ncqa",		FEATURE_NUMBER_OF_QUEUES,	16,	31,	0,	0,	"Number of I/O Completion Queues (NCQA)"},
+	{"coal.thr",	FEATURE_INTERRUPT_COALESCING,	0,	7,	1,	1,	"Aggregation Threshold (THR)"},
+	{"coal.time",	FEATURE_INTERRUPT_COALESCING,	8,	15,	1,	1,	"Aggregation Time (TIME)"},
+	{"ivc.iv",		FEATURE_INTERRUPT_VECTOR_CONFIG,	0,	15,	1,	1,	"Interrupt Vector (IV)"},
+	{"ivc.cd",		FEATURE_INTERRUPT_VECTOR_CONFIG,	16,	16,	1,	1,	"Coalescing Disable (CD)"},
+	{"wan.dn",		FEATURE_WRITE_ATOMICITY_NORMAL,	0,	0,	0,	0,	"Disable Normal (DN)"},
+	{"aec.smart",	FEATURE_ASYNC_EVENT_CONFIG,	0,	7,	0,	0,	"SMART / Health Critical Warnings"},
+	{"aec.nan",		FEATURE_ASYNC_EVENT_CONFIG,	8,	8,	0,	0,	"Namespace Attribute Notices"},
+	{"aec.fan",		FEATURE_ASYNC_EVENT_CONFIG,	9,	9,	0,	0,	"Firmware Activation Notices"},
+	{"apst.apste",	FEATURE_AUTO_POWER_STATE_TRANSITION,	0,	0,	1,	1,	"APST Enable (APSTE)"},
+	{"hmb.ehm",		FEATURE_HOST_MEMORY_BUFFER,	0,	0,	0,	0,	"Enable Host Memory (EHM)"},
+	{"hmb.mr",		FEATURE_HOST_MEMORY_BUFFER,	1,	1,	0,	0,	"Memory Return (MR)"},
+	{"kat.kato",	FEATURE_KEEP_ALIVE_TIMER,	0,	31,	1,	1,	"Keep Alive Timeout (KATO)"},
+	{"spm.pbslc",	FEATURE_SW_PROGRESS_MARKER,	0,	7,	0,	0,	"Pre-boot Software Load Count (PBSLC)"},
+	{"rnm.regpre",	FEATURE_RESERVATION_NOTI_MASK,	1,	1,	0,	0,	"Mask Registration Preempted (REGPRE)"},
+	{"rnm.resrel",	FEATURE_RESERVATION_NOTI_MASK,	2,	2,	0,	0,	"Mask Reservation Released (RESREL)"},
+	{"rnm.respre",	FEATURE_RESERVATION_NOTI_MASK,	3,	3,	0,	0,	"Mask Reservation Preempted (RESPRE)"},
+	{"rp.ptpl",		FEATURE_RESERVATION_PERSISTENCE,	0,	0,	0,	0,	"Persist Through Power Loss (PTPL)"},
+	{NULL,			0,							0,	0,	0,	0,	NULL}
+};
+
+#define FIELD_MASK(s,e)		((__u32) ((((__u64) 1 << ((e) - (s) + 1)) - 1) << (s)))
+
+// Returns the size of the data buffer that goes with the feature
+static int feature_datalen (int fid)
+{
+	struct feature_set *f;
+
+	for (f = features; f->fname; f++)
+		if (f->fid == fid)
+			return f->datalen;
+	return 0;
+}
+
+static char *feature_name (int fid)
+{
+	struct feature_set *f;
+
+	for (f = features; f->fname; f++)
+		if (f->fid == fid)
+			return f->fname;
+	return "Unknown";
+}
+
+static struct feature_field *feature_field_lookup (char *key, int len)
+{
+	struct feature_field *ff;
+
+	for (ff = feature_fields; ff->key; ff++)
+		if (ff->settable && (int) strlen(ff->key) == len && !strncmp(key, ff->key, len))
+			return ff;
+	return NULL;
+}
+
+int nvmed_info_feature_txn_add (struct feature_txn *txn, int *n, int fid, __u32 mask, __u32 value)
+{
+	int i;
+
+	for (i = 0; i < *n; i++)
+		if (txn[i].fid == fid)
+			break;
+
+	if (i == *n) {
+		if (*n >= FEATURE_TXN_MAX)
+			return -1;
+		memset(&txn[i], 0, sizeof(txn[i]));
+		txn[i].fid = fid;
+		txn[i].datalen = feature_datalen(fid);
+		(*n)++;
+	}
+	txn[i].mask |= mask;
+	txn[i].value = (txn[i].value & ~mask) | (value & mask);
+	return i;
+}
+
+static __u32 feature_txn_cdw11 (struct feature_txn *t)
+{
+	// Interrupt Vector Configuration is read per vector
+	if (t->fid == FEATURE_INTERRUPT_VECTOR_CONFIG)
+		return t->value & 0xffff;
+	return 0;
+}
+
+static int feature_txn_restore (NVMED *nvmed, struct feature_txn *txn, int n, int save, __u8 *p)
+{
+	int i, rc = 0;
+
+	for (i = n - 1; i >= 0; i--) {
+		if (!txn[i].applied)
+			continue;
+		// Saving also changes the current value, so the saved one goes first
+		if (save && txn[i].datalen)
+			memcpy(p, txn[i].saved_data, txn[i].datalen);
+		if (save && nvmed_info_set_features_issue(nvmed, txn[i].fid, 0, txn[i].saved, 1,
+					txn[i].datalen? p : NULL, txn[i].datalen, NULL) < 0) {
+			printf("Rollback of the saved value of feature %02x failed\n", txn[i].fid);
+			rc = -1;
+		}
+		if (txn[i].datalen)
+			memcpy(p, txn[i].old_data, txn[i].datalen);
+		if (nvmed_info_set_features_issue(nvmed, txn[i].fid, 0, txn[i].old, 0,
+					txn[i].datalen? p : NULL, txn[i].datalen, NULL) < 0) {
+			printf("Rollback of feature %02x failed\n", txn[i].fid);
+			rc = -1;
+		}
+		txn[i].applied = 0;
+	}
+	return rc;
+}
+
+// Snapshots the current (and, with save, the saved) values of every feature in
+// the transaction, applies them in order, verifies each by reading it back and
+// restores the snapshot of everything applied so far on the first failure.
+int nvmed_info_feature_txn_apply (NVMED *nvmed, struct feature_txn *txn, int n, int save)
+{
+	int i, rc = 0;
+	__u32 res = 0;
+	__u8 *p;
+
+	p = (__u8 *) nvmed_get_buffer(nvmed, 1);
+	if (p == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct feature_txn *t = &txn[i];
+
+		if (t->datalen > FEATURE_TXN_DATA_MAX) {
+			printf("Feature %02x carries too much data (%d bytes)\n", t->fid, t->datalen);
+			rc = -1;
+			goto out;
+		}
+		if (nvmed_info_get_features_ext_issue(nvmed, t->fid, FEATURE_SEL_CURRENT, 0,
+					feature_txn_cdw11(t), t->datalen? p : NULL, t->datalen, &t->old) < 0) {
+			printf("Snapshot of feature %02x failed\n", t->fid);
+			rc = -1;
+			goto out;
+		}
+		if (t->datalen)
+			memcpy(t->old_data, p, t->datalen);
+		if (save) {
+			if (nvmed_info_get_features_ext_issue(nvmed, t->fid, FEATURE_SEL_SAVED, 0,
+						feature_txn_cdw11(t), t->datalen? p : NULL, t->datalen, &t->saved) < 0) {
+				printf("Snapshot of the saved value of feature %02x failed\n", t->fid);
+				rc = -1;
+				goto out;
+			}
+			if (t->datalen)
+				memcpy(t->saved_data, p, t->datalen);
+		}
+		t->next = (t->old & ~t->mask) | t->value;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct feature_txn *t = &txn[i];
+
+		if (t->datalen)
+			memcpy(p, t->has_data? t->next_data : t->old_data, t->datalen);
+		if (nvmed_info_set_features_issue(nvmed, t->fid, 0, t->next, save,
+					t->datalen? p : NULL, t->datalen, NULL) < 0) {
+			printf("SET FEATURES %02x failed\n", t->fid);
+			rc = -1;
+			break;
+		}
+		t->applied = 1;
+
+		if (nvmed_info_get_features_ext_issue(nvmed, t->fid, FEATURE_SEL_CURRENT, 0,
+					feature_txn_cdw11(t), t->datalen? p : NULL, t->datalen, &res) < 0 ||
+				(res & t->verify_mask) != (t->next & t->verify_mask) ||
+				(t->has_data && memcmp(p, t->next_data, t->datalen))) {
+			printf("Feature %02x did not read back as written (0x%08x != 0x%08x)\n",
+					t->fid, res, t->next);
+			rc = -1;
+			break;
+		}
+	}
+
+	if (rc < 0) {
+		printf("Rolling back...\n");
+		if (feature_txn_restore(nvmed, txn, n, save, p) == 0)
+			printf("All features restored to their previous values\n");
+	}
+
+out:
+	nvmed_put_buffer(p);
+	return rc;
+}
+
+int nvmed_info_features_save_supported (NVMED *nvmed)
+{
+	__u8 *p;
+	int rc;
+
+	p = (__u8 *) nvmed_get_buffer(nvmed, 1);
+	if (p == NULL)
+		return 0;
+	rc = nvmed_info_identify_issue(nvmed, CNS_CONTROLLER, 0, p);
+	// ONCS bit 4: Save field in Set Features and Select field in Get Features
+	rc = (rc == 0) && (U16(520) & (1 << 4));
+	nvmed_put_buffer(p);
+	return rc;
+}
+
+// Usage: features set [save] key=value ...
+int nvmed_info_set_features (NVMED *nvmed, char **cmd_args)
+{
+	struct feature_txn txn[FEATURE_TXN_MAX];
+	struct feature_field *ff;
+	int i, k, n = 0, save = 0;
+	char *eq, *end;
+	unsigned long val;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL) {
+		P ("Usage: features set [save] key=value ...\n");
+		P ("%-12s  %-3s  %-7s  %s\n", "Key", "FID", "Bits", "Description");
+		for (ff = feature_fields; ff->key; ff++)
+			if (ff->settable)
+				P ("%-12s  %02x   %2d:%-2d    %s / %s\n", ff->key, ff->fid, ff->end, ff->start,
+					feature_name(ff->fid), ff->fname);
+		return -1;
+	}
+
+	for (i = 0; cmd_args[i]; i++) {
+		if (!strcmp(cmd_args[i], "save")) {
+			save = 1;
+			continue;
+		}
+		eq = strchr(cmd_args[i], '=');
+		ff = eq? feature_field_lookup(cmd_args[i], eq - cmd_args[i]) : NULL;
+		if (ff == NULL) {
+			printf("Invalid feature setting \"%s\"\n", cmd_args[i]);
+			return -1;
+		}
+		val = strtoul(eq + 1, &end, 0);
+		if (*end != '\0' || val > (FIELD_MASK(ff->start, ff->end) >> ff->start)) {
+			printf("Invalid value for %s: %s\n", ff->key, eq + 1);
+			return -1;
+		}
+		k = nvmed_info_feature_txn_add(txn, &n, ff->fid, FIELD_MASK(ff->start, ff->end),
+					(__u32) val << ff->start);
+		if (k < 0) {
+			printf("Too many features in a profile\n");
+			return -1;
+		}
+		if (ff->verify)
+			txn[k].verify_mask |= FIELD_MASK(ff->start, ff->end);
+	}
+
+	for (i = 0; i < n; i++)
+		if (txn[i].fid == FEATURE_INTERRUPT_VECTOR_CONFIG &&
+				!(txn[i].mask & FIELD_MASK(0,15))) {
+			printf("ivc.iv is required to select the interrupt vector\n");
+			return -1;
+		}
+
+	if (save && !nvmed_info_features_save_supported(nvmed)) {
+		printf("The controller does not support the Save field (ONCS bit 4)\n");
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("SET FEATURES%s\n", save? " (saved)" : "");
+	P ("Feature    Previous    New         Description\n");
+	P ("---------  ----------  ----------  -----------\n");
+
+	if (nvmed_info_feature_txn_apply(nvmed, txn, n, save) < 0)
+		return -1;
+
+	for (i = 0; i < n; i++)
+		P ("    %02x     0x%08x  0x%08x  %s\n", txn[i].fid, txn[i].old, txn[i].next,
+			feature_name(txn[i].fid));
+	P ("\n\n");
+	return 0;
+}
+
+
+// Usage: features drift [nsid]
+int nvmed_info_features_drift (NVMED *nvmed, char **cmd_args)
+{
+	int sel, nsid = 1, setid, drifted = 0;
+	int datalen, len;
+	struct feature_set *f;
+	struct feature_field *ff;
+	__u32 v[4], cap;
+	__u8 *p, *data[3];
+	static int sels[] = {FEATURE_SEL_CURRENT, FEATURE_SEL_DEFAULT, FEATURE_SEL_SAVED};
+
+	if (cmd_args && cmd_args[0] && cmd_args[0][0] != '-') {
+		nsid = atoi(cmd_args[0]);
+		if (nsid <= 0) {
+			printf("Invalid namespace ID %d\n", nsid);
+			return -1;
+		}
+	}
+	setid = nvmed_info_opt_long(cmd_args, "--set", 1);
+
+	if (!nvmed_info_features_save_supported(nvmed)) {
+		printf("The controller does not support the Select field (ONCS bit 4)\n");
+		return -1;
+	}
+
+	p = (__u8 *) nvmed_get_buffer(nvmed, 4);
+	if (p == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+	for (sel = 0; sel < 3; sel++)
+		data[sel] = p + sel * PAGE_SIZE;
+
+	PRINT_NVMED_INFO;
+	P ("FEATURES Drift (current vs. default / saved)\n");
+	P ("Feature  Field        Current     Default     Saved       Capabilities\n");
+	P ("-------  -----------  ----------  ----------  ----------  ------------\n");
+
+	for (f = features; f->fname; f++) {
+		datalen = f->datalen;
+		for (sel = 0; sel < 3; sel++) {
+			if (nvmed_info_get_features_ext_issue(nvmed, f->fid, sels[sel],
+						(f->cns == SCOPE_NAMESPACE)? nsid : 0, (f->cns == SCOPE_NVM_SET)? setid : 0,
+						datalen? data[sel] : NULL, datalen, &v[sel]) < 0)
+				break;
+		}
+		if (sel < 3 || nvmed_info_get_features_ext_issue(nvmed, f->fid, FEATURE_SEL_SUPPORTED,
+					(f->cns == SCOPE_NAMESPACE)? nsid : 0, (f->cns == SCOPE_NVM_SET)? setid : 0,
+					NULL, 0, &cap) < 0) {
+			P ("   %02x    ----N/A----  %s\n", f->fid, f->fname);
+			continue;
+		}
+		v[3] = cap;
+
+		for (ff = feature_fields; ff->key; ff++) {
+			__u32 mask = FIELD_MASK(ff->start, ff->end);
+
+			if (ff->fid != f->fid)
+				continue;
+			if ((v[0] & mask) == (v[1] & mask) && (v[0] & mask) == (v[2] & mask))
+				continue;
+			P ("   %02x    %-11s  %10u  %10u  %10u  %s%s%s\n", f->fid, ff->key,
+				(v[0] & mask) >> ff->start, (v[1] & mask) >> ff->start, (v[2] & mask) >> ff->start,
+				(cap & 0x4)? "changeable " : "", (cap & 0x1)? "saveable " : "",
+				(cap & 0x2)? "per-namespace" : "");
+			P ("%24c  %s\n", SP, ff->fname);
+			drifted++;
+		}
+
+		// Features with a data structure are compared as a whole
+		len = (datalen > PAGE_SIZE)? PAGE_SIZE : datalen;
+		if (len && (memcmp(data[0], data[1], len) || memcmp(data[0], data[2], len))) {
+			P ("   %02x    %-11s  %10s  %10s  %10s  %s%s%s\n", f->fid, "(data)",
+				"-", memcmp(data[0], data[1], len)? "differs" : "same",
+				memcmp(data[0], data[2], len)? "differs" : "same",
+				(cap & 0x4)? "changeable " : "", (cap & 0x1)? "saveable " : "",
+				(cap & 0x2)? "per-namespace" : "");
+			P ("%24c  %s data structure (%d bytes)\n", SP, f->fname, len);
+			drifted++;
+		}
+	}
+
+	if (drifted == 0)
+		P ("No drift: every feature is at its default and saved value\n");
+	else
+		P ("%d field%s drifted\n", drifted, (drifted == 1)? "" : "s");
+	P ("\n\n");
+
+	nvmed_put_buffer(p);
+	return 0;
+}
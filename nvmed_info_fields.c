@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+#define FIELDS_MAX			64
+#define FIELD_PAGES			5
+
+#define HANDLES_ADMIN		(NVMED_INFO_HANDLE_NVMED | NVMED_INFO_HANDLE_DEVICE | NVMED_INFO_HANDLE_BUFFER)
+#define HANDLES_SYSFS		(NVMED_INFO_HANDLE_NVMED)
+
+// How each page of nvmed_info_field_lookup() is read, in FIELD_PAGE_* order
+static const struct {
+	const char *kind;
+	const char *desc;
+	int handles;
+} fields_sources[FIELD_PAGES] = {
+	{"admin", "IDENTIFY Controller (06h, CNS 01h, 4096 bytes)", HANDLES_ADMIN},
+	{"admin", "IDENTIFY Namespace (06h, CNS 00h, 4096 bytes)", HANDLES_ADMIN},
+	{"admin", "GET LOG PAGE SMART / Health (02h, 512 bytes)", HANDLES_ADMIN},
+	{"mmio", "Controller Registers (BAR0)", HANDLES_SYSFS},
+	{"sysfs", "PCI Configuration Space (256 bytes)", HANDLES_SYSFS},
+};
+
+struct fields_want {
+	char *name;
+	struct diff_field *f;
+	int page;
+	int i;
+};
+
+static __u8 fields_raw[FIELD_PAGES][4096];
+
+// Registers are read one dword at a time, so only the dwords covering the
+// requested fields are touched
+static __u64 fields_regs_mask (struct fields_want *w, int n)
+{
+	__u64 mask = 0;
+	int i, d;
+
+	for (i = 0; i < n; i++)
+		if (w[i].page == FIELD_PAGE_REGS)
+			for (d = w[i].f->off / 4; d <= (w[i].f->off + w[i].f->len - 1) / 4; d++)
+				mask |= 1ULL << d;
+	return mask;
+}
+
+static void fields_print_plan (struct fields_want *w, int n, int pages, __u64 mask, int nsid)
+{
+	int pg, i, d, handles = 0, steps = 0;
+
+	P ("Plan for %d field%s:\n", n, (n == 1)? "" : "s");
+	for (pg = 0; pg < FIELD_PAGES; pg++) {
+		if (!(pages & (1 << pg)))
+			continue;
+		steps++;
+		handles |= fields_sources[pg].handles;
+		P ("  %-6s %s", fields_sources[pg].kind, fields_sources[pg].desc);
+		if (pg == FIELD_PAGE_NAMESPACE)
+			P (", NSID %d", nsid);
+		if (pg == FIELD_PAGE_REGS) {
+			P (", dwords");
+			for (d = 0; d < 64; d++)
+				if (mask & (1ULL << d))
+					P (" %02xh", d * 4);
+		}
+		P ("\n");
+		for (i = 0; i < n; i++)
+			if (w[i].page == pg)
+				P ("           %s\n", w[i].name);
+	}
+	P ("%d step%s; opens:%s%s%s\n", steps, (steps == 1)? "" : "s",
+		(handles & NVMED_INFO_HANDLE_NVMED)? " nvmed" : "",
+		(handles & NVMED_INFO_HANDLE_DEVICE)? " device" : "",
+		(handles & NVMED_INFO_HANDLE_BUFFER)? " buffer" : "");
+}
+
+// Reads one page of the plan into fields_raw; returns 0, -errno or an NVMe
+// status
+static int fields_fetch (int pg, __u64 mask, int nsid)
+{
+	__u8 *buf;
+	int rc;
+
+	if (pg == FIELD_PAGE_REGS)
+		return nvmed_info_ctx_read_bar_dwords(dev_info, fields_raw[pg], mask);
+	if (pg == FIELD_PAGE_LINK) {
+		rc = nvmed_info_ctx_read_config(dev_info, fields_raw[pg], 256);
+		return (rc < 0)? rc : 0;
+	}
+
+	buf = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	if (buf == NULL)
+		return -1;
+	if (pg == FIELD_PAGE_SMART)
+		rc = nvmed_info_ctx_get_log(dev_info, LOG_SMART_INFO, 0, buf, 512);
+	else
+		rc = nvmed_info_ctx_identify(dev_info, (pg == FIELD_PAGE_CONTROLLER)? CNS_CONTROLLER : CNS_NAMESPACE,
+				(pg == FIELD_PAGE_NAMESPACE)? nsid : 0, buf);
+	if (rc == 0)
+		memcpy(fields_raw[pg], buf, nvmed_info_field_page_len(pg));
+	return rc;
+}
+
+// Usage: <dev> --fields <page.field>,... [--nsid N] [--plan]
+// Works out which pages the fields come from and issues only those admin
+// commands, sysfs reads and register reads, opening only the handles they
+// need; the values are printed as one JSON object.
+int nvmed_info_fields (char *list, char **cmd_args)
+{
+	struct fields_want w[FIELDS_MAX];
+	char *name, *save, out[8192];
+	int i, n = 0, pg, pages = 0, failed = 0, nsid, plan = 0, rc[FIELD_PAGES], len;
+	__u64 mask;
+
+	nsid = nvmed_info_opt_long(cmd_args, "--nsid", 1);
+	for (i = 0; cmd_args && cmd_args[i]; i++)
+		if (!strcmp(cmd_args[i], "--plan"))
+			plan = 1;
+
+	for (name = strtok_r(list, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+		if (n == FIELDS_MAX) {
+			printf("Too many fields (at most %d)\n", FIELDS_MAX);
+			return -1;
+		}
+		w[n].name = name;
+		w[n].f = nvmed_info_field_lookup(name, &w[n].page, &w[n].i);
+		if (w[n].f == NULL) {
+			printf("Unknown field \"%s\"\n", name);
+			return -1;
+		}
+		pages |= 1 << w[n].page;
+		n++;
+	}
+	if (n == 0) {
+		printf("No fields given\n");
+		return -1;
+	}
+	mask = fields_regs_mask(w, n);
+
+	if (plan) {
+		fields_print_plan(w, n, pages, mask, nsid);
+		return 0;
+	}
+
+	for (pg = 0; pg < FIELD_PAGES; pg++) {
+		rc[pg] = 0;
+		if (pages & (1 << pg)) {
+			memset(fields_raw[pg], 0, sizeof(fields_raw[pg]));
+			rc[pg] = fields_fetch(pg, mask, nsid);
+			if (rc[pg])
+				printf("Reading %s failed (%d)\n", fields_sources[pg].desc, rc[pg]);
+		}
+	}
+
+	len = snprintf(out, sizeof(out), "{");
+	for (i = 0; i < n && len < (int) sizeof(out) - 128; i++) {
+		len += snprintf(out + len, sizeof(out) - len, "%s\"%s\":", i? "," : "", w[i].name);
+		if (rc[w[i].page]) {
+			len += snprintf(out + len, sizeof(out) - len, "null");
+			failed++;
+		} else
+			len += nvmed_info_field_format(w[i].page, fields_raw[w[i].page], w[i].f, w[i].i,
+					out + len, sizeof(out) - len);
+	}
+	P ("%s}\n", out);
+	return failed? -1 : 0;
+}
@@ -0,0 +1,741 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd history_cmds[] = {
+	{"record", 1, "Append SMART samples to a ring file", nvmed_info_history_record},
+	{"query", 1, "Time series of a SMART field", nvmed_info_history_query},
+	{"info", 1, "Ring file summary", nvmed_info_history_info},
+	{"forecast", 1, "Endurance and write amplification forecast", nvmed_info_history_forecast},
+	{NULL, 0, NULL, NULL}
+};
+
+int nvmed_info_history (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	c = cmd_lookup(history_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_history_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_history_help (char *s)
+{
+	return cmd_help(s, "HISTORY subcommands", history_cmds);
+}
+
+
+#define HISTORY_HEADER_SIZE		4096
+#define HISTORY_ROUNDUP(x)		(((x) + HISTORY_HEADER_SIZE - 1) & ~((__u64) HISTORY_HEADER_SIZE - 1))
+
+static size_t history_file_size (struct history_header *h)
+{
+	return h->data_off + (size_t) h->nslots * h->slot_size;
+}
+
+// Checks the layout a header describes against the file it came from, so
+// that a damaged or truncated file cannot be mapped past its end
+static int history_valid (struct history_header *h, struct stat *st)
+{
+	if (h->interval == 0 || h->index_off < HISTORY_HEADER_SIZE)
+		return 0;
+	if (h->slot_size != ((h->format == HISTORY_COMPACT)? sizeof(struct nvmed_info_smart) : 512))
+		return 0;
+	if (h->index_off > (__u64) st->st_size || h->data_off < h->index_off + (__u64) h->nslots * sizeof(__u64))
+		return 0;
+	return h->data_off <= (__u64) st->st_size && (__u64) st->st_size >= history_file_size(h);
+}
+
+// Maps a ring file; without tmpl the file must already exist
+static struct history_header *history_map (char *path, struct history_header *tmpl, size_t *len)
+{
+	struct history_header h, *m;
+	struct stat st;
+	int fd, rc;
+
+	fd = open(path, tmpl? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (fd < 0) {
+		printf("Cannot open the history file \"%s\"\n", path);
+		return NULL;
+	}
+
+	rc = pread(fd, &h, sizeof(h), 0);
+	if (rc == 0 && tmpl) {
+		h = *tmpl;
+		if (ftruncate(fd, history_file_size(&h)) < 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+			printf("Cannot create the history file \"%s\"\n", path);
+			close(fd);
+			return NULL;
+		}
+	} else if (rc != sizeof(h) || memcmp(h.magic, HISTORY_MAGIC, sizeof(h.magic))
+			|| h.version != HISTORY_VERSION || h.nslots == 0) {
+		printf("\"%s\" is not an nvmed_info history file\n", path);
+		close(fd);
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 || !history_valid(&h, &st)) {
+		printf("The history file \"%s\" is damaged or truncated\n", path);
+		close(fd);
+		return NULL;
+	}
+
+	*len = history_file_size(&h);
+	m = (struct history_header *) mmap(NULL, *len, tmpl? PROT_READ | PROT_WRITE : PROT_READ,
+			MAP_SHARED, fd, 0);
+	close(fd);
+	if (m == MAP_FAILED) {
+		printf("Cannot map the history file \"%s\"\n", path);
+		return NULL;
+	}
+	return m;
+}
+
+static __u64 *history_index (struct history_header *h)
+{
+	return (__u64 *) ((__u8 *) h + h->index_off);
+}
+
+static __u8 *history_slot (struct history_header *h, __u64 seq)
+{
+	return (__u8 *) h + h->data_off + (seq % h->nslots) * h->slot_size;
+}
+
+// Returns the first sequence number sampled at or after t.  Samples are
+// taken every interval seconds, so the slot is guessed from the time and
+// the guess is checked against the time index; after gaps in sampling the
+// index is searched instead.  Only the index is read either way.
+static __u64 history_seek (struct history_header *h, __u64 t)
+{
+	__u64 *index = history_index(h);
+	__u64 lo = h->first, hi = h->next, mid, guess;
+
+	if (lo == hi || t <= index[lo % h->nslots])
+		return lo;
+
+	guess = lo + (t - index[lo % h->nslots] + h->interval - 1) / h->interval;
+	if (guess < hi && index[guess % h->nslots] >= t && index[(guess - 1) % h->nslots] < t)
+		return guess;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (index[mid % h->nslots] < t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+// Usage: history record <file> [--interval-s N] [--slots N] [--compact] [--count N]
+int nvmed_info_history_record (NVMED *nvmed, char **cmd_args)
+{
+	struct history_header tmpl, *h;
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_smart smart;
+	__u8 *buf, *slot;
+	size_t len;
+	long interval, slots, count, n;
+	int rc;
+
+	if (nvmed == NULL || cmd_args == NULL || cmd_args[0] == NULL) {
+		printf("Usage: nvmed_info <device_path> history record <file> [--interval-s N] [--slots N] "
+			"[--compact] [--count N]\n");
+		return -1;
+	}
+
+	interval = nvmed_info_opt_long(cmd_args, "--interval-s", 60);
+	slots = nvmed_info_opt_long(cmd_args, "--slots", 7 * 24 * 3600 / (interval > 0? interval : 1));
+	count = nvmed_info_opt_long(cmd_args, "--count", 0);
+	if (interval <= 0 || slots <= 0 || slots > 0x7fffffff || count < 0) {
+		printf("Invalid --interval-s, --slots or --count\n");
+		return -1;
+	}
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+
+	memset(&tmpl, 0, sizeof(tmpl));
+	memcpy(tmpl.magic, HISTORY_MAGIC, sizeof(tmpl.magic));
+	tmpl.version = HISTORY_VERSION;
+	tmpl.format = nvmed_info_opt_flag(cmd_args, "--compact")? HISTORY_COMPACT : HISTORY_RAW;
+	tmpl.slot_size = (tmpl.format == HISTORY_COMPACT)? sizeof(struct nvmed_info_smart) : 512;
+	tmpl.nslots = slots;
+	tmpl.interval = interval;
+	tmpl.index_off = HISTORY_HEADER_SIZE;
+	tmpl.data_off = HISTORY_ROUNDUP(HISTORY_HEADER_SIZE + (__u64) slots * sizeof(__u64));
+	strcpy(tmpl.sn, ctrl.sn);
+
+	h = history_map(cmd_args[0], &tmpl, &len);
+	if (h == NULL)
+		return -1;
+	if (strcmp(h->sn, ctrl.sn)) {
+		printf("\"%s\" holds the history of another drive (SN %s)\n", cmd_args[0], h->sn);
+		munmap(h, len);
+		return -1;
+	}
+
+	P ("Recording SMART / Health every %u sec into %s (%u %s slots, %.1f days)\n",
+		h->interval, cmd_args[0], h->nslots, (h->format == HISTORY_COMPACT)? "compact" : "raw",
+		(double) h->nslots * h->interval / 86400);
+
+	buf = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	for (n = 0; count == 0 || n < count; n++) {
+		rc = nvmed_info_ctx_get_log(dev_info, LOG_SMART_INFO, 0, buf, 512);
+		if (rc) {
+			printf("GET LOG PAGE (SMART / Health Information) failed (%d)\n", rc);
+		} else {
+			// Retire the oldest slot before it is overwritten
+			if (h->next - h->first == h->nslots)
+				h->first++;
+			__sync_synchronize();
+
+			slot = history_slot(h, h->next);
+			if (h->format == HISTORY_COMPACT) {
+				nvmed_info_decode_smart(buf, &smart);
+				memcpy(slot, &smart, sizeof(smart));
+			} else
+				memcpy(slot, buf, 512);
+			history_index(h)[h->next % h->nslots] = time(NULL);
+			__sync_synchronize();
+			h->next++;
+		}
+		if (count == 0 || n + 1 < count)
+			sleep(h->interval);
+	}
+
+	munmap(h, len);
+	return 0;
+}
+
+// Parses seconds since the Epoch, "now", or a time relative to now such
+// as "-90m", "-12h" or "-7d"
+static long history_time (char *s, long def)
+{
+	char *end;
+	long v;
+
+	if (s == NULL)
+		return def;
+	if (!strcmp(s, "now"))
+		return time(NULL);
+
+	v = strtol(s, &end, 10);
+	switch (*end) {
+		case 'd':	v *= 24;	/* fall through */
+		case 'h':	v *= 60;	/* fall through */
+		case 'm':	v *= 60;	/* fall through */
+		case 's':	break;
+		case '\0':	break;
+		default:	return -1;
+	}
+	return (s[0] == '-')? time(NULL) + v : v;
+}
+
+static void history_print_time (__u64 t)
+{
+	time_t tt = t;
+	char when[32];
+
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&tt));
+	P ("%s", when);
+}
+
+// Usage: history query <file> <field> [from] [to]
+int nvmed_info_history_query (NVMED *nvmed, char **cmd_args)
+{
+	struct history_header *h;
+	struct diff_field *f;
+	struct nvmed_info_smart smart;
+	const __u8 *s;
+	__u64 seq, t, v, n = 0, sum = 0, min = ~0ULL, max = 0;
+	long from, to;
+	size_t len;
+	int i;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL || cmd_args[1] == NULL) {
+		printf("Usage: nvmed_info history query <file> <field> [from] [to]\n");
+		return -1;
+	}
+
+	f = nvmed_info_smart_field(cmd_args[1], &i);
+	if (f == NULL || f->type == DIFF_STR || f->type == DIFF_BYTES) {
+		printf("Unknown SMART / Health field \"%s\"\n", cmd_args[1]);
+		return -1;
+	}
+	from = history_time(cmd_args[2], 0);
+	to = history_time(cmd_args[2]? cmd_args[3] : NULL, time(NULL));
+	if (from < 0 || to < 0) {
+		printf("Invalid time; use seconds since the Epoch, \"now\" or \"-N[smhd]\"\n");
+		return -1;
+	}
+
+	h = history_map(cmd_args[0], NULL, &len);
+	if (h == NULL)
+		return -1;
+
+	P ("[%s of SN %s]\n", cmd_args[1], h->sn);
+	P ("Time                 Value\n");
+	P ("-------------------  --------------------\n");
+	for (seq = history_seek(h, from); seq < h->next; seq++) {
+		t = history_index(h)[seq % h->nslots];
+		if (t > (__u64) to)
+			break;
+		if (h->format == HISTORY_COMPACT)
+			s = history_slot(h, seq);
+		else {
+			nvmed_info_decode_smart(history_slot(h, seq), &smart);
+			s = (const __u8 *) &smart;
+		}
+		v = nvmed_info_diff_value(s + f->member + i * f->member_stride, f->type);
+		history_print_time(t);
+		P ("  %llu\n", (unsigned long long) v);
+
+		n++;
+		sum += v;
+		if (v < min)
+			min = v;
+		if (v > max)
+			max = v;
+	}
+	if (n)
+		P ("\n%llu samples: min %llu, avg %.1f, max %llu\n\n", (unsigned long long) n,
+			(unsigned long long) min, (double) sum / n, (unsigned long long) max);
+	else
+		P ("\nNo samples in the window\n\n");
+
+	munmap(h, len);
+	return 0;
+}
+
+// Usage: history info <file>
+int nvmed_info_history_info (NVMED *nvmed, char **cmd_args)
+{
+	struct history_header *h;
+	size_t len;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL) {
+		printf("Usage: nvmed_info history info <file>\n");
+		return -1;
+	}
+
+	h = history_map(cmd_args[0], NULL, &len);
+	if (h == NULL)
+		return -1;
+
+	P ("Serial Number:  %s\n", h->sn);
+	P ("Format:         %s (%u bytes per slot)\n", (h->format == HISTORY_COMPACT)? "compact" : "raw",
+		h->slot_size);
+	P ("Slots:          %u every %u sec (%.1f days)\n", h->nslots, h->interval,
+		(double) h->nslots * h->interval / 86400);
+	P ("Samples:        %llu kept, %llu recorded\n", (unsigned long long) (h->next - h->first),
+		(unsigned long long) h->next);
+	if (h->next > h->first) {
+		P ("From:           ");
+		history_print_time(history_index(h)[h->first % h->nslots]);
+		P ("\nTo:             ");
+		history_print_time(history_index(h)[(h->next - 1) % h->nslots]);
+		P ("\n");
+	}
+	P ("\n");
+
+	munmap(h, len);
+	return 0;
+}
+
+
+// Endurance forecast.  Samples come from ring files and snapshots, grouped
+// by serial number; wear is fitted against time with least squares.
+#define FORECAST_MAX_DRIVES		256
+
+struct forecast_sample {
+	__u64 t;
+	__u8 percent_used;
+	__u8 avail_spare;
+	__u8 spare_thresh;
+	__u64 bytes_written;				// host bytes
+	__u64 power_on_hours;
+};
+
+struct forecast_drive {
+	char sn[21];
+	char *source;						// the first file it was found in
+	int others;							// found in other files too
+	struct forecast_sample *s;
+	int n, max;
+	double wear;						// percent used per day
+	double write_rate;					// host bytes per day
+	double days_left;					// < 0 if unknown
+	double spare_days;					// until Available Spare Threshold, < 0 if unknown
+	const char *method;
+	__u64 nand;							// NAND bytes written, 0 if unknown
+	const char *nand_src;
+};
+
+static struct forecast_drive *forecast_drive (struct forecast_drive *d, int *nd, const char *sn, char *path)
+{
+	int i;
+
+	for (i = 0; i < *nd; i++)
+		if (!strcmp(d[i].sn, sn))
+			break;
+	if (i == *nd) {
+		if (*nd == FORECAST_MAX_DRIVES) {
+			printf("Too many drives (at most %d)\n", FORECAST_MAX_DRIVES);
+			return NULL;
+		}
+		memset(&d[i], 0, sizeof(d[i]));
+		strcpy(d[i].sn, sn);
+		d[i].source = path;
+		(*nd)++;
+	}
+	if (d[i].source != path)
+		d[i].others = 1;
+	return &d[i];
+}
+
+static int forecast_add (struct forecast_drive *d, __u64 t, struct nvmed_info_smart *smart)
+{
+	struct forecast_sample *s;
+
+	if (d->n == d->max) {
+		d->max = d->max? d->max * 2 : 1024;
+		s = realloc(d->s, d->max * sizeof(*s));
+		if (s == NULL) {
+			printf("Memory allocation failed.\n");
+			return -1;
+		}
+		d->s = s;
+	}
+	s = &d->s[d->n++];
+	s->t = t;
+	s->percent_used = smart->percent_used;
+	s->avail_spare = smart->avail_spare;
+	s->spare_thresh = smart->spare_thresh;
+	s->bytes_written = smart->data_units_written * 512000;
+	s->power_on_hours = smart->power_on_hours;
+	return 0;
+}
+
+// Adds the samples of a ring file or a snapshot taken at or after from
+static int forecast_load (char *path, struct forecast_drive *drives, int *nd, long from)
+{
+	struct history_header *h;
+	struct forecast_drive *d;
+	struct nvmed_info_smart smart;
+	struct nvmed_info_controller ctrl;
+	struct snapshot *snap;
+	char magic[8];
+	__u64 seq;
+	size_t len;
+	int fd, rc = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || pread(fd, magic, sizeof(magic), 0) != sizeof(magic)) {
+		printf("Cannot read \"%s\"\n", path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	close(fd);
+
+	if (!memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic))) {
+		snap = malloc(sizeof(*snap));
+		if (snap == NULL || nvmed_info_snapshot_load(path, snap) < 0) {
+			free(snap);
+			return -1;
+		}
+		nvmed_info_decode_controller(snap->ctrl, &ctrl);
+		nvmed_info_decode_smart(snap->smart, &smart);
+		d = forecast_drive(drives, nd, ctrl.sn, path);
+		if (d == NULL)
+			rc = -1;
+		else if (le64toh(snap->time) >= (__u64) from)
+			rc = forecast_add(d, le64toh(snap->time), &smart);
+		free(snap);
+		return rc;
+	}
+
+	h = history_map(path, NULL, &len);
+	if (h == NULL)
+		return -1;
+	d = forecast_drive(drives, nd, h->sn, path);
+	for (seq = history_seek(h, from); d && rc == 0 && seq < h->next; seq++) {
+		if (h->format == HISTORY_COMPACT)
+			memcpy(&smart, history_slot(h, seq), sizeof(smart));
+		else
+			nvmed_info_decode_smart(history_slot(h, seq), &smart);
+		rc = forecast_add(d, history_index(h)[seq % h->nslots], &smart);
+	}
+	munmap(h, len);
+	return d? rc : -1;
+}
+
+static int forecast_cmp_time (const void *a, const void *b)
+{
+	const struct forecast_sample *x = a, *y = b;
+
+	return (x->t > y->t) - (x->t < y->t);
+}
+
+// Least-squares slope of one sample member per day; 0 with fewer than two
+// distinct times
+static double forecast_slope (struct forecast_drive *d, int member)
+{
+	double x, y, sx = 0, sy = 0, sxx = 0, sxy = 0, n = d->n, den;
+	int i;
+
+	for (i = 0; i < d->n; i++) {
+		x = (double) (d->s[i].t - d->s[0].t) / 86400;
+		y = (member == 0)? d->s[i].percent_used :
+			(member == 1)? (double) d->s[i].bytes_written : d->s[i].avail_spare;
+		sx += x;
+		sy += y;
+		sxx += x * x;
+		sxy += x * y;
+	}
+	den = n * sxx - sx * sx;
+	return (den > 1e-9)? (n * sxy - sx * sy) / den : 0;
+}
+
+// Wear is fitted to Percent Used when it moved during the series.  It moves
+// in whole percents, so a short series falls back to the lifetime ratio of
+// wear to host writes at the current write rate, and then to wear per
+// power-on day.
+static void forecast_fit (struct forecast_drive *d)
+{
+	struct forecast_sample *first, *last;
+	double spare;
+
+	qsort(d->s, d->n, sizeof(*d->s), forecast_cmp_time);
+	first = &d->s[0];
+	last = &d->s[d->n - 1];
+	d->write_rate = forecast_slope(d, 1);
+	d->wear = 0;
+	d->method = "-";
+	if (last->percent_used > first->percent_used && forecast_slope(d, 0) > 0) {
+		d->wear = forecast_slope(d, 0);
+		d->method = "fit";
+	} else if (last->percent_used && last->bytes_written && d->write_rate > 0) {
+		d->wear = d->write_rate * last->percent_used / last->bytes_written;
+		d->method = "writes";
+	} else if (last->percent_used && last->power_on_hours) {
+		d->wear = last->percent_used * 24.0 / last->power_on_hours;
+		d->method = "power-on";
+	}
+
+	if (last->percent_used >= 100)
+		d->days_left = 0;
+	else
+		d->days_left = (d->wear > 0)? (100 - last->percent_used) / d->wear : -1;
+
+	spare = forecast_slope(d, 2);
+	d->spare_days = (spare < 0 && last->avail_spare > last->spare_thresh)?
+		(last->avail_spare - last->spare_thresh) / -spare : -1;
+}
+
+// Vendor log pages with a lifetime NAND (media) bytes written counter
+static int forecast_nand_ocp (const __u8 *p, __u64 *bytes)
+{
+	static const __u8 guid[16] = { 0xc5, 0xaf, 0x10, 0x28, 0xea, 0xbf, 0xf2, 0xa4,
+		0x9c, 0x4f, 0x6f, 0x7c, 0xc9, 0x14, 0xd5, 0xaf };
+
+	if (memcmp(&p[496], guid, sizeof(guid)))
+		return -1;
+	*bytes = U64(0);					// Physical Media Units Written, bytes
+	return 0;
+}
+
+static int forecast_nand_intel (const __u8 *p, __u64 *bytes)
+{
+	__u64 raw = 0;
+	int i, b;
+
+	// 12-byte attributes: key, normalized value at 3, raw value at 5..10
+	for (i = 0; i + 12 <= 512; i += 12)
+		if (p[i] == 0xf4) {
+			for (b = 5; b >= 0; b--)
+				raw = (raw << 8) | p[i + 5 + b];
+			*bytes = raw << 25;			// 32 MiB units
+			return 0;
+		}
+	return -1;
+}
+
+static const struct {
+	__u16 vid;							// 0 for any vendor
+	int lid;
+	const char *name;
+	int (*read)(const __u8 *p, __u64 *bytes);
+} forecast_nand_logs[] = {
+	{0, 0xc0, "OCP SMART / Health Extended (C0h)", forecast_nand_ocp},
+	{0x8086, 0xca, "Intel Additional SMART Attributes (CAh)", forecast_nand_intel},
+	{0, 0, NULL, NULL}
+};
+
+static void forecast_nand (struct forecast_drive *d, struct nvmed_info_controller *ctrl)
+{
+	__u8 *p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	int i;
+
+	for (i = 0; p && forecast_nand_logs[i].name; i++) {
+		if (forecast_nand_logs[i].vid && forecast_nand_logs[i].vid != ctrl->vid)
+			continue;
+		memset(p, 0, 512);
+		if (nvmed_info_ctx_get_log(dev_info, forecast_nand_logs[i].lid, 0, p, 512) == 0 &&
+				forecast_nand_logs[i].read(p, &d->nand) == 0 && d->nand) {
+			d->nand_src = forecast_nand_logs[i].name;
+			return;
+		}
+	}
+	d->nand = 0;
+}
+
+static const char *forecast_date (__u64 t, double days)
+{
+	static char s[16];
+	time_t tt = t + (time_t) (days * 86400);
+
+	if (days < 0)
+		return "-";
+	if (days > 365 * 100)
+		return "> 100 years";
+	strftime(s, sizeof(s), "%Y-%m-%d", localtime(&tt));
+	return s;
+}
+
+static int forecast_cmp_left (const void *a, const void *b)
+{
+	const struct forecast_drive *x = *(struct forecast_drive **) a, *y = *(struct forecast_drive **) b;
+
+	if ((x->days_left < 0) != (y->days_left < 0))
+		return (x->days_left < 0)? 1 : -1;
+	return (x->days_left > y->days_left) - (x->days_left < y->days_left);
+}
+
+// Usage: history forecast <file>... [--from T]
+// Files are ring files or snapshots of any number of drives.  With a device,
+// its current SMART / Health page is added as the latest sample and its
+// write amplification is read from a known vendor log page.
+int nvmed_info_history_forecast (NVMED *nvmed, char **cmd_args)
+{
+	static struct forecast_drive drives[FORECAST_MAX_DRIVES];
+	struct forecast_drive *d, *rank[FORECAST_MAX_DRIVES];
+	struct forecast_sample *last;
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_smart smart;
+	long from = 0;
+	int i, nd = 0, rc = 0;
+
+	for (i = 0; cmd_args && cmd_args[i]; i++) {
+		if (!strcmp(cmd_args[i], "--from") && cmd_args[i+1]) {
+			from = history_time(cmd_args[++i], 0);
+			if (from < 0) {
+				printf("Invalid time; use seconds since the Epoch, \"now\" or \"-N[smhd]\"\n");
+				return -1;
+			}
+		}
+	}
+	for (i = 0; cmd_args && cmd_args[i] && rc == 0; i++) {
+		if (!strcmp(cmd_args[i], "--from"))
+			i++;
+		else
+			rc = forecast_load(cmd_args[i], drives, &nd, from);
+	}
+	if (rc == 0 && nvmed) {
+		if (nvmed_info_read_controller(dev_info, &ctrl) || nvmed_info_read_smart(dev_info, &smart)) {
+			printf("Cannot read the device\n");
+			rc = -1;
+		} else if ((d = forecast_drive(drives, &nd, ctrl.sn, (char *) nvmed_info_ctx_path(dev_info)))) {
+			rc = forecast_add(d, time(NULL), &smart);
+			forecast_nand(d, &ctrl);
+		}
+	}
+	if (rc == 0 && nd == 0) {
+		printf("Usage: nvmed_info [device_path] history forecast <file>... [--from T]\n");
+		rc = -1;
+	}
+	if (rc) {
+		for (i = 0; i < nd; i++)
+			free(drives[i].s);
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("ENDURANCE FORECAST (%d drive%s)\n", nd, (nd == 1)? "" : "s");
+	for (i = 0; i < nd; i++) {
+		d = rank[i] = &drives[i];
+		if (d->n == 0) {
+			d->days_left = -1;
+			d->method = "-";
+			continue;
+		}
+		forecast_fit(d);
+		last = &d->s[d->n - 1];
+
+		P ("\n[SN %s] %s%s, %d sample%s, ", d->sn, d->source, d->others? " and others" : "",
+			d->n, (d->n == 1)? "" : "s");
+		history_print_time(d->s[0].t);
+		P (" .. ");
+		history_print_time(last->t);
+		P ("\n");
+		P ("%-36s  %u%%, %.4f %%/day (%s)\n", "Percent Used, wear rate", last->percent_used,
+			d->wear, d->method);
+		P ("%-36s  %.1f GB, %.1f GB/day\n", "Host writes, write rate", last->bytes_written / 1e9,
+			d->write_rate / 1e9);
+		P ("%-36s  %llu\n", "Power On Hours", (unsigned long long) last->power_on_hours);
+		P ("%-36s  %u%% (threshold %u%%)", "Available Spare", last->avail_spare, last->spare_thresh);
+		if (d->spare_days >= 0)
+			P (", reaches the threshold %s", forecast_date(last->t, d->spare_days));
+		P ("\n");
+		P ("%-36s  %s", "End of rated endurance (100% used)", forecast_date(last->t, d->days_left));
+		if (d->days_left >= 0)
+			P (" (%.0f days)", d->days_left);
+		P ("\n");
+		if (d->nand && last->bytes_written)
+			P ("%-36s  %.2f (%.1f GB NAND / %.1f GB host, %s)\n", "Write amplification, lifetime",
+				(double) d->nand / last->bytes_written, d->nand / 1e9, last->bytes_written / 1e9,
+				d->nand_src);
+		else
+			P ("%-36s  %s\n", "Write amplification, lifetime",
+				nvmed? "- (no known NAND-writes log page)" : "- (needs the device)");
+	}
+
+	qsort(rank, nd, sizeof(rank[0]), forecast_cmp_left);
+	P ("\nRank  Serial Number         Used  Wear %%/day  Host GB/day  Days Left  End of Life  Method\n");
+	P ("----  --------------------  ----  ----------  -----------  ---------  -----------  --------\n");
+	for (i = 0; i < nd; i++) {
+		d = rank[i];
+		if (d->n == 0)
+			continue;
+		last = &d->s[d->n - 1];
+		P ("%4d  %-20s  %3u%%  %10.4f  %11.1f  ", i + 1, d->sn, last->percent_used, d->wear,
+			d->write_rate / 1e9);
+		if (d->days_left >= 0)
+			P ("%9.0f", d->days_left);
+		else
+			P ("%9s", "-");
+		P ("  %-11s  %s\n", forecast_date(last->t, d->days_left), d->method);
+	}
+	P ("\n");
+
+	for (i = 0; i < nd; i++)
+		free(drives[i].s);
+	return 0;
+}
@@ -138,6 +138,7 @@ void nvmed_info_identify_parse_controller (__u8 *p)
 
 	P ("\n[Admin Command Set Attributes & Optional Controller Capabilities]\n");
 	PH2 (256);	P ("Optional Admin Command Support (OACS):\n");
+				P ("%26c  Supports Directive Send and Directive Receive commands: %s\n", SP, YN(5));
 				P ("%26c  Supports Namespace Management and Namespace Attachment commands: %s\n", SP, YN(3));
 				P ("%26c  Supports Firmware Commit and Firmware Image Download commands: %s\n", SP, YN(2));
 				P ("%26c  Supports Format NVM command: %s\n", SP, YN(1));
@@ -216,8 +217,6 @@ void nvmed_info_identify_parse_controller (__u8 *p)
 				P ("%26c  Supports the Keyed SGL Data Block descriptor: %s\n", SP, YN(2));
 			}
 
-#define PSD0	2048	// Offset for PSD0
-
 	P ("\n[Power State Descriptor 0 (PSD0)]\n");
 	PH2 (PSD0+0);	P ("Maximum Power (MP): %d (in MXPS)\n", F(0,16));
 	PH1 (PSD0+3);	P ("Max Power Scale (MXPS) / Non-Operational Staet (NOPS):\n");
@@ -0,0 +1,942 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <endian.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_ctx {
+	NVMED *nvmed;
+	int fd;
+	char *path;
+	__u8 *buf;							// a page for the typed reads
+	nvmed_info_hook hook;
+	void *hook_arg;
+	int handles;						// NVMED_INFO_HANDLE_* opened so far
+};
+
+#define HOOK(ctx, event, begin) \
+	do { if ((ctx)->hook) (ctx)->hook((ctx)->hook_arg, event, begin); } while (0)
+
+// Little-endian loads that do not depend on the alignment of p
+static __u16 le16 (const __u8 *p, int off)
+{
+	__u16 v;
+	memcpy(&v, p + off, sizeof(v));
+	return le16toh(v);
+}
+
+static __u32 le32 (const __u8 *p, int off)
+{
+	__u32 v;
+	memcpy(&v, p + off, sizeof(v));
+	return le32toh(v);
+}
+
+static __u64 le64 (const __u8 *p, int off)
+{
+	__u64 v;
+	memcpy(&v, p + off, sizeof(v));
+	return le64toh(v);
+}
+
+// 128-bit little-endian counter saturated to 64 bits
+static __u64 le128 (const __u8 *p, int off)
+{
+	return le64(p, off + 8)? ~0ULL : le64(p, off);
+}
+
+static void copy_string (char *dst, const __u8 *p, int off, int len)
+{
+	memcpy(dst, p + off, len);
+	dst[len] = '\0';
+	while (len > 0 && dst[len-1] == ' ')
+		dst[--len] = '\0';
+}
+
+
+// Handles are opened on first use: the nvmed handle for the sysfs paths
+// and the DMA buffer, the device for admin commands.  Only the existence of
+// the device is checked here.
+NVMED_INFO *nvmed_info_ctx_open (const char *dev_path)
+{
+	NVMED_INFO *ctx;
+	struct stat st;
+
+	if (stat(dev_path, &st) < 0)
+		return NULL;
+	ctx = (NVMED_INFO *) calloc(1, sizeof(*ctx));
+	if (ctx == NULL)
+		return NULL;
+
+	ctx->fd = -1;
+	ctx->path = strdup(dev_path);
+	if (ctx->path == NULL) {
+		free(ctx);
+		errno = ENOMEM;
+		return NULL;
+	}
+	return ctx;
+}
+
+static int ctx_need_nvmed (NVMED_INFO *ctx)
+{
+	if (ctx->nvmed == NULL) {
+		ctx->nvmed = nvmed_open(ctx->path, 0);
+		if (ctx->nvmed == NULL)
+			return errno? -errno : -ENODEV;
+		ctx->handles |= NVMED_INFO_HANDLE_NVMED;
+	}
+	return 0;
+}
+
+static int ctx_need_fd (NVMED_INFO *ctx)
+{
+	if (ctx->fd < 0) {
+		ctx->fd = open(ctx->path, O_RDWR);
+		if (ctx->fd < 0)
+			return -errno;
+		ctx->handles |= NVMED_INFO_HANDLE_DEVICE;
+	}
+	return 0;
+}
+
+void nvmed_info_ctx_close (NVMED_INFO *ctx)
+{
+	int err = errno;
+
+	if (ctx == NULL)
+		return;
+	if (ctx->buf)
+		nvmed_put_buffer(ctx->buf);
+	if (ctx->fd >= 0)
+		close(ctx->fd);
+	if (ctx->nvmed)
+		nvmed_close(ctx->nvmed);
+	free(ctx->path);
+	free(ctx);
+	errno = err;
+}
+
+NVMED *nvmed_info_ctx_nvmed (NVMED_INFO *ctx)
+{
+	return ctx_need_nvmed(ctx)? NULL : ctx->nvmed;
+}
+
+const char *nvmed_info_ctx_path (NVMED_INFO *ctx)
+{
+	return ctx->path;
+}
+
+void *nvmed_info_ctx_buffer (NVMED_INFO *ctx)
+{
+	if (ctx->buf == NULL && ctx_need_nvmed(ctx) == 0) {
+		ctx->buf = (__u8 *) nvmed_get_buffer(ctx->nvmed, 1);
+		if (ctx->buf)
+			ctx->handles |= NVMED_INFO_HANDLE_BUFFER;
+	}
+	return ctx->buf;
+}
+
+int nvmed_info_ctx_handles (NVMED_INFO *ctx)
+{
+	return ctx->handles;
+}
+
+// The nvmed module exposes the PCI sysfs files of the device next to its
+// "admin" entry: ".../admin" becomes ".../sysfs/<name>".
+int nvmed_info_ctx_sysfs_path (NVMED_INFO *ctx, const char *name, char *path, int len)
+{
+	char *p;
+	int n;
+
+	n = ctx_need_nvmed(ctx);
+	if (n)
+		return n;
+	p = strstr(ctx->nvmed->ns_path, "admin");
+	if (p == NULL)
+		return -ENOENT;
+	n = snprintf(path, len, "%.*ssysfs/%s", (int) (p - ctx->nvmed->ns_path),
+			ctx->nvmed->ns_path, name);
+	return (n < len)? 0 : -ENAMETOOLONG;
+}
+
+void nvmed_info_ctx_set_hook (NVMED_INFO *ctx, nvmed_info_hook hook, void *arg)
+{
+	ctx->hook = hook;
+	ctx->hook_arg = arg;
+}
+
+int nvmed_info_ctx_admin (NVMED_INFO *ctx, struct nvme_admin_cmd *cmd)
+{
+	int rc;
+
+	rc = ctx_need_fd(ctx);
+	if (rc)
+		return rc;
+	HOOK(ctx, NVMED_INFO_HOOK_ADMIN, 1);
+	rc = ioctl(ctx->fd, NVME_IOCTL_ADMIN_CMD, cmd);
+	if (rc < 0)
+		rc = -errno;
+	HOOK(ctx, NVMED_INFO_HOOK_ADMIN, 0);
+	return rc;
+}
+
+int nvmed_info_ctx_identify (NVMED_INFO *ctx, int cns, int nsid, void *buf)
+{
+	struct nvme_admin_cmd cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_identify;
+	cmd.nsid = htole32(nsid);
+	cmd.addr = (__u64) htole64((unsigned long) buf);
+	cmd.data_len = htole32(PAGE_SIZE);
+	cmd.cdw10 = htole32(cns);
+	return nvmed_info_ctx_admin(ctx, &cmd);
+}
+
+int nvmed_info_ctx_get_log (NVMED_INFO *ctx, int lid, int nsid, void *buf, int len)
+{
+	return nvmed_info_ctx_get_log_ext(ctx, lid, 0, nsid, buf, len);
+}
+
+// lsi is the Log Specific Identifier (CDW11 bits 31:16), e.g. an NVM Set ID
+int nvmed_info_ctx_get_log_ext (NVMED_INFO *ctx, int lid, int lsi, int nsid, void *buf, int len)
+{
+	struct nvme_admin_cmd cmd;
+	__u32 numd = len / 4 - 1;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_get_log_page;
+	cmd.nsid = htole32(nsid? nsid : 0xffffffff);
+	cmd.addr = (__u64) htole64((unsigned long) buf);
+	cmd.data_len = htole32(len);
+	// Some controllers (e.g. XS1715) reject NUMD larger than 0x7f
+	if (numd > 0x7f)
+		numd = 0x7f;
+	cmd.cdw10 = htole32((numd << 16) | lid);
+	cmd.cdw11 = htole32((__u32) lsi << 16);
+	return nvmed_info_ctx_admin(ctx, &cmd);
+}
+
+int nvmed_info_ctx_get_feature (NVMED_INFO *ctx, int fid, int sel, int nsid, __u32 cdw11,
+		void *buf, int len, __u32 *result)
+{
+	struct nvme_admin_cmd cmd;
+	int rc;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_get_features;
+	cmd.nsid = htole32(nsid);
+	if (buf) {
+		cmd.addr = (__u64) htole64((unsigned long) buf);
+		cmd.data_len = htole32(len);
+	}
+	cmd.cdw10 = htole32(sel | fid);
+	cmd.cdw11 = htole32(cdw11);
+	rc = nvmed_info_ctx_admin(ctx, &cmd);
+	if (result)
+		*result = cmd.result;
+	return rc;
+}
+
+int nvmed_info_ctx_set_feature (NVMED_INFO *ctx, int fid, int nsid, __u32 cdw11, int save,
+		void *buf, int len, __u32 *result)
+{
+	struct nvme_admin_cmd cmd;
+	int rc;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_set_features;
+	cmd.nsid = htole32(nsid);
+	if (buf) {
+		cmd.addr = (__u64) htole64((unsigned long) buf);
+		cmd.data_len = htole32(len);
+	}
+	cmd.cdw10 = htole32((save? FEATURE_SAVE : 0) | fid);
+	cmd.cdw11 = htole32(cdw11);
+	rc = nvmed_info_ctx_admin(ctx, &cmd);
+	if (result)
+		*result = cmd.result;
+	return rc;
+}
+
+// Directive Send or Receive; dspec, dtype and doper go to CDW11, and NUMD
+// to CDW10 for a Receive
+int nvmed_info_ctx_directive (NVMED_INFO *ctx, int opcode, int nsid, int dtype, int doper,
+		int dspec, __u32 cdw12, void *buf, int len, __u32 *result)
+{
+	struct nvme_admin_cmd cmd;
+	int rc;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = opcode;
+	cmd.nsid = htole32(nsid);
+	if (buf) {
+		cmd.addr = (__u64) htole64((unsigned long) buf);
+		cmd.data_len = htole32(len);
+		cmd.cdw10 = htole32(len / 4 - 1);
+	}
+	cmd.cdw11 = htole32((dspec << 16) | (dtype << 8) | doper);
+	cmd.cdw12 = htole32(cdw12);
+	rc = nvmed_info_ctx_admin(ctx, &cmd);
+	if (result)
+		*result = cmd.result;
+	return rc;
+}
+
+void nvmed_info_decode_controller (const __u8 *p, struct nvmed_info_controller *c)
+{
+	int i;
+	const __u8 *d;
+
+	memset(c, 0, sizeof(*c));
+	c->vid = le16(p, 0);
+	c->ssvid = le16(p, 2);
+	copy_string(c->sn, p, 4, 20);
+	copy_string(c->mn, p, 24, 40);
+	copy_string(c->fr, p, 64, 8);
+	c->rab = p[72];
+	c->ieee = le32(p, 72) >> 8;
+	c->cmic = p[76];
+	c->mdts = p[77];
+	c->cntlid = le16(p, 78);
+	c->ver = le32(p, 80);
+	c->rtd3r = le32(p, 84);
+	c->rtd3e = le32(p, 88);
+	c->oaes = le32(p, 92);
+	c->ctratt = le32(p, 96);
+	c->oacs = le16(p, 256);
+	c->acl = p[258];
+	c->aerl = p[259];
+	c->frmw = p[260];
+	c->lpa = p[261];
+	c->elpe = p[262];
+	c->npss = p[263];
+	c->avscc = p[264];
+	c->apsta = p[265];
+	c->wctemp = le16(p, 266);
+	c->cctemp = le16(p, 268);
+	c->mtfa = le16(p, 270);
+	c->hmpre = le32(p, 272);
+	c->hmmin = le32(p, 276);
+	c->tnvmcap = le128(p, 280);
+	c->unvmcap = le128(p, 296);
+	c->rpmbs = le32(p, 312);
+	c->kas = le16(p, 320);
+	c->hctma = le16(p, 322);
+	c->mntmt = le16(p, 324);
+	c->mxtmt = le16(p, 326);
+	c->hmminds = le32(p, 332);
+	c->hmmaxd = le16(p, 336);
+	c->nsetidmax = le16(p, 338);
+	c->sqes = p[512];
+	c->cqes = p[513];
+	c->maxcmd = le16(p, 514);
+	c->nn = le32(p, 516);
+	c->oncs = le16(p, 520);
+	c->fuses = le16(p, 522);
+	c->fna = p[524];
+	c->vwc = p[525];
+	c->awun = le16(p, 526);
+	c->awupf = le16(p, 528);
+	c->nvscc = p[530];
+	c->acwu = le16(p, 532);
+	c->sgls = le32(p, 536);
+
+	for (i = 0; i <= c->npss && i < MAX_POWER_STATES; i++) {
+		d = &p[PSD0 + i * PSD_SIZE];
+		c->psd[i].ps = i;
+		c->psd[i].mp = le16(d, 0);
+		c->psd[i].mxps = d[3] & 0x01;
+		c->psd[i].nops = (d[3] >> 1) & 0x01;
+		c->psd[i].enlat = le32(d, 4);
+		c->psd[i].exlat = le32(d, 8);
+		c->psd[i].rrt = d[12] & 0x1f;
+		c->psd[i].rrl = d[13] & 0x1f;
+		c->psd[i].rwt = d[14] & 0x1f;
+		c->psd[i].rwl = d[15] & 0x1f;
+	}
+}
+
+void nvmed_info_decode_namespace (const __u8 *p, struct nvmed_info_namespace *ns)
+{
+	int i;
+	__u32 v;
+
+	memset(ns, 0, sizeof(*ns));
+	ns->nsze = le64(p, 0);
+	ns->ncap = le64(p, 8);
+	ns->nuse = le64(p, 16);
+	ns->nsfeat = p[24];
+	ns->nlbaf = p[25];
+	ns->flbas = p[26];
+	ns->mc = p[27];
+	ns->dpc = p[28];
+	ns->dps = p[29];
+	ns->nmic = p[30];
+	ns->rescap = p[31];
+	ns->fpi = p[32];
+	ns->nawun = le16(p, 34);
+	ns->nawupf = le16(p, 36);
+	ns->nacwu = le16(p, 38);
+	ns->nabsn = le16(p, 40);
+	ns->nabo = le16(p, 42);
+	ns->nabspf = le16(p, 44);
+	ns->nvmcap = le128(p, 48);
+	ns->npwg = le16(p, 64);
+	ns->npwa = le16(p, 66);
+	ns->npdg = le16(p, 68);
+	ns->npda = le16(p, 70);
+	ns->nows = le16(p, 72);
+	memcpy(ns->nguid, p + 104, 16);
+	memcpy(ns->eui64, p + 120, 8);
+
+	for (i = 0; i < 16; i++) {
+		v = le32(p, 128 + i * 4);
+		ns->lbaf[i].ms = v & 0xffff;
+		ns->lbaf[i].lbads = (v >> 16) & 0xff;
+		ns->lbaf[i].rp = (v >> 24) & 0x3;
+	}
+}
+
+void nvmed_info_decode_smart (const __u8 *p, struct nvmed_info_smart *s)
+{
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	s->critical_warning = p[0];
+	s->composite_temp = le16(p, 1);
+	s->avail_spare = p[3];
+	s->spare_thresh = p[4];
+	s->percent_used = p[5];
+	s->data_units_read = le128(p, 32);
+	s->data_units_written = le128(p, 48);
+	s->host_read_cmds = le128(p, 64);
+	s->host_write_cmds = le128(p, 80);
+	s->ctrl_busy_time = le128(p, 96);
+	s->power_cycles = le128(p, 112);
+	s->power_on_hours = le128(p, 128);
+	s->unsafe_shutdowns = le128(p, 144);
+	s->media_errors = le128(p, 160);
+	s->num_err_log_entries = le128(p, 176);
+	s->warning_temp_time = le32(p, 192);
+	s->critical_temp_time = le32(p, 196);
+	for (i = 0; i < 8; i++)
+		s->temp_sensor[i] = le16(p, 200 + i * 2);
+}
+
+void nvmed_info_decode_regs (const __u8 *p, struct nvmed_info_regs *r)
+{
+	static const __u64 szu[] = {
+		1ULL << 12, 1ULL << 16, 1ULL << 20, 1ULL << 24, 1ULL << 28, 1ULL << 32, 1ULL << 36 };
+
+	memset(r, 0, sizeof(*r));
+	r->cap = ((__u64) le32(p, 4) << 32) | le32(p, 0);
+	r->mqes = (r->cap & 0xffff) + 1;
+	r->cqr = (r->cap >> 16) & 0x1;
+	r->ams = (r->cap >> 17) & 0x3;
+	r->to = (r->cap >> 24) & 0xff;
+	r->dstrd = (r->cap >> 32) & 0xf;
+	r->nssrs = (r->cap >> 36) & 0x1;
+	r->css = (r->cap >> 37) & 0xff;
+	r->mpsmin = (r->cap >> 48) & 0xf;
+	r->mpsmax = (r->cap >> 52) & 0xf;
+	r->vs = le32(p, 8);
+
+	r->cc = le32(p, 20);
+	r->cc_en = r->cc & 0x1;
+	r->cc_css = (r->cc >> 4) & 0x7;
+	r->cc_mps = (r->cc >> 7) & 0xf;
+	r->cc_ams = (r->cc >> 11) & 0x7;
+	r->cc_shn = (r->cc >> 14) & 0x3;
+	r->cc_iosqes = (r->cc >> 16) & 0xf;
+	r->cc_iocqes = (r->cc >> 20) & 0xf;
+
+	r->csts = le32(p, 28);
+	r->csts_rdy = r->csts & 0x1;
+	r->csts_cfs = (r->csts >> 1) & 0x1;
+	r->csts_shst = (r->csts >> 2) & 0x3;
+	r->csts_nssro = (r->csts >> 4) & 0x1;
+	r->csts_pp = (r->csts >> 5) & 0x1;
+
+	r->aqa = le32(p, 36);
+	r->cmbloc = le32(p, 56);
+	r->cmbsz = le32(p, 60);
+	if (r->cmbsz && ((r->cmbsz >> 8) & 0xf) < 7) {
+		__u64 unit = szu[(r->cmbsz >> 8) & 0xf];
+
+		r->cmb_bir = r->cmbloc & 0x7;
+		r->cmb_offset = (__u64) (r->cmbloc >> 12) * unit;
+		r->cmb_size = (__u64) (r->cmbsz >> 12) * unit;
+	}
+}
+
+int nvmed_info_decode_link (const __u8 *p, int len, struct nvmed_info_link *l)
+{
+	int offset, hops;
+	__u16 id, lcap_lo;
+	__u32 lcap;
+
+	memset(l, 0, sizeof(*l));
+	if (len < 64)
+		return -EINVAL;
+
+	l->vendor_id = le16(p, 0);
+	l->device_id = le16(p, 2);
+
+	offset = p[PCI_CAP_OFFSET];
+	for (hops = 0; offset && offset + 20 <= len && hops < 48; hops++) {
+		id = le16(p, offset);
+		if (PCI_CAP_CID(id) == PCI_PXCAP_CID) {
+			lcap = le32(p, offset + 12);
+			lcap_lo = le16(p, offset + 18);
+			l->max_speed = lcap & 0xf;
+			l->max_width = (lcap >> 4) & 0x3f;
+			l->cur_speed = lcap_lo & 0xf;
+			l->cur_width = (lcap_lo >> 4) & 0x3f;
+			l->mps = 128 << ((le16(p, offset + 8) >> 5) & 0x7);
+			l->mrrs = 128 << ((le16(p, offset + 8) >> 12) & 0x7);
+			return 0;
+		}
+		offset = PCI_CAP_NEXT(id);
+	}
+	return -ENOENT;
+}
+
+
+int nvmed_info_read_controller (NVMED_INFO *ctx, struct nvmed_info_controller *c)
+{
+	__u8 *buf = (__u8 *) nvmed_info_ctx_buffer(ctx);
+	int rc;
+
+	if (buf == NULL)
+		return -ENOMEM;
+	rc = nvmed_info_ctx_identify(ctx, CNS_CONTROLLER, 0, buf);
+	if (rc)
+		return rc;
+	nvmed_info_decode_controller(buf, c);
+	return 0;
+}
+
+int nvmed_info_read_namespace (NVMED_INFO *ctx, int nsid, struct nvmed_info_namespace *ns)
+{
+	__u8 *buf = (__u8 *) nvmed_info_ctx_buffer(ctx);
+	int rc;
+
+	if (buf == NULL)
+		return -ENOMEM;
+	rc = nvmed_info_ctx_identify(ctx, CNS_NAMESPACE, nsid, buf);
+	if (rc)
+		return rc;
+	nvmed_info_decode_namespace(buf, ns);
+	ns->nsid = nsid;
+	return 0;
+}
+
+int nvmed_info_read_smart (NVMED_INFO *ctx, struct nvmed_info_smart *s)
+{
+	__u8 *buf = (__u8 *) nvmed_info_ctx_buffer(ctx);
+	int rc;
+
+	if (buf == NULL)
+		return -ENOMEM;
+	rc = nvmed_info_ctx_get_log(ctx, LOG_SMART_INFO, 0, buf, 512);
+	if (rc)
+		return rc;
+	nvmed_info_decode_smart(buf, s);
+	return 0;
+}
+
+// The Streams Return Parameters are only read when the directive is
+// supported; they are zero otherwise
+int nvmed_info_read_streams (NVMED_INFO *ctx, int nsid, struct nvmed_info_streams *s)
+{
+	__u8 *buf = (__u8 *) nvmed_info_ctx_buffer(ctx);
+	int rc;
+
+	if (buf == NULL)
+		return -ENOMEM;
+	memset(s, 0, sizeof(*s));
+	memset(buf, 0, PAGE_SIZE);
+	rc = nvmed_info_ctx_directive(ctx, NVME_ADMIN_DIRECTIVE_RECV, nsid, DIRECTIVE_IDENTIFY,
+			DIR_RECV_IDENTIFY_PARAMS, 0, 0, buf, PAGE_SIZE, NULL);
+	if (rc)
+		return rc;
+	s->supported = (buf[0] >> DIRECTIVE_STREAMS) & 0x1;
+	s->enabled = (buf[32] >> DIRECTIVE_STREAMS) & 0x1;
+	s->persistent = (buf[64] >> DIRECTIVE_STREAMS) & 0x1;
+	if (!s->supported)
+		return 0;
+
+	memset(buf, 0, 32);
+	rc = nvmed_info_ctx_directive(ctx, NVME_ADMIN_DIRECTIVE_RECV, nsid, DIRECTIVE_STREAMS,
+			DIR_RECV_STREAMS_PARAMS, 0, 0, buf, 32, NULL);
+	if (rc)
+		return rc;
+	s->msl = le16(buf, 0);
+	s->nssa = le16(buf, 2);
+	s->nsso = le16(buf, 4);
+	s->sws = le32(buf, 16);
+	s->sgs = le16(buf, 20);
+	s->nsa = le16(buf, 22);
+	s->nso = le16(buf, 24);
+	return 0;
+}
+
+int nvmed_info_read_features (NVMED_INFO *ctx, struct nvmed_info_features *f)
+{
+	static const int fids[] = {
+		FEATURE_ARBITRATION, FEATURE_POWER_MANAGEMENT, FEATURE_TEMPERATURE_THRESHOLD,
+		FEATURE_ERROR_RECOVERY, FEATURE_VOLATILE_WRITE_CACHE, FEATURE_NUMBER_OF_QUEUES,
+		FEATURE_INTERRUPT_COALESCING, FEATURE_INTERRUPT_VECTOR_CONFIG,
+		FEATURE_WRITE_ATOMICITY_NORMAL, FEATURE_ASYNC_EVENT_CONFIG,
+		FEATURE_AUTO_POWER_STATE_TRANSITION, FEATURE_HOST_MEMORY_BUFFER,
+		FEATURE_KEEP_ALIVE_TIMER, 0 };
+	const int *fid;
+	int i, len;
+	__u32 v;
+
+	memset(f, 0, sizeof(*f));
+	if (nvmed_info_ctx_buffer(ctx) == NULL)
+		return -ENOMEM;
+	for (fid = fids; *fid; fid++) {
+		len = (*fid == FEATURE_AUTO_POWER_STATE_TRANSITION)? APST_TABLE_SIZE :
+			  (*fid == FEATURE_HOST_MEMORY_BUFFER)? PAGE_SIZE : 0;
+		if (nvmed_info_ctx_get_feature(ctx, *fid, FEATURE_SEL_CURRENT, 0, 0,
+					len? ctx->buf : NULL, len, &v))
+			continue;
+		f->valid |= 1U << *fid;
+		f->raw[*fid] = v;
+
+		switch (*fid) {
+			case FEATURE_ARBITRATION:
+				f->arbitration.ab = v & 0x7;
+				f->arbitration.lpw = (v >> 8) & 0xff;
+				f->arbitration.mpw = (v >> 16) & 0xff;
+				f->arbitration.hpw = (v >> 24) & 0xff;
+				break;
+			case FEATURE_POWER_MANAGEMENT:
+				f->power_mgmt.ps = v & 0x1f;
+				f->power_mgmt.wh = (v >> 5) & 0x7;
+				break;
+			case FEATURE_ERROR_RECOVERY:
+				f->error_recovery.tler = v & 0xffff;
+				f->error_recovery.dulbe = (v >> 16) & 0x1;
+				break;
+			case FEATURE_VOLATILE_WRITE_CACHE:
+				f->wce = v & 0x1;
+				break;
+			case FEATURE_NUMBER_OF_QUEUES:
+				f->queues.nsqa = (v & 0xffff) + 1;
+				f->queues.ncqa = (v >> 16) + 1;
+				break;
+			case FEATURE_INTERRUPT_COALESCING:
+				f->coalescing.thr = v & 0xff;
+				f->coalescing.time = (v >> 8) & 0xff;
+				break;
+			case FEATURE_WRITE_ATOMICITY_NORMAL:
+				f->wan_dn = v & 0x1;
+				break;
+			case FEATURE_ASYNC_EVENT_CONFIG:
+				f->async_event = v;
+				break;
+			case FEATURE_AUTO_POWER_STATE_TRANSITION:
+				f->apst.apste = v & 0x1;
+				for (i = 0; i < MAX_POWER_STATES; i++) {
+					__u32 e = le32(ctx->buf, i * APST_ENTRY_SIZE);
+
+					f->apst.entry[i].itps = APST_ITPS(e);
+					f->apst.entry[i].itpt = APST_ITPT(e);
+				}
+				break;
+			case FEATURE_HOST_MEMORY_BUFFER:
+				f->hmb.ehm = v & 0x1;
+				f->hmb.mr = (v >> 1) & 0x1;
+				f->hmb.hsize = le32(ctx->buf, 0);
+				f->hmb.hmdla = ((__u64) le32(ctx->buf, 8) << 32) | le32(ctx->buf, 4);
+				f->hmb.hmdlec = le32(ctx->buf, 12);
+				break;
+			case FEATURE_KEEP_ALIVE_TIMER:
+				f->kato = v;
+				break;
+		}
+	}
+	return f->valid? 0 : -EIO;
+}
+
+// Maps the controller registers (BAR0) of the context
+static void *ctx_map_bar (NVMED_INFO *ctx, int *fd)
+{
+	char path[256];
+	void *bar;
+	int rc;
+
+	rc = nvmed_info_ctx_sysfs_path(ctx, "resource0", path, sizeof(path));
+	if (rc) {
+		errno = -rc;
+		return MAP_FAILED;
+	}
+	HOOK(ctx, NVMED_INFO_HOOK_SYSFS, 1);
+	*fd = open(path, O_RDWR | O_SYNC);
+	bar = (*fd < 0)? MAP_FAILED : mmap(0, PAGE_SIZE, PROT_READ, MAP_SHARED, *fd, 0);
+	rc = errno;
+	if (bar == MAP_FAILED && *fd >= 0)
+		close(*fd);
+	HOOK(ctx, NVMED_INFO_HOOK_SYSFS, 0);
+	errno = rc;
+	return bar;
+}
+
+// Copies the first len bytes of the controller registers (BAR0) into regs
+int nvmed_info_ctx_read_bar (NVMED_INFO *ctx, __u8 *regs, int len)
+{
+	void *bar;
+	int i, fd;
+
+	if (len <= 0 || len > PAGE_SIZE || (len & 0x3))
+		return -EINVAL;
+	bar = ctx_map_bar(ctx, &fd);
+	if (bar == MAP_FAILED)
+		return -errno;
+
+	// MMIO registers should be read in 32-bit units
+	for (i = 0; i < len; i += 4)
+		*((__u32 *) &regs[i]) = *((volatile __u32 *) ((__u8 *) bar + i));
+
+	munmap(bar, PAGE_SIZE);
+	close(fd);
+	return 0;
+}
+
+// Reads only the registers in the first 256 bytes whose dword bit is set
+// in mask (bit 0 = offset 0, bit 7 = CSTS); the others are left untouched
+int nvmed_info_ctx_read_bar_dwords (NVMED_INFO *ctx, __u8 *regs, __u64 mask)
+{
+	void *bar;
+	int i, fd;
+
+	bar = ctx_map_bar(ctx, &fd);
+	if (bar == MAP_FAILED)
+		return -errno;
+
+	for (i = 0; i < 64; i++)
+		if (mask & (1ULL << i))
+			*((__u32 *) &regs[i * 4]) = *((volatile __u32 *) ((__u8 *) bar + i * 4));
+
+	munmap(bar, PAGE_SIZE);
+	close(fd);
+	return 0;
+}
+
+// Copies up to len bytes of the PCI configuration space; returns the
+// number of bytes read
+int nvmed_info_ctx_read_config (NVMED_INFO *ctx, __u8 *config, int len)
+{
+	char path[256];
+	int fd, rc;
+
+	rc = nvmed_info_ctx_sysfs_path(ctx, "config", path, sizeof(path));
+	if (rc)
+		return rc;
+	HOOK(ctx, NVMED_INFO_HOOK_SYSFS, 1);
+	fd = open(path, O_RDONLY);
+	rc = (fd < 0)? -1 : pread(fd, config, len, 0);
+	if (rc < 0)
+		rc = -errno;
+	if (fd >= 0)
+		close(fd);
+	HOOK(ctx, NVMED_INFO_HOOK_SYSFS, 0);
+	return rc;
+}
+
+int nvmed_info_read_regs (NVMED_INFO *ctx, struct nvmed_info_regs *r)
+{
+	__u8 regs[64];
+	int rc;
+
+	rc = nvmed_info_ctx_read_bar(ctx, regs, sizeof(regs));
+	if (rc)
+		return rc;
+	nvmed_info_decode_regs(regs, r);
+	return 0;
+}
+
+int nvmed_info_read_link (NVMED_INFO *ctx, struct nvmed_info_link *l)
+{
+	__u8 config[256];
+	int len;
+
+	len = nvmed_info_ctx_read_config(ctx, config, sizeof(config));
+	if (len < 0)
+		return len;
+	return nvmed_info_decode_link(config, len, l);
+}
+
+
+// Reads one attribute of a sysfs directory, without the trailing newline
+static int sysfs_attr (const char *dir, const char *name, char *buf, int len)
+{
+	char path[512];
+	int fd, n;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -errno;
+	while (n > 0 && (buf[n-1] == '\n' || buf[n-1] == ' '))
+		n--;
+	buf[n] = '\0';
+	return 0;
+}
+
+static int sysfs_ulong (const char *dir, const char *name, unsigned long *v)
+{
+	char buf[64], *end;
+
+	if (sysfs_attr(dir, name, buf, sizeof(buf)))
+		return -1;
+	*v = strtoul(buf, &end, 0);
+	return (end == buf)? -1 : 0;
+}
+
+// "8.0 GT/s PCIe" to the generation, 3
+static __u8 sysfs_link_speed (const char *s)
+{
+	static const double gts[] = { 2.5, 5.0, 8.0, 16.0, 32.0, 64.0 };
+	double v = atof(s);
+	int i;
+
+	for (i = 0; i < (int) (sizeof(gts) / sizeof(gts[0])); i++)
+		if (v > 0 && v <= gts[i])
+			return i + 1;
+	return 0;
+}
+
+// Finds the kernel controller ("nvme0") of a controller or namespace node
+static int sysfs_controller (const char *name, char *ctrl, int len)
+{
+	char path[512], link[256], *p;
+	struct stat st;
+	int n, id;
+
+	snprintf(path, sizeof(path), "/sys/class/nvme/%s", name);
+	if (stat(path, &st) == 0) {
+		snprintf(ctrl, len, "%s", name);
+		return 0;
+	}
+
+	snprintf(path, sizeof(path), "/sys/class/block/%s/device", name);
+	n = readlink(path, link, sizeof(link) - 1);
+	if (n > 0) {
+		link[n] = '\0';
+		p = strrchr(link, '/');
+		snprintf(path, sizeof(path), "/sys/class/nvme/%s", p? p + 1 : link);
+		if (stat(path, &st) == 0) {
+			snprintf(ctrl, len, "%.*s", len - 1, p? p + 1 : link);
+			return 0;
+		}
+	}
+
+	// With native multipath, nvme0n1 is a subsystem node; try nvme0
+	if (sscanf(name, "nvme%d", &id) == 1) {
+		snprintf(ctrl, len, "nvme%d", id);
+		snprintf(path, sizeof(path), "/sys/class/nvme/%s", ctrl);
+		if (stat(path, &st) == 0)
+			return 0;
+	}
+	return -ENOENT;
+}
+
+// Fills what the kernel exposes under /sys/class/nvme, /sys/class/block
+// and /sys/bus/pci/devices, which needs neither root, the nvmed module nor
+// admin commands; returns 0 if the controller was found
+int nvmed_info_read_inventory (const char *dev_path, struct nvmed_info_inventory *inv)
+{
+	char ctrl[256], pci[300], ns[256], buf[128], link[256];
+	const char *name = strrchr(dev_path, '/');
+	unsigned long v, w;
+	int n;
+
+	memset(inv, 0, sizeof(*inv));
+	inv->numa_node = -1;
+	name = name? name + 1 : dev_path;
+	if (sysfs_controller(name, inv->ctrl, sizeof(inv->ctrl)))
+		return -ENOENT;
+	snprintf(ctrl, sizeof(ctrl), "/sys/class/nvme/%s", inv->ctrl);
+	snprintf(pci, sizeof(pci), "%s/device", ctrl);
+
+	if (sysfs_attr(ctrl, "serial", inv->sn, sizeof(inv->sn)) == 0 &&
+			sysfs_attr(ctrl, "model", inv->mn, sizeof(inv->mn)) == 0 &&
+			sysfs_attr(ctrl, "firmware_rev", inv->fr, sizeof(inv->fr)) == 0)
+		inv->valid |= NVMED_INFO_INV_IDENTITY;
+
+	if (sysfs_ulong(ctrl, "cntlid", &v) == 0) {
+		inv->cntlid = v;
+		inv->valid |= NVMED_INFO_INV_CNTLID;
+	}
+
+	// queue_count includes the admin queue; sqsize is 0's based
+	if (sysfs_ulong(ctrl, "queue_count", &v) == 0 && sysfs_ulong(ctrl, "sqsize", &w) == 0) {
+		inv->queue_count = v? v - 1 : 0;
+		inv->queue_size = w + 1;
+		inv->valid |= NVMED_INFO_INV_QUEUES;
+	}
+
+	n = readlink(pci, link, sizeof(link) - 1);
+	if (n > 0 && sysfs_ulong(pci, "vendor", &v) == 0) {
+		link[n] = '\0';
+		snprintf(inv->address, sizeof(inv->address), "%.15s", strrchr(link, '/')? strrchr(link, '/') + 1 : link);
+		inv->vid = inv->link.vendor_id = v;
+		if (sysfs_ulong(pci, "device", &v) == 0)
+			inv->did = inv->link.device_id = v;
+		if (sysfs_ulong(pci, "subsystem_vendor", &v) == 0)
+			inv->ssvid = v;
+		if (sysfs_attr(pci, "numa_node", buf, sizeof(buf)) == 0)
+			inv->numa_node = atoi(buf);
+		inv->valid |= NVMED_INFO_INV_PCI;
+	}
+
+	if (sysfs_attr(pci, "current_link_speed", buf, sizeof(buf)) == 0) {
+		inv->link.cur_speed = sysfs_link_speed(buf);
+		if (sysfs_attr(pci, "max_link_speed", buf, sizeof(buf)) == 0)
+			inv->link.max_speed = sysfs_link_speed(buf);
+		if (sysfs_ulong(pci, "current_link_width", &v) == 0)
+			inv->link.cur_width = v;
+		if (sysfs_ulong(pci, "max_link_width", &v) == 0)
+			inv->link.max_width = v;
+		if (inv->link.cur_speed && inv->link.cur_width)
+			inv->valid |= NVMED_INFO_INV_LINK;
+	}
+
+	// Namespace attributes, when dev_path is a namespace
+	if (strcmp(name, inv->ctrl)) {
+		snprintf(ns, sizeof(ns), "/sys/class/block/%s", name);
+		if (sysfs_ulong(ns, "size", &v) == 0 &&
+				sysfs_ulong(ns, "queue/logical_block_size", &w) == 0) {
+			inv->capacity = (__u64) v * 512;
+			inv->lba_size = w;
+			inv->nsid = (sysfs_ulong(ns, "nsid", &v) == 0)? v : 0;
+			inv->valid |= NVMED_INFO_INV_NAMESPACE;
+		}
+		if (sysfs_attr(ns, "queue/write_cache", buf, sizeof(buf)) == 0) {
+			inv->vwc = !strcmp(buf, "write back");
+			inv->valid |= NVMED_INFO_INV_VWC;
+		}
+	}
+	return 0;
+}
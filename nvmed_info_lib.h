@@ -0,0 +1,387 @@
+#ifndef _NVMED_INFO_LIB_H
+#define _NVMED_INFO_LIB_H
+
+// libnvmed_info: decodes NVMe controller information into typed structures.
+//
+// Every function takes its own device context, so the library keeps no global
+// state; a context must not be used by two threads at the same time.
+// Functions return 0 on success, a negative errno value on a system error,
+// or a positive NVMe status code when the controller failed the command.
+// Nothing is printed.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <linux/types.h>
+
+// CNS values for IDENTIFY command (Figure 86, p.96)
+#define CNS_NAMESPACE	0
+#define CNS_CONTROLLER	1
+#define CNS_NVM_SET_LIST	4		// NVMe 1.4
+
+// Admin opcodes newer than nvme_hdr.h (NVMe 1.3)
+#define NVME_ADMIN_DIRECTIVE_SEND	0x19
+#define NVME_ADMIN_DIRECTIVE_RECV	0x1a
+
+// Directive Types and Operations (NVMe 1.3, 9.1 and 9.3)
+#define DIRECTIVE_IDENTIFY			0x00
+#define DIRECTIVE_STREAMS			0x01
+#define DIR_RECV_IDENTIFY_PARAMS	0x01	// Identify: Return Parameters
+#define DIR_SEND_IDENTIFY_ENABLE	0x01	// Identify: Enable Directive
+#define DIR_RECV_STREAMS_PARAMS		0x01	// Streams: Return Parameters
+#define DIR_RECV_STREAMS_STATUS		0x02	// Streams: Get Status
+#define DIR_RECV_STREAMS_ALLOCATE	0x03	// Streams: Allocate Resources
+#define DIR_SEND_STREAMS_RELEASE_ID	0x01	// Streams: Release Identifier
+#define DIR_SEND_STREAMS_RELEASE	0x02	// Streams: Release Resources
+
+#define FEATURE_SEL_CURRENT     (0)
+#define FEATURE_SEL_DEFAULT     (1 << 8)
+#define FEATURE_SEL_SAVED       (2 << 8)
+#define FEATURE_SEL_SUPPORTED   (3 << 8)
+
+#define FEATURE_SAVE			(1U << 31)
+
+#define FEATURE_ARBITRATION                     (0x01)
+#define FEATURE_POWER_MANAGEMENT                (0x02)
+#define FEATURE_LBA_RANGE_TYPE                  (0x03)
+#define FEATURE_TEMPERATURE_THRESHOLD           (0x04)
+#define FEATURE_ERROR_RECOVERY                  (0x05)
+#define FEATURE_VOLATILE_WRITE_CACHE            (0x06)
+#define FEATURE_NUMBER_OF_QUEUES                (0x07)
+#define FEATURE_INTERRUPT_COALESCING            (0x08)
+#define FEATURE_INTERRUPT_VECTOR_CONFIG         (0x09)
+#define FEATURE_WRITE_ATOMICITY_NORMAL          (0x0a)
+#define FEATURE_ASYNC_EVENT_CONFIG              (0x0b)
+#define FEATURE_AUTO_POWER_STATE_TRANSITION     (0x0c)
+#define FEATURE_HOST_MEMORY_BUFFER              (0x0d)
+#define FEATURE_KEEP_ALIVE_TIMER				(0x0f)
+#define FEATURE_HOST_THERMAL_MGMT				(0x10)		// NVMe 1.3
+#define FEATURE_PLM_CONFIG						(0x13)		// NVMe 1.4, per NVM Set
+#define FEATURE_PLM_WINDOW						(0x14)		// NVMe 1.4, per NVM Set
+#define FEATURE_SW_PROGRESS_MARKER              (0x80)
+#define FEATURE_HOST_IDENTIFIER                 (0x81)
+#define FEATURE_RESERVATION_NOTI_MASK			(0x82)
+#define FEATURE_RESERVATION_PERSISTENCE         (0x83)
+
+// Power State Descriptors in IDENTIFY Controller (Figure 91, p.106)
+#define PSD0				2048	// Offset for PSD0
+#define PSD_SIZE			32
+#define MAX_POWER_STATES	32
+
+struct power_state {
+	int ps;
+	__u16 mp;							// Maximum Power in MXPS units
+	int mxps;
+	int nops;							// non-operational state
+	__u32 enlat;						// Entry Latency (usec)
+	__u32 exlat;						// Exit Latency (usec)
+	int rrt, rrl, rwt, rwl;
+};
+
+// Autonomous Power State Transition data structure (Figure 128, p.136)
+#define APST_TABLE_SIZE		256
+#define APST_ENTRY_SIZE		8
+#define APST_ITPS(e)		(((e) >> 3) & 0x1f)
+#define APST_ITPT(e)		(((e) >> 8) & 0xffffff)
+
+#define LOG_ERROR_INFO                          (0x01)
+#define LOG_SMART_INFO                          (0x02)
+#define LOG_FIRMWARE_SLOT_INFO                  (0x03)
+#define LOG_CHANGED_NAMESPACE_LIST              (0x04)
+#define LOG_COMMAND_EFFECTS                     (0x05)
+#define LOG_PLM_PER_NVM_SET                     (0x0a)		// NVMe 1.4, LSI = NVM Set ID
+#define LOG_PLM_EVENT_AGGREGATE                 (0x0b)		// NVMe 1.4
+
+// Opaque per-device context
+typedef struct nvmed_info_ctx NVMED_INFO;
+
+struct nvmed_info_controller {
+	__u16 vid;							// PCI Vendor ID
+	__u16 ssvid;						// PCI Subsystem Vendor ID
+	char sn[21];						// Serial Number
+	char mn[41];						// Model Number
+	char fr[9];							// Firmware Revision
+	__u8 rab;							// Recommended Arbitration Burst
+	__u32 ieee;							// IEEE OUI Identifier
+	__u8 cmic;
+	__u8 mdts;							// Maximum Data Transfer Size (2^n * MPSMIN)
+	__u16 cntlid;
+	__u32 ver;
+	__u32 rtd3r;
+	__u32 rtd3e;
+	__u32 oaes;
+	__u32 ctratt;						// Controller Attributes
+	__u16 oacs;							// Optional Admin Command Support
+	__u8 acl;
+	__u8 aerl;							// Asynchronous Event Request Limit (0's based)
+	__u8 frmw;
+	__u8 lpa;
+	__u8 elpe;
+	__u8 npss;							// Number of Power States Support (0's based)
+	__u8 avscc;
+	__u8 apsta;
+	__u16 wctemp;						// Kelvin
+	__u16 cctemp;						// Kelvin
+	__u16 mtfa;
+	__u32 hmpre;						// 4 KB units
+	__u32 hmmin;						// 4 KB units
+	__u64 tnvmcap;						// bytes, saturated to 64 bits
+	__u64 unvmcap;						// bytes, saturated to 64 bits
+	__u32 rpmbs;
+	__u16 kas;
+	__u16 hctma;						// Host Controlled Thermal Management Attributes (1.3)
+	__u16 mntmt;						// Minimum Thermal Management Temperature, Kelvin (1.3)
+	__u16 mxtmt;						// Maximum Thermal Management Temperature, Kelvin (1.3)
+	__u32 hmminds;						// Host Memory Buffer Minimum Descriptor Entry Size, 4 KB units (1.4)
+	__u16 hmmaxd;						// Host Memory Maximum Descriptors Entries (1.4)
+	__u16 nsetidmax;					// NVM Set Identifier Maximum (1.4)
+	__u8 sqes;
+	__u8 cqes;
+	__u16 maxcmd;
+	__u32 nn;
+	__u16 oncs;
+	__u16 fuses;
+	__u8 fna;
+	__u8 vwc;
+	__u16 awun;
+	__u16 awupf;
+	__u8 nvscc;
+	__u16 acwu;
+	__u32 sgls;
+	struct power_state psd[MAX_POWER_STATES];
+};
+
+struct nvmed_info_lbaf {
+	__u16 ms;							// Metadata Size (bytes)
+	__u8 lbads;							// LBA Data Size (2^n bytes)
+	__u8 rp;							// Relative Performance (0: Best)
+};
+
+struct nvmed_info_namespace {
+	__u32 nsid;
+	__u64 nsze;
+	__u64 ncap;
+	__u64 nuse;
+	__u8 nsfeat;
+	__u8 nlbaf;							// 0's based
+	__u8 flbas;
+	__u8 mc;
+	__u8 dpc;
+	__u8 dps;
+	__u8 nmic;
+	__u8 rescap;
+	__u8 fpi;
+	__u16 nawun;
+	__u16 nawupf;
+	__u16 nacwu;
+	__u16 nabsn;
+	__u16 nabo;
+	__u16 nabspf;
+	__u64 nvmcap;						// bytes, saturated to 64 bits
+	__u16 npwg;							// NVMe 1.4, valid if NSFEAT bit 4; 0's based LBAs
+	__u16 npwa;
+	__u16 npdg;
+	__u16 npda;
+	__u16 nows;
+	__u8 nguid[16];
+	__u8 eui64[8];
+	struct nvmed_info_lbaf lbaf[16];
+};
+
+// 128-bit counters are saturated to 64 bits
+struct nvmed_info_smart {
+	__u8 critical_warning;
+	__u16 composite_temp;				// Kelvin
+	__u8 avail_spare;					// percent
+	__u8 spare_thresh;					// percent
+	__u8 percent_used;
+	__u64 data_units_read;				// 1000 * 512 bytes
+	__u64 data_units_written;			// 1000 * 512 bytes
+	__u64 host_read_cmds;
+	__u64 host_write_cmds;
+	__u64 ctrl_busy_time;				// minutes
+	__u64 power_cycles;
+	__u64 power_on_hours;
+	__u64 unsafe_shutdowns;
+	__u64 media_errors;
+	__u64 num_err_log_entries;
+	__u32 warning_temp_time;			// minutes
+	__u32 critical_temp_time;			// minutes
+	__u16 temp_sensor[8];				// Kelvin, 0 if not implemented
+};
+
+// Current values of the controller-wide features; raw[fid] is valid when
+// bit fid of valid is set, and the decoded members follow from it.
+struct nvmed_info_features {
+	__u32 valid;
+	__u32 raw[32];
+	struct { __u8 ab, lpw, mpw, hpw; } arbitration;
+	struct { __u8 ps, wh; } power_mgmt;
+	struct { __u16 tler; __u8 dulbe; } error_recovery;
+	__u8 wce;
+	struct { __u16 nsqa, ncqa; } queues;			// 1's based
+	struct { __u8 thr, time; } coalescing;		// THR 0's based, TIME 100 usec
+	__u8 wan_dn;
+	__u32 async_event;
+	struct {
+		__u8 apste;
+		struct { __u8 itps; __u32 itpt; } entry[MAX_POWER_STATES];
+	} apst;
+	struct { __u8 ehm, mr; __u32 hsize, hmdlec; __u64 hmdla; } hmb;
+	__u32 kato;							// msec
+};
+
+// Controller registers (BAR0)
+struct nvmed_info_regs {
+	__u64 cap;
+	__u32 mqes;							// 1's based
+	__u8 cqr;
+	__u8 ams;
+	__u8 to;							// 500 msec units
+	__u8 dstrd;
+	__u8 nssrs;
+	__u8 css;
+	__u8 mpsmin;						// 2^(12 + n) bytes
+	__u8 mpsmax;						// 2^(12 + n) bytes
+	__u32 vs;
+	__u32 cc;
+	__u8 cc_en;
+	__u8 cc_css;
+	__u8 cc_mps;
+	__u8 cc_ams;
+	__u8 cc_shn;
+	__u8 cc_iosqes;
+	__u8 cc_iocqes;
+	__u32 csts;
+	__u8 csts_rdy;
+	__u8 csts_cfs;
+	__u8 csts_shst;
+	__u8 csts_nssro;
+	__u8 csts_pp;
+	__u32 aqa;
+	__u32 cmbloc;
+	__u32 cmbsz;
+	__u8 cmb_bir;
+	__u64 cmb_offset;					// bytes
+	__u64 cmb_size;						// bytes
+};
+
+// PCI Express link (config space)
+struct nvmed_info_link {
+	__u16 vendor_id;
+	__u16 device_id;
+	__u8 max_speed;						// Gen N
+	__u8 max_width;						// lanes
+	__u8 cur_speed;						// Gen N
+	__u8 cur_width;						// lanes
+	__u16 mps;							// Max_Payload_Size (bytes)
+	__u16 mrrs;							// Max_Read_Request_Size (bytes)
+};
+
+// Streams Directive (NVMe 1.3): Identify and Streams Return Parameters
+struct nvmed_info_streams {
+	int supported;						// Directives Supported, Streams bit
+	int enabled;						// Directives Enabled for the namespace
+	int persistent;						// Persistent across controller resets (1.4)
+	__u16 msl;							// Max Streams Limit
+	__u16 nssa;							// NVM Subsystem Streams Available
+	__u16 nsso;							// NVM Subsystem Streams Open
+	__u32 sws;							// Stream Write Size (logical blocks)
+	__u16 sgs;							// Stream Granularity Size (SWS units)
+	__u16 nsa;							// Namespace Streams Allocated
+	__u16 nso;							// Namespace Streams Open
+};
+
+// Filled from sysfs by nvmed_info_read_inventory(); valid tells which of
+// the NVMED_INFO_INV_* parts the kernel exposed
+#define NVMED_INFO_INV_IDENTITY		(1 << 0)	// sn, mn, fr
+#define NVMED_INFO_INV_PCI			(1 << 1)	// address, vid, did, ssvid, numa_node
+#define NVMED_INFO_INV_CNTLID		(1 << 2)
+#define NVMED_INFO_INV_LINK			(1 << 3)	// link speeds and widths
+#define NVMED_INFO_INV_QUEUES		(1 << 4)	// queue_count, queue_size
+#define NVMED_INFO_INV_NAMESPACE	(1 << 5)	// nsid, capacity, lba_size
+#define NVMED_INFO_INV_VWC			(1 << 6)
+
+struct nvmed_info_inventory {
+	__u32 valid;
+	char ctrl[32];						// kernel controller, e.g. "nvme0"
+	char address[16];					// PCI address, e.g. "0000:01:00.0"
+	char sn[21];
+	char mn[41];
+	char fr[9];
+	__u16 vid;
+	__u16 did;
+	__u16 ssvid;
+	__u16 cntlid;
+	int numa_node;						// -1 if none
+	__u32 queue_count;					// I/O queues, without the admin queue
+	__u32 queue_size;					// entries
+	__u8 vwc;							// volatile write cache enabled
+	__u32 nsid;							// 0 if unknown
+	__u64 capacity;						// bytes
+	__u32 lba_size;						// bytes
+	struct nvmed_info_link link;		// speeds and widths only
+};
+
+struct nvme_passthru_cmd;
+
+// Called with begin = 1 before and begin = 0 after every admin command and
+// every sysfs open/mmap of a context, e.g. for profiling
+#define NVMED_INFO_HOOK_ADMIN	0
+#define NVMED_INFO_HOOK_SYSFS	1
+
+typedef void (*nvmed_info_hook) (void *arg, int event, int begin);
+
+// Handles opened on first use, see nvmed_info_ctx_handles()
+#define NVMED_INFO_HANDLE_NVMED		(1 << 0)	// nvmed_open(), for sysfs paths
+#define NVMED_INFO_HANDLE_DEVICE	(1 << 1)	// the device, for admin commands
+#define NVMED_INFO_HANDLE_BUFFER	(1 << 2)	// the DMA buffer
+
+extern NVMED_INFO *nvmed_info_ctx_open (const char *dev_path);
+extern void nvmed_info_ctx_close (NVMED_INFO *ctx);
+extern const char *nvmed_info_ctx_path (NVMED_INFO *ctx);
+extern int nvmed_info_ctx_sysfs_path (NVMED_INFO *ctx, const char *name, char *path, int len);
+extern void nvmed_info_ctx_set_hook (NVMED_INFO *ctx, nvmed_info_hook hook, void *arg);
+extern int nvmed_info_ctx_handles (NVMED_INFO *ctx);
+
+// Raw commands; buf must be DMA-able (see nvmed_info_ctx_buffer)
+extern int nvmed_info_ctx_admin (NVMED_INFO *ctx, struct nvme_passthru_cmd *cmd);
+extern void *nvmed_info_ctx_buffer (NVMED_INFO *ctx);
+extern int nvmed_info_ctx_identify (NVMED_INFO *ctx, int cns, int nsid, void *buf);
+extern int nvmed_info_ctx_get_log (NVMED_INFO *ctx, int lid, int nsid, void *buf, int len);
+extern int nvmed_info_ctx_get_log_ext (NVMED_INFO *ctx, int lid, int lsi, int nsid, void *buf, int len);
+extern int nvmed_info_ctx_get_feature (NVMED_INFO *ctx, int fid, int sel, int nsid, __u32 cdw11,
+		void *buf, int len, __u32 *result);
+extern int nvmed_info_ctx_set_feature (NVMED_INFO *ctx, int fid, int nsid, __u32 cdw11, int save,
+		void *buf, int len, __u32 *result);
+extern int nvmed_info_ctx_directive (NVMED_INFO *ctx, int opcode, int nsid, int dtype, int doper,
+		int dspec, __u32 cdw12, void *buf, int len, __u32 *result);
+extern int nvmed_info_ctx_read_bar (NVMED_INFO *ctx, __u8 *regs, int len);
+extern int nvmed_info_ctx_read_bar_dwords (NVMED_INFO *ctx, __u8 *regs, __u64 mask);
+extern int nvmed_info_ctx_read_config (NVMED_INFO *ctx, __u8 *config, int len);
+
+// Decoders for raw pages
+extern void nvmed_info_decode_controller (const __u8 *p, struct nvmed_info_controller *c);
+extern void nvmed_info_decode_namespace (const __u8 *p, struct nvmed_info_namespace *ns);
+extern void nvmed_info_decode_smart (const __u8 *p, struct nvmed_info_smart *s);
+extern void nvmed_info_decode_regs (const __u8 *p, struct nvmed_info_regs *r);
+extern int nvmed_info_decode_link (const __u8 *config, int len, struct nvmed_info_link *l);
+
+// Typed reads
+extern int nvmed_info_read_controller (NVMED_INFO *ctx, struct nvmed_info_controller *c);
+extern int nvmed_info_read_namespace (NVMED_INFO *ctx, int nsid, struct nvmed_info_namespace *ns);
+extern int nvmed_info_read_smart (NVMED_INFO *ctx, struct nvmed_info_smart *s);
+extern int nvmed_info_read_features (NVMED_INFO *ctx, struct nvmed_info_features *f);
+extern int nvmed_info_read_regs (NVMED_INFO *ctx, struct nvmed_info_regs *r);
+extern int nvmed_info_read_link (NVMED_INFO *ctx, struct nvmed_info_link *l);
+extern int nvmed_info_read_streams (NVMED_INFO *ctx, int nsid, struct nvmed_info_streams *s);
+
+// Without a context: sysfs only, no root or nvmed module needed
+extern int nvmed_info_read_inventory (const char *dev_path, struct nvmed_info_inventory *inv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NVMED_INFO_LIB_H */
@@ -23,6 +23,8 @@ static struct log_pages logs[] = {
 	{LOG_ERROR_INFO,					0, "Error Information",			nvmed_info_logs_error},				
 	{LOG_SMART_INFO,	 				0, "SMART/Health Information",	nvmed_info_logs_smart},		
 	{LOG_FIRMWARE_SLOT_INFO,			0, "Firmware Slot Information",	nvmed_info_logs_firmware},	
+	{LOG_PLM_PER_NVM_SET,				SCOPE_NVM_SET, "Predictable Latency Per NVM Set",	nvmed_info_logs_plm},
+	{LOG_PLM_EVENT_AGGREGATE,			0, "Predictable Latency Event Aggregate",	nvmed_info_logs_plm_aggregate},
 	/* optional
 	{LOG_CHANGED_NAMESPACE_LIST,		0, "Changed Namespace List",	nvmed_info_logs_namespace},
 	{LOG_COMMAND_EFFECTS,				0, "Command Effects Log",		nvmed_info_logs_command},	
@@ -34,8 +36,8 @@ int nvmed_info_logs (NVMED *nvmed, char **cmd_args)
 {
 	struct nvmed_info_cmd *c;
 
-	if (cmd_args[0] == NULL)
-		return nvmed_info_get_logs(nvmed, NULL);
+	if (cmd_args[0] == NULL || cmd_args[0][0] == '-')
+		return nvmed_info_get_logs(nvmed, cmd_args);
 
 	c = cmd_lookup(logs_cmds, cmd_args[0]);
 	if (c)
@@ -52,6 +54,12 @@ int nvmed_info_logs_help (char *s)
 }
 
 int nvmed_info_get_logs_issue (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 *result)
+{
+	return nvmed_info_get_logs_ext_issue(nvmed, logid, 0, p, len, result);
+}
+
+// lsi goes to the Log Specific Identifier (CDW11 bits 31:16), e.g. an NVM Set ID
+int nvmed_info_get_logs_ext_issue (NVMED *nvmed, int logid, int lsi, __u8 *p, int len, __u32 *result)
 {
 	struct nvme_admin_cmd cmd;
 	int rc;
@@ -67,6 +75,7 @@ int nvmed_info_get_logs_issue (NVMED *nvmed, int logid, int nsid, __u8 *p, int l
 	// The spec says cdw10 should be ((len / 4) << 16 | logid)
 	// However, for XS1715, NUMD should not be larger than 0x7f
 	cmd.cdw10 = htole32(((0x7f) << 16) | logid);
+	cmd.cdw11 = htole32((__u32) lsi << 16);
 
 	rc = nvmed_info_admin_command(nvmed, &cmd);
 	*result = cmd.result;
@@ -78,7 +87,7 @@ int nvmed_info_get_logs (NVMED *nvmed, char **cmd_args)
 	int rc;
 	__u8 *p;
 	__u32 res;
-	int nsid = 1;
+	int nsid = 1, setid;
 	struct log_pages *f;
 	
 	p = (__u8 *) nvmed_get_buffer(nvmed, 1);
@@ -87,13 +96,18 @@ int nvmed_info_get_logs (NVMED *nvmed, char **cmd_args)
 		return -1;
 	}
 
-	if (cmd_args && cmd_args[0]) {
+	if (cmd_args && cmd_args[0] && cmd_args[0][0] != '-') {
 		nsid = atoi(cmd_args[0]);
 		if (nsid <= 0) {
 			printf("Invalid namespace ID %d\n", nsid);
 			return -1;
 		}
 	}
+	setid = nvmed_info_opt_long(cmd_args, "--set", 1);
+	if (setid <= 0 || setid > 0xffff) {
+		printf("Invalid NVM Set ID %d\n", setid);
+		return -1;
+	}
 
 	PRINT_NVMED_INFO;
 	P ("GET LOG PAGES\n");
@@ -102,7 +116,8 @@ int nvmed_info_get_logs (NVMED *nvmed, char **cmd_args)
 
 	f = logs;
 	while (f->logname) {
-		rc = nvmed_info_get_logs_issue(nvmed, f->logid, f->cns? nsid : 0, p, PAGE_SIZE, &res);
+		rc = nvmed_info_get_logs_ext_issue(nvmed, f->logid, (f->cns == SCOPE_NVM_SET)? setid : 0,
+				p, PAGE_SIZE, &res);
 		if (rc < 0) {
 			P ("%02x-------  ----N/A---  %s\n", f->logid, f->logname);
 			f++;
@@ -110,8 +125,10 @@ int nvmed_info_get_logs (NVMED *nvmed, char **cmd_args)
 		}
 		else {
 			P ("%02x-------  0x%08x  %s", f->logid, res, f->logname);
-			if (f->cns)
+			if (f->cns == SCOPE_NAMESPACE)
 				P (" (Namespace ID: %d)\n", nsid);
+			else if (f->cns == SCOPE_NVM_SET)
+				P (" (NVM Set ID: %d)\n", setid);
 			else
 				P ("\n");
 		}
@@ -126,6 +143,19 @@ int nvmed_info_get_logs (NVMED *nvmed, char **cmd_args)
 	return 0;
 }
 
+// Prints a log page fetched elsewhere; returns -1 if it has no decoder
+int nvmed_info_logs_print (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 res)
+{
+	struct log_pages *f;
+
+	for (f = logs; f->logname; f++)
+		if (f->logid == logid) {
+			P ("%02x-------  0x%08x  %s\n", f->logid, res, f->logname);
+			return f->cmd_fn(nvmed, logid, nsid, p, len, res);
+		}
+	return -1;
+}
+
 int nvmed_info_logs_error (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 res)
 {
 	__u32 _v;
@@ -202,6 +232,50 @@ int nvmed_info_logs_firmware (NVMED *nvmed, int logid, int nsid, __u8 *p, int le
 	return 0;
 }
 
+int nvmed_info_logs_plm (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 res)
+{
+	__u32 _v;
+
+	PH1 (0);	P ("Status: %s\n", (F(0,2) == 0)? "Predictable Latency Mode not enabled" :
+								(F(0,2) == 1)? "Deterministic Window (DTWIN)" :
+								(F(0,2) == 2)? "Non-Deterministic Window (NDWIN)" : "Reserved");
+	PH2 (2);	P ("Event Type: %s\n", F(0,15)? "" : "None");
+	if (F(0,0))
+		P ("%26c  DTWIN Reads Warning\n", SP);
+	if (F(1,1))
+		P ("%26c  DTWIN Writes Warning\n", SP);
+	if (F(2,2))
+		P ("%26c  DTWIN Time Warning\n", SP);
+	if (F(14,14))
+		P ("%26c  Autonomous transition to NDWIN: typical or maximum value exceeded\n", SP);
+	if (F(15,15))
+		P ("%26c  Autonomous transition to NDWIN: Deterministic Excursion\n", SP);
+
+	PV (32, 39, "DTWIN Reads Typical", "(4 KiB reads)");
+	PV (40, 47, "DTWIN Writes Typical", "(Optimal Write Size units)");
+	PV (48, 55, "DTWIN Time Maximum", "(msec)");
+	PV (56, 63, "NDWIN Time Minimum High", "(msec)");
+	PV (64, 71, "NDWIN Time Minimum Low", "(msec)");
+	PV (128, 135, "DTWIN Reads Estimate", "(4 KiB reads)");
+	PV (136, 143, "DTWIN Writes Estimate", "(Optimal Write Size units)");
+	PV (144, 151, "DTWIN Time Estimate", "(msec)");
+	return 0;
+}
+
+int nvmed_info_logs_plm_aggregate (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 res)
+{
+	__u64 n;
+	__u32 _v;
+	int i;
+
+	PV (0, 7, "Number of Entries", "");
+	n = U64(0);
+	for (i = 0; i < n && 8 + i * 2 + 1 < len; i++) {
+		PH2 (8 + i * 2);	P ("NVM Set with a pending event: %u\n", F(0,15));
+	}
+	return 0;
+}
+
 int nvmed_info_logs_namespace (NVMED *nvmed, int logid, int nsid, __u8 *p, int len, __u32 res)
 {
 	P("NAMESPACE\n");
@@ -3,10 +3,12 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <dirent.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <time.h>
 #include "nvme_hdr.h"
 #include "nvmed.h"
 #include "lib_nvmed.h"
@@ -16,6 +18,7 @@
 
 struct nvmed_info_cmd pci_cmds[] = {
 	{"nvme", 1, "NVMe Controller Registers", nvmed_info_pci_nvme},
+	{"cmb", 2, "Controller Memory Buffer Benchmark", nvmed_info_pci_cmb},
 	{"config", 1, "PCIe Config Registers", nvmed_info_pci_config},
 	{NULL, 0, NULL, NULL}
 };
@@ -56,27 +59,40 @@ int nvmed_info_pci_help (char *s)
 	return cmd_help(s, "PCIe Registers", pci_cmds);
 }
 
-int nvmed_info_pci_open (NVMED *nvmed, char *name, int type, struct pci_info *pci)
+// Returns the malloc()ed sysfs path of a PCI file of the device
+static char *pci_sysfs_path (NVMED *nvmed, char *name)
 {
 	char *sysfs_path;
 	char *p;
-	int rc;
-	struct stat st;
-
-	if (name == NULL || pci == NULL)
-		return -1;
 
 	// "admin" replaced with "sysfs/name"; +1 for '/', +1 for null
 	sysfs_path = (char *) malloc(strlen(nvmed->ns_path) + strlen(name) + 2);
+	if (sysfs_path == NULL)
+		return NULL;
 	strcpy (sysfs_path, nvmed->ns_path);
 	p = strstr(sysfs_path, "admin");
 	if (p == NULL) {
 		printf("Wrong path: %s\n", nvmed->ns_path);
-		goto abort;
+		free(sysfs_path);
+		return NULL;
 	}
 	strcpy(p, "sysfs/");
 	strcat(p, name);			
+	return sysfs_path;
+}
 
+static int pci_open (NVMED *nvmed, char *name, int type, struct pci_info *pci)
+{
+	char *sysfs_path;
+	int rc;
+	struct stat st;
+
+	if (name == NULL || pci == NULL)
+		return -1;
+
+	sysfs_path = pci_sysfs_path(nvmed, name);
+	if (sysfs_path == NULL)
+		return -1;
 
 	rc = stat(sysfs_path, &st);
 	if (rc < 0 || st.st_size <= 0) {
@@ -122,6 +138,16 @@ abort:
 	return -1;
 }
 
+int nvmed_info_pci_open (NVMED *nvmed, char *name, int type, struct pci_info *pci)
+{
+	int rc;
+
+	nvmed_info_prof_enter(PROF_SYSFS);
+	rc = pci_open(nvmed, name, type, pci);
+	nvmed_info_prof_leave();
+	return rc;
+}
+
 int nvmed_info_pci_close (struct pci_info *pci)
 {
 	if (pci == NULL)
@@ -168,6 +194,338 @@ int nvmed_info_pci_nvme (NVMED *nvmed, char **cmd_args)
 }
 
 
+// Controller Memory Buffer microbenchmark
+#define CMB_WINDOW_DEFAULT	(1 << 20)
+#define CMB_SQE_SIZE		64
+#define CMB_YN(v, bit)		((((v) >> (bit)) & 1)? "Yes" : "No")
+
+struct cmb_result {
+	double read_mbs, read_ns;
+	double write_mbs, write_ns;
+};
+
+static volatile __u64 cmb_sink;
+
+static __u64 cmb_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define CMB_READ(type, win, len) do { \
+		volatile type *q = (volatile type *) (win); \
+		size_t i, n = (len) / sizeof(type); \
+		type acc = 0; \
+		for (i = 0; i < n; i++) \
+			acc ^= q[i]; \
+		cmb_sink ^= acc; \
+	} while (0)
+
+#define CMB_WRITE(type, win, len, seed) do { \
+		volatile type *q = (volatile type *) (win); \
+		size_t i, n = (len) / sizeof(type); \
+		for (i = 0; i < n; i++) \
+			q[i] = (type) (i ^ (seed)); \
+	} while (0)
+
+// One pass over the window with the given access width; 64 copies whole
+// submission queue entries through a local buffer
+static void cmb_pass (__u8 *win, size_t len, int width, int write, __u64 seed)
+{
+	__u8 sqe[CMB_SQE_SIZE];
+	size_t off;
+
+	switch (width) {
+		case 1: if (write) CMB_WRITE(__u8, win, len, seed); else CMB_READ(__u8, win, len); break;
+		case 2: if (write) CMB_WRITE(__u16, win, len, seed); else CMB_READ(__u16, win, len); break;
+		case 4: if (write) CMB_WRITE(__u32, win, len, seed); else CMB_READ(__u32, win, len); break;
+		case 8: if (write) CMB_WRITE(__u64, win, len, seed); else CMB_READ(__u64, win, len); break;
+		default:
+			memset(sqe, (int) seed, sizeof(sqe));
+			for (off = 0; off + CMB_SQE_SIZE <= len; off += CMB_SQE_SIZE) {
+				if (write)
+					memcpy(win + off, sqe, CMB_SQE_SIZE);
+				else
+					memcpy(sqe, win + off, CMB_SQE_SIZE);
+			}
+			cmb_sink ^= sqe[0];
+			break;
+	}
+}
+
+static void cmb_measure (__u8 *win, size_t len, int width, int passes, int write, struct cmb_result *r)
+{
+	__u64 t0, ns;
+	int i;
+
+	t0 = cmb_now();
+	for (i = 0; i < passes; i++)
+		cmb_pass(win, len, width, write, i + 1);
+	if (write)
+		CMB_READ(__u32, win, sizeof(__u32));		// flush the posted writes
+	ns = cmb_now() - t0;
+	if (ns == 0)
+		ns = 1;
+	if (write) {
+		r->write_mbs = (double) len * passes / ns * 1000;
+		r->write_ns = (double) ns / ((double) len / width * passes);
+	} else {
+		r->read_mbs = (double) len * passes / ns * 1000;
+		r->read_ns = (double) ns / ((double) len / width * passes);
+	}
+}
+
+// Latency of writing one submission queue entry and reading it back, which
+// waits for the posted write to reach the controller
+static double cmb_sqe_latency (__u8 *win, size_t len, int count)
+{
+	__u8 sqe[CMB_SQE_SIZE];
+	__u64 t0;
+	int i;
+
+	memset(sqe, 0x5a, sizeof(sqe));
+	t0 = cmb_now();
+	for (i = 0; i < count; i++) {
+		memcpy(win + (i * CMB_SQE_SIZE) % len, sqe, CMB_SQE_SIZE);
+		cmb_sink ^= *(volatile __u32 *) (win + (i * CMB_SQE_SIZE) % len);
+	}
+	return (double) (cmb_now() - t0) / count;
+}
+
+// Maps len bytes at off of a sysfs resource file or of a stand-in file
+static __u8 *cmb_map (const char *path, __u64 off, size_t len, int *fd)
+{
+	void *m;
+
+	*fd = open(path, O_RDWR | O_SYNC);
+	if (*fd < 0) {
+		printf("open() failed for %s (%s)\n", path, strerror(errno));
+		return NULL;
+	}
+	m = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, off);
+	if (m == MAP_FAILED) {
+		printf("mmap() failed for %s at 0x%llx (%s)\n", path, (unsigned long long) off, strerror(errno));
+		close(*fd);
+		return NULL;
+	}
+	return (__u8 *) m;
+}
+
+// Returns why the CMB may hold live data, or NULL.  The nvme driver exposes
+// the "cmb" attribute once it maps the CMB, where it places submission queues
+// (use_cmb_sqes), and registers it as P2P memory ("p2pmem") for other devices.
+static const char *cmb_owner (NVMED *nvmed)
+{
+	static char reason[128];
+	struct dirent *d;
+	struct stat st;
+	char *path, *attr;
+	DIR *dir;
+
+	path = pci_sysfs_path(nvmed, "p2pmem");
+	if (path == NULL)
+		return "the sysfs path of the device is unknown";
+	if (stat(path, &st) == 0) {
+		free(path);
+		return "the CMB is registered as P2P memory (p2pmem)";
+	}
+	free(path);
+
+	path = pci_sysfs_path(nvmed, "nvme");
+	if (path == NULL)
+		return "the sysfs path of the device is unknown";
+	dir = opendir(path);
+	if (dir == NULL) {
+		free(path);
+		return NULL;
+	}
+	reason[0] = '\0';
+	while ((d = readdir(dir)) != NULL) {
+		if (strncmp(d->d_name, "nvme", 4))
+			continue;
+		attr = (char *) malloc(strlen(path) + strlen(d->d_name) + 6);
+		if (attr == NULL)
+			break;
+		sprintf(attr, "%s/%s/cmb", path, d->d_name);
+		if (stat(attr, &st) == 0)
+			snprintf(reason, sizeof(reason), "the nvme driver has mapped the CMB (%s/cmb)", d->d_name);
+		free(attr);
+		if (reason[0])
+			break;
+	}
+	closedir(dir);
+	free(path);
+	return reason[0]? reason : NULL;
+}
+
+// Usage: pci cmb [--size N] [--offset N] [--passes N] [--write] [--file PATH]
+// Maps the CMB through the resource<BIR> file and measures reads with 1, 2,
+// 4 and 8-byte accesses and 64-byte SQE copies.  Writes are only made with
+// --write; the window is saved first and restored afterwards.  --write is
+// refused while the driver or a P2P user holds the CMB, since the benchmark
+// and the restore would clobber live SQEs.  --file maps a regular file
+// standing in for the CMB instead.
+int nvmed_info_pci_cmb (NVMED *nvmed, char **cmd_args)
+{
+	static const int widths[] = { 1, 2, 4, 8, CMB_SQE_SIZE };
+	struct nvmed_info_regs regs;
+	struct cmb_result res[5];
+	struct pci_info pci;
+	struct stat st;
+	const char *owner;
+	char *path = NULL, name[16];
+	__u8 *win, *saved = NULL;
+	__u64 cmb_size, off;
+	size_t len;
+	long passes;
+	int i, fd, write, mismatch = 0, rc = 0;
+
+	for (i = 0; cmd_args && cmd_args[i]; i++)
+		if (!strcmp(cmd_args[i], "--file") && cmd_args[i + 1])
+			path = cmd_args[i + 1];
+	write = nvmed_info_opt_flag(cmd_args, "--write");
+	passes = nvmed_info_opt_long(cmd_args, "--passes", 4);
+	off = nvmed_info_opt_long(cmd_args, "--offset", 0);
+	if (passes < 1 || off % PAGE_SIZE) {
+		printf("--passes must be positive and --offset a multiple of %d\n", PAGE_SIZE);
+		return -1;
+	}
+
+	memset(&regs, 0, sizeof(regs));
+	if (path) {
+		if (stat(path, &st) < 0) {
+			printf("Cannot stat %s\n", path);
+			return -1;
+		}
+		cmb_size = st.st_size;
+		regs.cmbsz = 0x1f;				// a file stands in for every use
+	} else {
+		if (nvmed_info_pci_open(nvmed, "resource0", PCI_FILE_MMAP, &pci) < 0)
+			return -1;
+		nvmed_info_decode_regs((__u8 *) pci.regs, &regs);
+		nvmed_info_pci_close(&pci);
+		if (regs.cmbsz == 0 || regs.cmb_size == 0) {
+			P ("The controller has no Controller Memory Buffer (CMBSZ is 0)\n");
+			return 0;
+		}
+		cmb_size = regs.cmb_size;
+		if (write && (owner = cmb_owner(nvmed)) != NULL) {
+			printf("--write is refused: %s, and the writes would clobber\n"
+				"live submission queue entries; measure writes with --file instead\n", owner);
+			return -1;
+		}
+		snprintf(name, sizeof(name), "resource%d", regs.cmb_bir);
+		path = pci_sysfs_path(nvmed, name);
+		if (path == NULL)
+			return -1;
+	}
+
+	len = nvmed_info_opt_long(cmd_args, "--size", CMB_WINDOW_DEFAULT);
+	if (off >= cmb_size) {
+		printf("--offset is beyond the %llu-byte CMB\n", (unsigned long long) cmb_size);
+		rc = -1;
+		goto out;
+	}
+	if (len > cmb_size - off)
+		len = cmb_size - off;
+	len &= ~((size_t) CMB_SQE_SIZE - 1);
+	if (len == 0) {
+		printf("The window is smaller than %d bytes\n", CMB_SQE_SIZE);
+		rc = -1;
+		goto out;
+	}
+
+	win = cmb_map(path, regs.cmb_offset + off, len, &fd);
+	if (win == NULL) {
+		rc = -1;
+		goto out;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("Controller Memory Buffer (%s)\n", path);
+	if (regs.cmbloc || regs.cmb_size) {
+		P ("%-36s  BAR %u (resource%u), offset 0x%llx\n", "Location (CMBLOC)", regs.cmb_bir, regs.cmb_bir,
+			(unsigned long long) regs.cmb_offset);
+		P ("%-36s  %llu bytes\n", "Size (CMBSZ)", (unsigned long long) regs.cmb_size);
+		P ("%-36s  SQS %s, CQS %s, LISTS %s, RDS %s, WDS %s\n", "Supported Uses", CMB_YN(regs.cmbsz, 0),
+			CMB_YN(regs.cmbsz, 1), CMB_YN(regs.cmbsz, 2), CMB_YN(regs.cmbsz, 3), CMB_YN(regs.cmbsz, 4));
+	} else
+		P ("%-36s  %llu bytes (regular file standing in for the CMB)\n", "Size", (unsigned long long) cmb_size);
+	P ("%-36s  %zu bytes at CMB offset 0x%llx, %ld pass%s\n", "Window", len, (unsigned long long) off,
+		passes, (passes == 1)? "" : "es");
+
+	if (write) {
+		saved = (__u8 *) malloc(len);
+		if (saved == NULL) {
+			printf("Memory allocation failed.\n");
+			rc = -1;
+			goto unmap;
+		}
+		for (i = 0; i < (int) (len / 8); i++)
+			((__u64 *) saved)[i] = ((volatile __u64 *) win)[i];
+	}
+
+	memset(res, 0, sizeof(res));
+	for (i = 0; i < 5; i++) {
+		cmb_measure(win, len, widths[i], passes, 0, &res[i]);
+		if (write)
+			cmb_measure(win, len, widths[i], passes, 1, &res[i]);
+	}
+
+	if (write) {
+		// The last pass wrote SQE-sized copies of its pass number
+		for (i = 0; i < (int) len; i++)
+			if (((volatile __u8 *) win)[i] != (__u8) passes)
+				mismatch++;
+		P ("%-36s  %.0f ns\n", "SQE write + read-back latency", cmb_sqe_latency(win, len, 10000));
+		for (i = 0; i < (int) (len / 8); i++)
+			((volatile __u64 *) win)[i] = ((__u64 *) saved)[i];
+		for (i = 0; i < (int) (len / 8); i++)
+			if (((volatile __u64 *) win)[i] != ((__u64 *) saved)[i])
+				break;
+		P ("%-36s  %s\n", "Window restored", (i == (int) (len / 8))? "Yes" : "No, the contents differ");
+	}
+
+	P ("\nWidth     Read MB/s  Read ns/access  Write MB/s  Write ns/access\n");
+	P ("--------  ---------  --------------  ----------  ---------------\n");
+	for (i = 0; i < 5; i++) {
+		P ("%2d %-5s  %9.1f  %14.1f", widths[i], (widths[i] == CMB_SQE_SIZE)? "(SQE)" : "", res[i].read_mbs,
+			res[i].read_ns);
+		if (write)
+			P ("  %10.1f  %15.1f\n", res[i].write_mbs, res[i].write_ns);
+		else
+			P ("  %10s  %15s\n", "-", "-");
+	}
+
+	P ("\n[Notes]\n");
+	if (!write)
+		P ("  - Writes were skipped; --write measures them and restores the window afterwards.\n");
+	else if (regs.cmbloc || regs.cmb_size)
+		P ("  - Writes ran because sysfs shows neither the nvme driver nor a P2P user holding the CMB.\n");
+	else
+		P ("  - A regular file stood in for the CMB; the numbers are those of host memory.\n");
+	if (mismatch)
+		P ("  - %d bytes did not read back as written; the CMB may not accept host writes.\n", mismatch);
+	if (write && res[4].write_ns < res[4].read_ns)
+		P ("  - 64-byte SQE writes take %.1fx less time than reads; SQs in the CMB pay off when\n"
+		   "    the host never reads them back.\n", res[4].read_ns / res[4].write_ns);
+	if (!(regs.cmbsz & 0x1))
+		P ("  - The controller does not support submission queues in the CMB (SQS).\n");
+	P ("\n\n");
+
+unmap:
+	free(saved);
+	munmap(win, len);
+	close(fd);
+out:
+	if (regs.cmb_size)
+		free(path);
+	return rc;
+}
+
+
 void nvmed_info_pci_parse_config (NVMED *nvmed, struct pci_info *pci)
 {
 	__u8 *p;
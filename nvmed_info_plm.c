@@ -0,0 +1,469 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd plm_cmds[] = {
+	{"status", 1, "NVM Sets and their Predictable Latency Mode state", nvmed_info_plm_status},
+	{"monitor", 1, "Deterministic / non-deterministic window monitor", nvmed_info_plm_monitor},
+	{"enable", 1, "Enable Predictable Latency Mode on an NVM Set", nvmed_info_plm_enable},
+	{"disable", 1, "Disable Predictable Latency Mode on an NVM Set", nvmed_info_plm_disable},
+	{"window", 1, "Request the deterministic or non-deterministic window", nvmed_info_plm_window},
+	{NULL, 0, NULL, NULL}
+};
+
+// Controller Attributes (CTRATT), NVMe 1.4
+#define CTRATT_NVM_SETS		(1 << 2)
+#define CTRATT_PLM			(1 << 5)
+
+// Predictable Latency Mode Window, Window Select (WS)
+#define PLM_DTWIN			1
+#define PLM_NDWIN			2
+
+// NVM Set List (Identify CNS 04h): 127 bytes of header, 128 bytes per entry
+#define PLM_MAX_SETS		31
+#define PLM_SET_ENTRY		128
+
+struct plm_set {
+	int setid;
+	int endgid;
+	__u32 rr4kt;						// Random 4 KiB Read Typical (100 nsec)
+	__u32 ows;							// Optimal Write Size (bytes)
+	__u64 tnvmsetcap;					// bytes, lower 64 bits
+	__u64 unvmsetcap;					// bytes, lower 64 bits
+};
+
+struct plm_state {
+	int lpe;							// Predictable Latency Enable
+	int ws;								// Window Select from the feature
+	int status;							// window from the log page
+	__u16 events;
+	__u64 dtwin_rt, dtwin_wt, dtwin_tmax;
+	__u64 ndwin_tminh, ndwin_tminl;
+	__u64 dtwin_re, dtwin_we, dtwin_te;
+};
+
+static volatile sig_atomic_t plm_stop;
+
+static void plm_signal (int sig)
+{
+	plm_stop = 1;
+}
+
+static const char *plm_window_name (int w)
+{
+	return (w == PLM_DTWIN)? "DTWIN" : (w == PLM_NDWIN)? "NDWIN" : "-";
+}
+
+static __u64 plm_now_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Both PLM features take the NVM Set ID in CDW11 and their value in CDW12
+static int plm_set_feature (int fid, int setid, __u32 cdw12, int save, void *buf, int len)
+{
+	struct nvme_admin_cmd cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = nvme_admin_set_features;
+	if (buf) {
+		cmd.addr = (__u64) htole64((unsigned long) buf);
+		cmd.data_len = htole32(len);
+	}
+	cmd.cdw10 = htole32((save? FEATURE_SAVE : 0) | fid);
+	cmd.cdw11 = htole32(setid);
+	cmd.cdw12 = htole32(cdw12);
+	return nvmed_info_ctx_admin(dev_info, &cmd);
+}
+
+static int plm_check (struct nvmed_info_controller *ctrl)
+{
+	int rc;
+
+	rc = nvmed_info_read_controller(dev_info, ctrl);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+	if (!(ctrl->ctratt & CTRATT_PLM)) {
+		printf("The controller does not support Predictable Latency Mode (CTRATT bit 5)\n");
+		return -1;
+	}
+	return 0;
+}
+
+// Returns the number of NVM Sets, or -1
+static int plm_read_sets (struct plm_set *sets)
+{
+	__u8 *p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	__u8 *e;
+	int i, n, rc;
+
+	if (p == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+	memset(p, 0, PAGE_SIZE);
+	rc = nvmed_info_ctx_identify(dev_info, CNS_NVM_SET_LIST, 0, p);
+	if (rc) {
+		printf("IDENTIFY NVM Set List failed (%d)\n", rc);
+		return -1;
+	}
+
+	n = (p[0] > PLM_MAX_SETS)? PLM_MAX_SETS : p[0];
+	for (i = 0; i < n; i++) {
+		e = p + PLM_SET_ENTRY * (i + 1);
+		sets[i].setid = *(__u16 *) &e[0];
+		sets[i].endgid = *(__u16 *) &e[2];
+		sets[i].rr4kt = *(__u32 *) &e[8];
+		sets[i].ows = *(__u32 *) &e[12];
+		sets[i].tnvmsetcap = *(__u64 *) &e[16];
+		sets[i].unvmsetcap = *(__u64 *) &e[32];
+	}
+	return n;
+}
+
+// Reads the log page alone when full is 0, as the monitor does
+static int plm_read_state (int setid, struct plm_state *s, int full)
+{
+	__u8 *p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	__u32 res;
+	int rc;
+
+	if (p == NULL)
+		return -1;
+	if (full) {
+		memset(s, 0, sizeof(*s));
+		rc = nvmed_info_ctx_get_feature(dev_info, FEATURE_PLM_WINDOW, FEATURE_SEL_CURRENT, 0,
+				setid, NULL, 0, &res);
+		if (rc)
+			return rc;
+		s->ws = res & 0x7;
+		rc = nvmed_info_ctx_get_feature(dev_info, FEATURE_PLM_CONFIG, FEATURE_SEL_CURRENT, 0,
+				setid, p, 512, &res);
+		if (rc)
+			return rc;
+		s->lpe = res & 0x1;
+	}
+
+	memset(p, 0, 512);
+	rc = nvmed_info_ctx_get_log_ext(dev_info, LOG_PLM_PER_NVM_SET, setid, 0, p, 512);
+	if (rc)
+		return rc;
+	s->status = p[0] & 0x7;
+	s->events = U16(2);
+	s->dtwin_rt = U64(32);
+	s->dtwin_wt = U64(40);
+	s->dtwin_tmax = U64(48);
+	s->ndwin_tminh = U64(56);
+	s->ndwin_tminl = U64(64);
+	s->dtwin_re = U64(128);
+	s->dtwin_we = U64(136);
+	s->dtwin_te = U64(144);
+	return 0;
+}
+
+static int plm_setid (char **cmd_args)
+{
+	int setid = (cmd_args && cmd_args[0])? atoi(cmd_args[0]) : 0;
+
+	if (setid <= 0 || setid > 0xffff) {
+		printf("Give an NVM Set ID between 1 and 65535\n");
+		return -1;
+	}
+	return setid;
+}
+
+int nvmed_info_plm (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	if (cmd_args[0] == NULL)
+		return nvmed_info_plm_status(nvmed, NULL);
+
+	c = cmd_lookup(plm_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_plm_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_plm_help (char *s)
+{
+	return cmd_help(s, "PLM subcommands", plm_cmds);
+}
+
+// Usage: plm status
+int nvmed_info_plm_status (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct plm_set sets[PLM_MAX_SETS];
+	struct plm_state states[PLM_MAX_SETS], *s;
+	int i, n, rc[PLM_MAX_SETS];
+
+	if (plm_check(&ctrl) < 0)
+		return -1;
+	n = plm_read_sets(sets);
+	if (n < 0)
+		return -1;
+
+	PRINT_NVMED_INFO;
+	P ("Predictable Latency Mode (%s)\n", nvmed_info_ctx_path(dev_info));
+	P ("NVM Sets (CTRATT bit 2): %s, NVM Set Identifier Maximum (NSETIDMAX): %u\n\n",
+		(ctrl.ctratt & CTRATT_NVM_SETS)? "Yes" : "No", ctrl.nsetidmax);
+	P ("NVM Set  Endurance Group  Random 4K Read  Optimal Write  Capacity (GB)  Unallocated  PLM  Window\n");
+	P ("-------  ---------------  --------------  -------------  -------------  -----------  ---  ------\n");
+	for (i = 0; i < n; i++) {
+		s = &states[i];
+		rc[i] = plm_read_state(sets[i].setid, s, 1);
+		P ("%7d  %15d  %9.1f usec  %13u  %13.1f  %11.1f  %-3s  %s\n", sets[i].setid, sets[i].endgid,
+			sets[i].rr4kt / 10.0, sets[i].ows, sets[i].tnvmsetcap / 1e9, sets[i].unvmsetcap / 1e9,
+			rc[i]? "N/A" : s->lpe? "On" : "Off", rc[i]? "-" : plm_window_name(s->status));
+	}
+
+	for (i = 0; i < n; i++) {
+		s = &states[i];
+		if (rc[i] || !s->lpe)
+			continue;
+		P ("\n[NVM Set %d]\n", sets[i].setid);
+		P ("%-40s  %s (requested %s)\n", "Current window", plm_window_name(s->status), plm_window_name(s->ws));
+		P ("%-40s  %llu reads / %llu writes / %llu msec\n", "DTWIN typical (reads, writes, time max)",
+			(unsigned long long) s->dtwin_rt, (unsigned long long) s->dtwin_wt,
+			(unsigned long long) s->dtwin_tmax);
+		P ("%-40s  %llu reads / %llu writes / %llu msec\n", "DTWIN remaining estimate",
+			(unsigned long long) s->dtwin_re, (unsigned long long) s->dtwin_we,
+			(unsigned long long) s->dtwin_te);
+		P ("%-40s  %llu / %llu msec\n", "NDWIN time minimum (high / low)",
+			(unsigned long long) s->ndwin_tminh, (unsigned long long) s->ndwin_tminl);
+		if (s->events)
+			P ("%-40s  0x%04x%s%s%s%s%s\n", "Pending events", s->events,
+				(s->events & 0x1)? " reads-warning" : "", (s->events & 0x2)? " writes-warning" : "",
+				(s->events & 0x4)? " time-warning" : "", (s->events & 0x4000)? " exceeded" : "",
+				(s->events & 0x8000)? " excursion" : "");
+	}
+	P ("\n\n");
+	return 0;
+}
+
+// Usage: plm monitor [--set N] [--interval-ms N] [--count N]
+// Polls the Predictable Latency Per NVM Set log of every set with PLM
+// enabled (or of the one given) and reports window transitions and how
+// long each set stayed deterministic.
+int nvmed_info_plm_monitor (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct plm_set sets[PLM_MAX_SETS];
+	struct plm_state s;
+	struct {
+		int setid;
+		int window;
+		__u64 since;
+		__u64 ms[3];					// time in none / DTWIN / NDWIN
+		__u64 longest_dtwin;
+		int transitions, autonomous;
+	} m[PLM_MAX_SETS];
+	__u64 start, now, elapsed, d;
+	long interval, count, samples = 0;
+	int i, n, nm = 0, only;
+
+	if (plm_check(&ctrl) < 0)
+		return -1;
+	only = nvmed_info_opt_long(cmd_args, "--set", 0);
+	interval = nvmed_info_opt_long(cmd_args, "--interval-ms", 1000);
+	count = nvmed_info_opt_long(cmd_args, "--count", 0);
+	if (interval <= 0) {
+		printf("--interval-ms must be positive\n");
+		return -1;
+	}
+	n = plm_read_sets(sets);
+	if (n < 0)
+		return -1;
+
+	memset(m, 0, sizeof(m));
+	start = plm_now_ms();
+	for (i = 0; i < n; i++) {
+		if (only && sets[i].setid != only)
+			continue;
+		if (plm_read_state(sets[i].setid, &s, 1) || (!only && !s.lpe))
+			continue;
+		m[nm].setid = sets[i].setid;
+		m[nm].window = s.status;
+		m[nm].since = start;
+		nm++;
+	}
+	if (nm == 0) {
+		if (only)
+			printf("NVM Set %d not found\n", only);
+		else
+			printf("No NVM Set has Predictable Latency Mode enabled\n");
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("Monitoring %d NVM Set%s every %ld msec\n\n", nm, (nm == 1)? "" : "s", interval);
+	P ("    Time  NVM Set  Window  In Window  Reads Left  Writes Left  Time Left  Events\n");
+	P ("--------  -------  ------  ---------  ----------  -----------  ---------  ------\n");
+	fflush(stdout);
+
+	plm_stop = 0;
+	signal(SIGINT, plm_signal);
+	signal(SIGTERM, plm_signal);
+	while (!plm_stop && (count == 0 || samples < count)) {
+		for (i = 0; i < nm; i++) {
+			if (plm_read_state(m[i].setid, &s, 0))
+				continue;
+			now = plm_now_ms();
+			if (s.status != m[i].window) {
+				d = now - m[i].since;
+				m[i].ms[(m[i].window <= 2)? m[i].window : 0] += d;
+				if (m[i].window == PLM_DTWIN && d > m[i].longest_dtwin)
+					m[i].longest_dtwin = d;
+				m[i].transitions++;
+				if (s.events & 0xc000)
+					m[i].autonomous++;
+				m[i].window = s.status;
+				m[i].since = now;
+			}
+			P ("%8.1f  %7d  %-6s  %7.1f s  %10llu  %11llu  %6llu ms  0x%04x%s\n",
+				(now - start) / 1000.0, m[i].setid, plm_window_name(s.status),
+				(now - m[i].since) / 1000.0, (unsigned long long) s.dtwin_re,
+				(unsigned long long) s.dtwin_we, (unsigned long long) s.dtwin_te, s.events,
+				(m[i].since == now && samples)? "  <- transition" : "");
+		}
+		fflush(stdout);
+		if (++samples == count)
+			break;
+		usleep(interval * 1000);
+	}
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	now = plm_now_ms();
+	elapsed = now - start;
+	P ("\nNVM Set  DTWIN (s)      %%  NDWIN (s)      %%  Transitions  Autonomous  Longest DTWIN (s)\n");
+	P ("-------  ---------  -----  ---------  -----  -----------  ----------  -----------------\n");
+	for (i = 0; i < nm; i++) {
+		d = now - m[i].since;
+		m[i].ms[(m[i].window <= 2)? m[i].window : 0] += d;
+		if (m[i].window == PLM_DTWIN && d > m[i].longest_dtwin)
+			m[i].longest_dtwin = d;
+		P ("%7d  %9.1f  %4.1f%%  %9.1f  %4.1f%%  %11d  %10d  %17.1f\n", m[i].setid,
+			m[i].ms[PLM_DTWIN] / 1000.0, elapsed? 100.0 * m[i].ms[PLM_DTWIN] / elapsed : 0,
+			m[i].ms[PLM_NDWIN] / 1000.0, elapsed? 100.0 * m[i].ms[PLM_NDWIN] / elapsed : 0,
+			m[i].transitions, m[i].autonomous, m[i].longest_dtwin / 1000.0);
+	}
+	P ("\n\n");
+	return 0;
+}
+
+// Usage: plm enable <set> [--reads N] [--writes N] [--time-ms N] [--save]
+// Thresholds left out keep their warning events disabled; the autonomous
+// transition events are always enabled.
+int nvmed_info_plm_enable (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	__u8 *p;
+	__u16 ee = 0xc000;
+	__u64 reads, writes, time;
+	int setid, rc;
+
+	if (plm_check(&ctrl) < 0 || (setid = plm_setid(cmd_args)) < 0)
+		return -1;
+	p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	if (p == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+
+	reads = nvmed_info_opt_long(cmd_args, "--reads", 0);
+	writes = nvmed_info_opt_long(cmd_args, "--writes", 0);
+	time = nvmed_info_opt_long(cmd_args, "--time-ms", 0);
+	memset(p, 0, 512);
+	if (reads)
+		ee |= 0x1;
+	if (writes)
+		ee |= 0x2;
+	if (time)
+		ee |= 0x4;
+	memcpy(&p[0], &ee, 2);
+	memcpy(&p[32], &reads, 8);
+	memcpy(&p[40], &writes, 8);
+	memcpy(&p[48], &time, 8);
+
+	rc = plm_set_feature(FEATURE_PLM_CONFIG, setid, 1, nvmed_info_opt_flag(cmd_args, "--save"), p, 512);
+	if (rc) {
+		printf("SET FEATURES Predictable Latency Mode Config failed (%d)\n", rc);
+		return -1;
+	}
+	P ("Predictable Latency Mode enabled on NVM Set %d (Enable Event 0x%04x)\n", setid, ee);
+	return 0;
+}
+
+// Usage: plm disable <set> [--save]
+int nvmed_info_plm_disable (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	__u8 *p;
+	int setid, rc;
+
+	if (plm_check(&ctrl) < 0 || (setid = plm_setid(cmd_args)) < 0)
+		return -1;
+	p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	if (p == NULL) {
+		printf("Memory allocation failed.\n");
+		return -1;
+	}
+
+	memset(p, 0, 512);
+	rc = plm_set_feature(FEATURE_PLM_CONFIG, setid, 0, nvmed_info_opt_flag(cmd_args, "--save"), p, 512);
+	if (rc) {
+		printf("SET FEATURES Predictable Latency Mode Config failed (%d)\n", rc);
+		return -1;
+	}
+	P ("Predictable Latency Mode disabled on NVM Set %d\n", setid);
+	return 0;
+}
+
+// Usage: plm window <set> dtwin|ndwin
+// The controller refuses DTWIN until the set has spent NDWIN Time Minimum
+// in the non-deterministic window.
+int nvmed_info_plm_window (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct plm_state s;
+	int setid, ws, rc;
+
+	if (plm_check(&ctrl) < 0 || (setid = plm_setid(cmd_args)) < 0)
+		return -1;
+	if (cmd_args[1] && !strcmp(cmd_args[1], "dtwin"))
+		ws = PLM_DTWIN;
+	else if (cmd_args[1] && !strcmp(cmd_args[1], "ndwin"))
+		ws = PLM_NDWIN;
+	else {
+		printf("Give the window to request: dtwin or ndwin\n");
+		return -1;
+	}
+
+	rc = plm_set_feature(FEATURE_PLM_WINDOW, setid, ws, 0, NULL, 0);
+	if (rc) {
+		printf("SET FEATURES Predictable Latency Mode Window failed (%d)%s\n", rc,
+			(ws == PLM_DTWIN)? "; the set may not have spent NDWIN Time Minimum yet" : "");
+		return -1;
+	}
+	if (plm_read_state(setid, &s, 1) == 0)
+		P ("NVM Set %d: %s requested, now in %s\n", setid, plm_window_name(ws), plm_window_name(s.status));
+	return 0;
+}
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+#define PROBE_QD_MAX		64
+#define PROBE_RANGE_DEFAULT	(1ULL << 30)		// bytes read from when no --lba-count is given
+
+// HDR-style histogram of nanoseconds: values below 2^SUB_BITS are exact, and
+// every power of two above is split into 2^(SUB_BITS-1) linear buckets, so a
+// bucket is never wider than 1/64 of its value
+#define PROBE_SUB_BITS		7
+#define PROBE_SUB			(1 << PROBE_SUB_BITS)
+#define PROBE_HALF			(PROBE_SUB / 2)
+#define PROBE_BUCKETS		(PROBE_SUB + 57 * PROBE_HALF)
+
+struct probe_worker {
+	int id;
+	void *buf;
+	NVMED_QUEUE *queue;
+	NVMED_HANDLE *handle;
+	int fd;
+	__u64 seed;
+	__u64 next;							// sequential offset
+	__u64 ios, errors, min, max, sum;
+	__u64 hist[PROBE_BUCKETS];
+	pthread_t tid;
+};
+
+// Where the reads go: NVMeDirect user-level queues, or pread() on a file
+// standing in for the namespace
+struct probe_backend {
+	const char *name;
+	int (*open) (struct probe_worker *w);
+	ssize_t (*read) (struct probe_worker *w, size_t len, off_t off);
+	void (*close) (struct probe_worker *w);
+};
+
+static struct {
+	struct probe_backend *be;
+	NVMED *nvmed;
+	const char *path;
+	__u64 start, range;					// bytes
+	__u32 bs;
+	int qd;
+	int seq;
+	long count;
+	__u64 deadline;
+	volatile long issued;
+	struct probe_worker w[PROBE_QD_MAX];
+} probe;
+
+static __u64 probe_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int probe_bucket (__u64 v)
+{
+	int shift;
+
+	if (v < PROBE_SUB)
+		return v;
+	shift = 63 - __builtin_clzll(v) - (PROBE_SUB_BITS - 1);
+	return PROBE_SUB + (shift - 1) * PROBE_HALF + (int) (v >> shift) - PROBE_HALF;
+}
+
+// Lowest value counted in a bucket
+static __u64 probe_bucket_value (int b)
+{
+	int shift;
+
+	if (b < PROBE_SUB)
+		return b;
+	shift = (b - PROBE_SUB) / PROBE_HALF + 1;
+	return (__u64) ((b - PROBE_SUB) % PROBE_HALF + PROBE_HALF) << shift;
+}
+
+static __u64 probe_percentile (__u64 *hist, __u64 total, double pct)
+{
+	__u64 want = (__u64) (pct / 100 * total + 0.5), n = 0;
+	int b;
+
+	if (want == 0)
+		want = 1;
+	for (b = 0; b < PROBE_BUCKETS; b++) {
+		n += hist[b];
+		if (n >= want)
+			return (probe_bucket_value(b) + ((b + 1 < PROBE_BUCKETS)? probe_bucket_value(b + 1) : 0)) / 2;
+	}
+	return 0;
+}
+
+static int probe_nvmed_open (struct probe_worker *w)
+{
+	w->queue = nvmed_queue_create(probe.nvmed, 0);
+	if (w->queue == NULL)
+		return -1;
+	w->handle = nvmed_handle_create(w->queue, HANDLE_DIRECT_IO | HANDLE_SYNC_IO);
+	if (w->handle == NULL)
+		return -1;
+	w->buf = nvmed_get_buffer(probe.nvmed, (probe.bs + PAGE_SIZE - 1) / PAGE_SIZE);
+	return w->buf? 0 : -1;
+}
+
+static ssize_t probe_nvmed_read (struct probe_worker *w, size_t len, off_t off)
+{
+	return nvmed_pread(w->handle, w->buf, len, off);
+}
+
+static void probe_nvmed_close (struct probe_worker *w)
+{
+	if (w->buf)
+		nvmed_put_buffer(w->buf);
+	if (w->handle)
+		nvmed_handle_destroy(w->handle);
+	if (w->queue)
+		nvmed_queue_destroy(w->queue);
+	w->buf = NULL;
+	w->handle = NULL;
+	w->queue = NULL;
+}
+
+static int probe_mock_open (struct probe_worker *w)
+{
+	w->fd = open(probe.path, O_RDONLY);
+	if (w->fd < 0)
+		return -1;
+	w->buf = aligned_alloc(PAGE_SIZE, (probe.bs + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+	return w->buf? 0 : -1;
+}
+
+static ssize_t probe_mock_read (struct probe_worker *w, size_t len, off_t off)
+{
+	return pread(w->fd, w->buf, len, off);
+}
+
+static void probe_mock_close (struct probe_worker *w)
+{
+	free(w->buf);
+	if (w->fd >= 0)
+		close(w->fd);
+	w->buf = NULL;
+	w->fd = -1;
+}
+
+static struct probe_backend probe_backends[] = {
+	{"nvmed", probe_nvmed_open, probe_nvmed_read, probe_nvmed_close},
+	{"mock", probe_mock_open, probe_mock_read, probe_mock_close},
+};
+
+static __u64 probe_offset (struct probe_worker *w)
+{
+	__u64 blocks = probe.range / probe.bs, off;
+
+	if (probe.seq) {
+		off = w->next;
+		w->next = (w->next + (__u64) probe.qd * probe.bs) % (blocks * probe.bs);
+	} else {
+		// xorshift64
+		w->seed ^= w->seed << 13;
+		w->seed ^= w->seed >> 7;
+		w->seed ^= w->seed << 17;
+		off = (w->seed % blocks) * probe.bs;
+	}
+	return probe.start + off;
+}
+
+// Each worker keeps one read outstanding on its own queue, so QD workers
+// keep QD reads in flight
+static void *probe_thread (void *arg)
+{
+	struct probe_worker *w = (struct probe_worker *) arg;
+	__u64 t0, ns;
+	off_t off;
+
+	while (__sync_fetch_and_add(&probe.issued, 1) < probe.count) {
+		off = probe_offset(w);
+		t0 = probe_now();
+		if (probe.be->read(w, probe.bs, off) != (ssize_t) probe.bs) {
+			w->errors++;
+			// A failing device fails fast; --seconds must still end the run
+			if (probe.deadline && probe_now() >= probe.deadline)
+				break;
+			continue;
+		}
+		ns = probe_now() - t0;
+		w->ios++;
+		w->sum += ns;
+		if (w->min == 0 || ns < w->min)
+			w->min = ns;
+		if (ns > w->max)
+			w->max = ns;
+		w->hist[probe_bucket(ns)]++;
+		if (probe.deadline && t0 + ns >= probe.deadline)
+			break;
+	}
+	return NULL;
+}
+
+static void probe_print_settings (void)
+{
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_features feat;
+
+	if (nvmed_info_read_controller(dev_info, &ctrl) == 0)
+		P ("%-36s  %s (%s)\n", "Model (Firmware)", ctrl.mn, ctrl.fr);
+	if (nvmed_info_read_features(dev_info, &feat))
+		return;
+	if (feat.valid & (1U << FEATURE_POWER_MANAGEMENT))
+		P ("%-36s  %u\n", "Power State (PS)", feat.power_mgmt.ps);
+	if (feat.valid & (1U << FEATURE_AUTO_POWER_STATE_TRANSITION))
+		P ("%-36s  %s\n", "APST Enabled (APSTE)", feat.apst.apste? "Yes" : "No");
+	if (feat.valid & (1U << FEATURE_ARBITRATION)) {
+		P ("%-36s  ", "Arbitration Burst (AB)");
+		if (feat.arbitration.ab == 7)
+			P ("No limit\n");
+		else
+			P ("%u\n", 1 << feat.arbitration.ab);
+	}
+	if (feat.valid & (1U << FEATURE_INTERRUPT_COALESCING))
+		P ("%-36s  THR %u, TIME %u usec\n", "Interrupt Coalescing", feat.coalescing.thr + 1,
+			feat.coalescing.time * 100);
+	if (feat.valid & (1U << FEATURE_VOLATILE_WRITE_CACHE))
+		P ("%-36s  %s\n", "Volatile Write Cache (WCE)", feat.wce? "Enabled" : "Disabled");
+}
+
+static void probe_print_histogram (__u64 *hist, __u64 total)
+{
+	__u64 n, lo, hi;
+	int b, i, k;
+
+	P ("\n[Histogram]\n");
+	P ("      From (us)        To (us)       Count  Share\n");
+	for (lo = 0, hi = 1000, b = 0; b < PROBE_BUCKETS && hi > lo; lo = hi, hi <<= 1) {
+		for (n = 0; b < PROBE_BUCKETS && probe_bucket_value(b) < hi; b++)
+			n += hist[b];
+		if (n == 0)
+			continue;
+		P ("%15.1f  %13.1f  %10llu  %5.1f%%  ", lo / 1000.0, hi / 1000.0, (unsigned long long) n,
+			100.0 * n / total);
+		k = (int) (40.0 * n / total + 0.5);
+		for (i = 0; i < k; i++)
+			P ("#");
+		P ("\n");
+	}
+}
+
+// Usage: probe [--qd N] [--bs N] [--seq] [--lba-start N] [--lba-count N]
+//              [--count N] [--seconds N] [--histogram] [--mock [--lba-size N]]
+// Reads through NVMeDirect user-level queues, one per outstanding read, and
+// reports IOPS and latency percentiles.  Nothing is written.  With --mock,
+// the device path is a file read with pread() instead.
+int nvmed_info_probe (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_namespace ns;
+	struct probe_worker *w;
+	struct stat st;
+	__u64 *hist, total = 0, errors = 0, sum = 0, min = 0, max = 0, t0, elapsed;
+	__u64 nblocks, lba_start, lba_count;
+	long seconds, bs;
+	__u32 lba_size;
+	int i, started = 0, rc = 0, mock;
+
+	mock = nvmed_info_opt_flag(cmd_args, "--mock");
+	memset(&probe, 0, sizeof(probe));
+	probe.be = &probe_backends[mock? 1 : 0];
+	probe.path = nvmed_info_ctx_path(dev_info);
+	probe.qd = nvmed_info_opt_long(cmd_args, "--qd", 1);
+	bs = nvmed_info_opt_long(cmd_args, "--bs", 4096);
+	probe.seq = nvmed_info_opt_flag(cmd_args, "--seq");
+	probe.count = nvmed_info_opt_long(cmd_args, "--count", 10000);
+	seconds = nvmed_info_opt_long(cmd_args, "--seconds", 0);
+	if (probe.qd < 1 || probe.qd > PROBE_QD_MAX || probe.count < 1 || seconds < 0 ||
+			bs <= 0 || bs > 0x7fffffffL) {
+		printf("--qd must be between 1 and %d, --bs and --count positive\n", PROBE_QD_MAX);
+		return -1;
+	}
+	probe.bs = (__u32) bs;
+	if (seconds && !nvmed_info_opt_long(cmd_args, "--count", 0))
+		probe.count = 0x7fffffffL;
+
+	// The namespace geometry comes from IDENTIFY, or from the size of the mock file
+	if (mock) {
+		lba_size = nvmed_info_opt_long(cmd_args, "--lba-size", 512);
+		if (lba_size < 512 || (lba_size & (lba_size - 1)) || stat(probe.path, &st) < 0) {
+			printf("Cannot use \"%s\" as a mock namespace with %u-byte blocks\n", probe.path, lba_size);
+			return -1;
+		}
+		nblocks = st.st_size / lba_size;
+	} else {
+		probe.nvmed = nvmed_info_ctx_nvmed(dev_info);
+		if (probe.nvmed == NULL || nvmed_info_read_namespace(dev_info, probe.nvmed->nsid, &ns)) {
+			printf("Cannot read the namespace of \"%s\"\n", probe.path);
+			return -1;
+		}
+		lba_size = 1U << ns.lbaf[ns.flbas & 0xf].lbads;
+		nblocks = ns.nsze;
+	}
+	if (probe.bs < lba_size || probe.bs % lba_size) {
+		printf("--bs must be a multiple of the %u-byte block size\n", lba_size);
+		return -1;
+	}
+
+	lba_start = nvmed_info_opt_long(cmd_args, "--lba-start", 0);
+	lba_count = nvmed_info_opt_long(cmd_args, "--lba-count", PROBE_RANGE_DEFAULT / lba_size);
+	if (lba_start >= nblocks) {
+		printf("--lba-start is beyond the last block (%llu)\n", (unsigned long long) nblocks - 1);
+		return -1;
+	}
+	if (lba_count > nblocks - lba_start)
+		lba_count = nblocks - lba_start;
+	probe.start = lba_start * lba_size;
+	probe.range = lba_count * lba_size;
+	if (probe.range < probe.bs) {
+		printf("The LBA range is smaller than one %u-byte read\n", probe.bs);
+		return -1;
+	}
+
+	for (i = 0; i < probe.qd; i++) {
+		w = &probe.w[i];
+		w->id = i;
+		w->fd = -1;
+		w->seed = 0x9e3779b97f4a7c15ULL * (i + 1) ^ probe_now();
+		w->next = (__u64) i * probe.bs % (probe.range / probe.bs * probe.bs);
+		if (probe.be->open(w) < 0) {
+			printf("Cannot set up %s queue %d of %d (%s)\n", probe.be->name, i + 1, probe.qd, strerror(errno));
+			probe.be->close(w);
+			rc = -1;
+			goto out;
+		}
+		started = i + 1;
+	}
+
+	t0 = probe_now();
+	probe.deadline = seconds? t0 + seconds * 1000000000ULL : 0;
+	for (i = 0; i < probe.qd; i++) {
+		if (pthread_create(&probe.w[i].tid, NULL, probe_thread, &probe.w[i])) {
+			printf("Cannot start worker %d\n", i);
+			probe.count = 0;
+			break;
+		}
+	}
+	while (--i >= 0)
+		pthread_join(probe.w[i].tid, NULL);
+	elapsed = probe_now() - t0;
+
+	hist = probe.w[0].hist;
+	for (i = 0; i < probe.qd; i++) {
+		w = &probe.w[i];
+		total += w->ios;
+		errors += w->errors;
+		sum += w->sum;
+		if (w->ios && (min == 0 || w->min < min))
+			min = w->min;
+		if (w->max > max)
+			max = w->max;
+		if (i) {
+			int b;
+
+			for (b = 0; b < PROBE_BUCKETS; b++)
+				hist[b] += w->hist[b];
+		}
+	}
+
+	PRINT_NVMED_INFO;
+	P ("PROBE (%s, %s backend)\n", probe.path, probe.be->name);
+	if (!mock) {
+		P ("\n[Controller]\n");
+		probe_print_settings();
+	}
+	P ("\n[Workload]\n");
+	P ("%-36s  %s %u-byte reads\n", "Pattern", probe.seq? "Sequential" : "Random", probe.bs);
+	P ("%-36s  %d (%d queue%s, one read in flight each)\n", "Queue Depth", probe.qd, probe.qd,
+		(probe.qd == 1)? "" : "s");
+	P ("%-36s  %llu - %llu (%llu blocks of %u bytes)\n", "LBA Range", (unsigned long long) lba_start,
+		(unsigned long long) (lba_start + lba_count - 1), (unsigned long long) lba_count, lba_size);
+
+	P ("\n[Results]\n");
+	P ("%-36s  %llu in %.3f s", "Reads", (unsigned long long) total, elapsed / 1e9);
+	if (errors)
+		P (", %llu failed", (unsigned long long) errors);
+	P ("\n");
+	if (total == 0) {
+		P ("No read completed\n\n\n");
+		rc = -1;
+		goto out;
+	}
+	P ("%-36s  %.0f\n", "IOPS", total / (elapsed / 1e9));
+	P ("%-36s  %.1f MB/s\n", "Bandwidth", (double) total * probe.bs / (elapsed / 1e3));
+	P ("\n%-36s  %10s\n", "Latency", "usec");
+	P ("%-36s  %10.1f\n", "min", min / 1000.0);
+	P ("%-36s  %10.1f\n", "mean", (double) sum / total / 1000.0);
+	P ("%-36s  %10.1f\n", "p50", probe_percentile(hist, total, 50) / 1000.0);
+	P ("%-36s  %10.1f\n", "p90", probe_percentile(hist, total, 90) / 1000.0);
+	P ("%-36s  %10.1f\n", "p99", probe_percentile(hist, total, 99) / 1000.0);
+	P ("%-36s  %10.1f\n", "p99.9", probe_percentile(hist, total, 99.9) / 1000.0);
+	P ("%-36s  %10.1f\n", "max", max / 1000.0);
+	if (nvmed_info_opt_flag(cmd_args, "--histogram"))
+		probe_print_histogram(hist, total);
+	P ("\n\n");
+
+out:
+	for (i = 0; i < started; i++)
+		probe.be->close(&probe.w[i]);
+	return rc;
+}
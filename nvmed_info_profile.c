@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+// Time is charged to the phase on top of a small stack: admin commands and
+// sysfs/mmap setup are entered through the library hook and
+// nvmed_info_pci_open(), output through P(), and everything else (decoding
+// and the command logic) stays in PROF_DECODE.  Hardware counters are read
+// at every phase switch, so their cost is charged to the phase entered.
+
+#define PROF_DEPTH			16
+#define PROF_COUNTERS		3
+
+int nvmed_info_profiling;
+
+static const char *prof_names[PROF_PHASES] = { "decode", "admin", "sysfs/mmap", "output" };
+
+static struct {
+	__u64 calls;
+	__u64 ns;
+	__u64 counters[PROF_COUNTERS];
+} prof_phases[PROF_PHASES];
+
+static int prof_stack[PROF_DEPTH];
+static int prof_top;
+static __u64 prof_last_ns;
+static __u64 prof_last[PROF_COUNTERS];
+static __u64 prof_start_ns;
+static int prof_fd = -1;
+static int prof_kernel;
+
+static __u64 prof_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int prof_read (__u64 *v)
+{
+	struct { __u64 nr; __u64 values[PROF_COUNTERS]; } g;
+
+	if (prof_fd < 0 || read(prof_fd, &g, sizeof(g)) != sizeof(g))
+		return -1;
+	memcpy(v, g.values, sizeof(g.values));
+	return 0;
+}
+
+// Charges the time and counts since the last switch to the current phase
+static void prof_charge (void)
+{
+	__u64 now = prof_now(), v[PROF_COUNTERS];
+	int i, cur = prof_stack[prof_top];
+
+	prof_phases[cur].ns += now - prof_last_ns;
+	prof_last_ns = now;
+	if (prof_read(v) == 0) {
+		for (i = 0; i < PROF_COUNTERS; i++) {
+			prof_phases[cur].counters[i] += v[i] - prof_last[i];
+			prof_last[i] = v[i];
+		}
+	}
+}
+
+void nvmed_info_prof_enter (int phase)
+{
+	if (!nvmed_info_profiling || prof_top == PROF_DEPTH - 1)
+		return;
+	prof_charge();
+	prof_stack[++prof_top] = phase;
+	prof_phases[phase].calls++;
+}
+
+void nvmed_info_prof_leave (void)
+{
+	if (!nvmed_info_profiling || prof_top == 0)
+		return;
+	prof_charge();
+	prof_top--;
+}
+
+static void prof_hook (void *arg, int event, int begin)
+{
+	if (begin)
+		nvmed_info_prof_enter((event == NVMED_INFO_HOOK_ADMIN)? PROF_ADMIN : PROF_SYSFS);
+	else
+		nvmed_info_prof_leave();
+}
+
+int nvmed_info_printf (const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	nvmed_info_prof_enter(PROF_OUTPUT);
+	va_start(ap, fmt);
+	rc = vprintf(fmt, ap);
+	va_end(ap);
+	nvmed_info_prof_leave();
+	return rc;
+}
+
+static int prof_perf_open (__u64 config, int group, int exclude_kernel)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = (group < 0);
+	attr.exclude_kernel = exclude_kernel;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// Opens cycles, instructions and cache-misses as one group; counting the
+// kernel needs perf_event_paranoid <= 1 or CAP_PERFMON, so user-only
+// counting is the fallback
+static void prof_perf_start (void)
+{
+	static const __u64 configs[PROF_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+	int i, fd, exclude;
+
+	for (exclude = 0; exclude <= 1; exclude++) {
+		prof_fd = prof_perf_open(configs[0], -1, exclude);
+		for (i = 1; prof_fd >= 0 && i < PROF_COUNTERS; i++) {
+			fd = prof_perf_open(configs[i], prof_fd, exclude);
+			if (fd < 0) {
+				close(prof_fd);
+				prof_fd = -1;
+			}
+		}
+		if (prof_fd >= 0) {
+			prof_kernel = !exclude;
+			ioctl(prof_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+			return;
+		}
+	}
+}
+
+void nvmed_info_prof_start (NVMED_INFO *ctx)
+{
+	nvmed_info_profiling = 1;
+	memset(prof_phases, 0, sizeof(prof_phases));
+	prof_top = 0;
+	prof_stack[0] = PROF_DECODE;
+	prof_phases[PROF_DECODE].calls = 1;
+
+	prof_perf_start();
+	nvmed_info_ctx_set_hook(ctx, prof_hook, NULL);
+	prof_read(prof_last);
+	prof_start_ns = prof_last_ns = prof_now();
+}
+
+// The report goes to stderr to keep stdout parseable
+void nvmed_info_prof_report (NVMED_INFO *ctx, const char *cmd)
+{
+	__u64 total, c[PROF_COUNTERS] = { 0, 0, 0 };
+	int i, j;
+
+	fflush(stdout);
+	while (prof_top > 0)
+		nvmed_info_prof_leave();
+	prof_charge();
+	nvmed_info_ctx_set_hook(ctx, NULL, NULL);
+	nvmed_info_profiling = 0;
+	total = prof_last_ns - prof_start_ns;
+
+	fprintf(stderr, "\n[Profile: %s]\n", cmd);
+	fprintf(stderr, "Phase          Calls   Wall (usec)       %%");
+	if (prof_fd >= 0)
+		fprintf(stderr, "        Cycles  Instructions   IPC  Cache misses");
+	fprintf(stderr, "\n");
+	for (i = 0; i < PROF_PHASES; i++) {
+		fprintf(stderr, "%-10s  %8llu  %12.1f  %5.1f%%", prof_names[i],
+			(unsigned long long) prof_phases[i].calls, prof_phases[i].ns / 1000.0,
+			total? 100.0 * prof_phases[i].ns / total : 0);
+		if (prof_fd >= 0)
+			fprintf(stderr, "  %12llu  %12llu  %4.2f  %12llu",
+				(unsigned long long) prof_phases[i].counters[0],
+				(unsigned long long) prof_phases[i].counters[1],
+				prof_phases[i].counters[0]? (double) prof_phases[i].counters[1] / prof_phases[i].counters[0] : 0,
+				(unsigned long long) prof_phases[i].counters[2]);
+		fprintf(stderr, "\n");
+		for (j = 0; j < PROF_COUNTERS; j++)
+			c[j] += prof_phases[i].counters[j];
+	}
+	fprintf(stderr, "%-10s  %8s  %12.1f  %5.1f%%", "total", "", total / 1000.0, 100.0);
+	if (prof_fd >= 0)
+		fprintf(stderr, "  %12llu  %12llu  %4.2f  %12llu", (unsigned long long) c[0],
+			(unsigned long long) c[1], c[0]? (double) c[1] / c[0] : 0, (unsigned long long) c[2]);
+	fprintf(stderr, "\nHardware counters: %s\n\n", (prof_fd < 0)? "unavailable" :
+		prof_kernel? "user and kernel" : "user only (perf_event_paranoid)");
+
+	if (prof_fd >= 0) {
+		close(prof_fd);
+		prof_fd = -1;
+	}
+}
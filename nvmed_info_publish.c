@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+#include "nvmed_info_shm.h"
+
+
+static void publish_sample (struct nvmed_info_shm *shm, struct nvmed_info_controller *ctrl)
+{
+	struct nvmed_info_health h;
+	struct nvmed_info_smart smart;
+	struct nvmed_info_regs regs;
+	struct nvmed_info_link link;
+	struct timespec ts;
+
+	// Decode outside of the write section so that readers never wait on
+	// an admin command
+	memset(&h, 0, sizeof(h));
+	clock_gettime(CLOCK_REALTIME, &ts);
+	h.time_ns = (__u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	h.samples = shm->health.samples + 1;
+	h.wctemp = ctrl->wctemp;
+	h.cctemp = ctrl->cctemp;
+
+	if (nvmed_info_read_smart(dev_info, &smart) == 0) {
+		h.valid |= NVMED_INFO_SHM_SMART;
+		h.critical_warning = smart.critical_warning;
+		h.avail_spare = smart.avail_spare;
+		h.spare_thresh = smart.spare_thresh;
+		h.percent_used = smart.percent_used;
+		h.composite_temp = smart.composite_temp;
+		memcpy(h.temp_sensor, smart.temp_sensor, sizeof(h.temp_sensor));
+		h.warning_temp_time = smart.warning_temp_time;
+		h.critical_temp_time = smart.critical_temp_time;
+		h.data_units_read = smart.data_units_read;
+		h.data_units_written = smart.data_units_written;
+		h.host_read_cmds = smart.host_read_cmds;
+		h.host_write_cmds = smart.host_write_cmds;
+		h.power_on_hours = smart.power_on_hours;
+		h.unsafe_shutdowns = smart.unsafe_shutdowns;
+		h.media_errors = smart.media_errors;
+		h.num_err_log_entries = smart.num_err_log_entries;
+	}
+
+	if (nvmed_info_read_regs(dev_info, &regs) == 0) {
+		h.valid |= NVMED_INFO_SHM_REGS;
+		h.csts = regs.csts;
+		h.csts_rdy = regs.csts_rdy;
+		h.csts_cfs = regs.csts_cfs;
+		h.csts_shst = regs.csts_shst;
+	}
+
+	if (nvmed_info_read_link(dev_info, &link) == 0) {
+		h.valid |= NVMED_INFO_SHM_LINK;
+		h.link_max_speed = link.max_speed;
+		h.link_max_width = link.max_width;
+		h.link_cur_speed = link.cur_speed;
+		h.link_cur_width = link.cur_width;
+	}
+
+	nvmed_info_shm_write_begin(shm);
+	memcpy(&shm->health, &h, sizeof(h));
+	nvmed_info_shm_write_end(shm);
+}
+
+// Usage: publish [--name NAME] [--interval-ms N] [--count N]
+int nvmed_info_publish (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_shm *shm;
+	const char *path, *dev;
+	char name[64];
+	long interval, count, n;
+	int fd, i, rc;
+
+	interval = nvmed_info_opt_long(cmd_args, "--interval-ms", 1000);
+	count = nvmed_info_opt_long(cmd_args, "--count", 0);
+	if (interval <= 0 || count < 0) {
+		printf("Invalid --interval-ms or --count\n");
+		return -1;
+	}
+
+	path = nvmed_info_ctx_path(dev_info);
+	dev = strrchr(path, '/');
+	snprintf(name, sizeof(name), "/nvmed_info.%s", dev? dev + 1 : path);
+	for (i = 0; cmd_args && cmd_args[i]; i++)
+		if (!strcmp(cmd_args[i], "--name") && cmd_args[i+1])
+			snprintf(name, sizeof(name), "%s%s", (cmd_args[i+1][0] == '/')? "" : "/", cmd_args[i+1]);
+
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+
+	fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, sizeof(*shm)) < 0) {
+		printf("Cannot create the shared memory segment \"%s\"\n", name);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	shm = (struct nvmed_info_shm *) mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		printf("Cannot map the shared memory segment \"%s\"\n", name);
+		return -1;
+	}
+
+	// Readers check magic first, so it is set last
+	shm->magic = 0;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	shm->version = NVMED_INFO_SHM_VERSION;
+	shm->size = sizeof(*shm);
+	snprintf(shm->sn, sizeof(shm->sn), "%s", ctrl.sn);
+	snprintf(shm->path, sizeof(shm->path), "%s", path);
+	shm->interval_ms = interval;
+	shm->pid = getpid();
+	if (shm->seq & 1)
+		shm->seq++;
+	memset(&shm->health, 0, sizeof(shm->health));
+	__atomic_store_n(&shm->magic, NVMED_INFO_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	P ("Publishing the health of %s (SN %s) to %s every %ld msec\n", path, ctrl.sn, name, interval);
+
+	for (n = 0; count == 0 || n < count; n++) {
+		publish_sample(shm, &ctrl);
+		if (count == 0 || n + 1 < count)
+			usleep(interval * 1000);
+	}
+
+	munmap(shm, sizeof(*shm));
+	return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd qos_cmds[] = {
+	{"status", 1, "Arbitration mechanism, weights and class shares", nvmed_info_qos_status},
+	{"profile", 1, "Show or apply a named arbitration profile", nvmed_info_qos_profile},
+	{NULL, 0, NULL, NULL}
+};
+
+// CAP.AMS bit 17 and the CC.AMS encoding of Weighted Round Robin with Urgent
+#define AMS_WRR				1
+
+// Weights are 0's based; AB is 2^n commands, 7 for no limit
+struct qos_profile {
+	char *name;
+	__u8 hpw, mpw, lpw, ab;
+	char *desc;
+};
+
+static struct qos_profile qos_profiles[] = {
+	{"latency",		31,	7,	0,	1,	"High class dominates, short bursts to bound head-of-line blocking"},
+	{"balanced",	15,	7,	3,	3,	"Weights 4:2:1, moderate bursts"},
+	{"throughput",	7,	7,	7,	6,	"Equal weights, long bursts to keep the media busy"},
+	{NULL,			0,	0,	0,	0,	NULL}
+};
+
+// Queue Priority (QPRIO) of CREATE I/O SUBMISSION QUEUE, CDW11 bits 2:1
+static const char *qos_class[] = { "Urgent", "High", "Medium", "Low" };
+static const char *qos_qprio[] = { "00b", "01b", "10b", "11b" };
+
+static const char *qos_ams (int ams)
+{
+	return ams == 0? "Round Robin" : ams == AMS_WRR? "Weighted Round Robin with Urgent Priority Class" :
+		ams == 7? "Vendor Specific" : "Reserved";
+}
+
+static void qos_print_classes (__u8 hpw, __u8 mpw, __u8 lpw, __u8 ab)
+{
+	int w[4] = { 0, hpw + 1, mpw + 1, lpw + 1 };
+	int sum = w[1] + w[2] + w[3], i;
+
+	P ("Class   QPRIO  Weight  Share of WRR  Note\n");
+	P ("------  -----  ------  ------------  ----\n");
+	P ("%-6s  %5s  %6s  %12s  %s\n", qos_class[0], qos_qprio[0], "-", "-", "Served before every WRR class");
+	for (i = 1; i < 4; i++) {
+		P ("%-6s  %5s  %6d  %11.1f%%", qos_class[i], qos_qprio[i], w[i], 100.0 * w[i] / sum);
+		// QPRIO the nvmed module creates its I/O submission queues with
+		P ("%s\n", (i == 2)? "  NVMeDirect I/O queues" : "");
+	}
+	P ("Arbitration Burst (AB): ");
+	if (ab == 7)
+		P ("No limit\n");
+	else
+		P ("%d command%s per queue per turn\n", 1 << ab, ab? "s" : "");
+}
+
+int nvmed_info_qos (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	if (cmd_args[0] == NULL)
+		return nvmed_info_qos_status(nvmed, NULL);
+
+	c = cmd_lookup(qos_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_qos_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_qos_help (char *s)
+{
+	struct qos_profile *q;
+	int rc;
+
+	rc = cmd_help(s, "QOS subcommands", qos_cmds);
+	printf("\nProfiles (HPW / MPW / LPW are 1's based here)\n");
+	for (q = qos_profiles; q->name; q++)
+		printf("\t%-12s\t%d / %d / %d, AB %d: %s\n", q->name, q->hpw + 1, q->mpw + 1, q->lpw + 1,
+			q->ab, q->desc);
+	return rc;
+}
+
+// Reads CAP.AMS and CC.AMS; returns -1 if the registers cannot be read
+static int qos_read_ams (int *cap_wrr, int *cc_ams)
+{
+	struct nvmed_info_regs regs;
+
+	if (nvmed_info_read_regs(dev_info, &regs))
+		return -1;
+	*cap_wrr = regs.ams & AMS_WRR;
+	*cc_ams = regs.cc_ams;
+	return 0;
+}
+
+static void qos_print_ams (int have_regs, int cap_wrr, int cc_ams)
+{
+	if (!have_regs) {
+		P ("%-36s  %s\n", "Arbitration Mechanism (CAP / CC.AMS)", "Cannot read the controller registers");
+		return;
+	}
+	P ("%-36s  %s\n", "WRR Supported (CAP.AMS bit 17)", cap_wrr? "Yes" : "No");
+	P ("%-36s  %s\n", "Arbitration Selected (CC.AMS)", qos_ams(cc_ams));
+}
+
+// Usage: qos status
+int nvmed_info_qos_status (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_features feat;
+	int have_regs, cap_wrr = 0, cc_ams = 0, rc;
+
+	have_regs = (qos_read_ams(&cap_wrr, &cc_ams) == 0);
+	rc = nvmed_info_read_features(dev_info, &feat);
+	if (rc || (feat.valid & (1U << FEATURE_ARBITRATION)) == 0) {
+		printf("Cannot read the Arbitration feature (%d)\n", rc);
+		return -1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("QOS Status\n");
+	qos_print_ams(have_regs, cap_wrr, cc_ams);
+	P ("\n[Current Arbitration]\n");
+	qos_print_classes(feat.arbitration.hpw, feat.arbitration.mpw, feat.arbitration.lpw,
+		feat.arbitration.ab);
+	if (have_regs && cc_ams != AMS_WRR)
+		P ("\nCC.AMS selects %s: the controller ignores the weights and the queue classes,\n"
+		   "and only the Arbitration Burst applies.\n", qos_ams(cc_ams));
+	P ("\n\n");
+	return 0;
+}
+
+// Usage: qos profile <latency|balanced|throughput> [--apply] [--save]
+// Weights only take effect when the controller was enabled with CC.AMS set
+// to Weighted Round Robin; CC.AMS is chosen by the driver at reset.
+int nvmed_info_qos_profile (NVMED *nvmed, char **cmd_args)
+{
+	struct qos_profile *q;
+	struct feature_txn txn[1];
+	int have_regs, cap_wrr = 0, cc_ams = 0, save, n, k;
+	__u32 v;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL) {
+		printf("Usage: qos profile <latency|balanced|throughput> [--apply] [--save]\n");
+		return -1;
+	}
+	for (q = qos_profiles; q->name; q++)
+		if (!strcmp(cmd_args[0], q->name))
+			break;
+	if (q->name == NULL) {
+		printf("Unknown profile \"%s\" (latency, balanced or throughput)\n", cmd_args[0]);
+		return -1;
+	}
+	save = nvmed_info_opt_flag(cmd_args, "--save");
+	have_regs = (qos_read_ams(&cap_wrr, &cc_ams) == 0);
+
+	// Arbitration, CDW11: HPW 31:24, MPW 23:16, LPW 15:8, AB 2:0
+	v = ((__u32) q->hpw << 24) | ((__u32) q->mpw << 16) | ((__u32) q->lpw << 8) | q->ab;
+
+	PRINT_NVMED_INFO;
+	P ("QOS Profile \"%s\": %s\n", q->name, q->desc);
+	qos_print_ams(have_regs, cap_wrr, cc_ams);
+	P ("%-36s  0x%08x\n", "SET FEATURES Arbitration (01h) CDW11", v);
+	P ("\n");
+	qos_print_classes(q->hpw, q->mpw, q->lpw, q->ab);
+
+	if (nvmed_info_opt_flag(cmd_args, "--apply")) {
+		if (have_regs && !cap_wrr) {
+			printf("\nThe controller does not support Weighted Round Robin (CAP.AMS); the profile\n"
+				"would only change the Arbitration Burst\n");
+			return -1;
+		}
+		if (save && !nvmed_info_features_save_supported(nvmed)) {
+			printf("The controller does not support the Save field (ONCS bit 4)\n");
+			return -1;
+		}
+
+		n = 0;
+		k = nvmed_info_feature_txn_add(txn, &n, FEATURE_ARBITRATION, 0xffffff07, v);
+		txn[k].verify_mask = 0xffffff07;
+		if (nvmed_info_feature_txn_apply(nvmed, txn, n, save) < 0)
+			return -1;
+		P ("\nProfile \"%s\" applied%s\n", q->name, save? " and saved" : "");
+	}
+
+	if (!have_regs)
+		P ("\nCC.AMS could not be checked; the weights only apply under Weighted Round Robin.\n");
+	else if (cc_ams != AMS_WRR)
+		P ("\nCC.AMS selects %s, so the weights stay inactive until the driver enables\n"
+		   "the controller with Weighted Round Robin; only the Arbitration Burst applies now.\n",
+			qos_ams(cc_ams));
+	P ("\n\n");
+	return 0;
+}
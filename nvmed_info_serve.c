@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <grp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+// Requests are lines of text; a client may send any number of them on one
+// connection.  Each is answered with "OK <length>\n" and <length> bytes of
+// payload, or with "ERR <code> <message>\n".
+//
+//	identify controller			raw IDENTIFY Controller page (4096 bytes)
+//	identify namespace <nsid>	raw IDENTIFY Namespace page (4096 bytes)
+//	log <lid> [nsid]			raw log page (512 bytes), LIDs of serve_lids[]
+//	regs						controller registers (64 bytes)
+//	feature <fid>				current value (4 bytes, little-endian), FIDs of
+//								serve_fids[]
+//	field [nsid=N] <page>.<field> ...
+//								JSON object, e.g. {"smart.composite_temp":310}
+//	stats						JSON object of the server counters
+//
+// IDENTIFY pages are fetched once.  Log pages, registers and features are
+// fetched again only when older than the freshness window, so that any
+// number of clients asking for the same page within the window cost the
+// controller a single command.
+//
+// The server runs as root, so clients may only ask for the log pages and
+// features below: ones without side effects on reading (e.g. not Changed
+// Namespace List, which is cleared by the read) and without a command
+// specific parameter.  The socket is 0660, owned by --group when given.
+
+#define SERVE_CACHE_MAX		32
+#define SERVE_CLIENTS_MAX	64
+#define SERVE_LINE_MAX		1024
+
+enum { SERVE_IDENTIFY, SERVE_LOG, SERVE_REGS, SERVE_FEATURE, SERVE_CONFIG };
+
+struct serve_entry {
+	int kind;
+	int id;
+	int nsid;
+	int len;
+	__u64 when;							// msec, CLOCK_MONOTONIC; 0 if unused
+	__u8 data[4096];
+};
+
+struct serve_client {
+	int fd;
+	int len;
+	char line[SERVE_LINE_MAX];
+};
+
+static const int serve_lids[] = {
+	LOG_ERROR_INFO, LOG_SMART_INFO, LOG_FIRMWARE_SLOT_INFO, LOG_COMMAND_EFFECTS, -1
+};
+
+static const int serve_fids[] = {
+	FEATURE_ARBITRATION, FEATURE_POWER_MANAGEMENT, FEATURE_TEMPERATURE_THRESHOLD,
+	FEATURE_ERROR_RECOVERY, FEATURE_VOLATILE_WRITE_CACHE, FEATURE_NUMBER_OF_QUEUES,
+	FEATURE_INTERRUPT_COALESCING, FEATURE_WRITE_ATOMICITY_NORMAL, FEATURE_ASYNC_EVENT_CONFIG,
+	FEATURE_KEEP_ALIVE_TIMER, FEATURE_HOST_THERMAL_MGMT, -1
+};
+
+static struct serve_entry serve_cache[SERVE_CACHE_MAX];
+static struct serve_client serve_clients[SERVE_CLIENTS_MAX];
+static long serve_fresh_ms;
+static struct { __u64 requests, fetches, hits, errors; } serve_stats;
+static volatile sig_atomic_t serve_stop;
+static int serve_broken;				// a reply could not be sent in full
+
+static void serve_signal (int sig)
+{
+	serve_stop = 1;
+}
+
+static int serve_allowed (const int *ids, int id)
+{
+	for (; *ids >= 0; ids++)
+		if (*ids == id)
+			return 1;
+	return 0;
+}
+
+static __u64 serve_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Returns a cached page, fetching it when missing or stale; returns 0,
+// -errno or an NVMe status
+static int serve_get (int kind, int id, int nsid, struct serve_entry **entry)
+{
+	struct serve_entry *e, *victim = &serve_cache[0];
+	__u8 *buf = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	__u64 now = serve_now();
+	__u32 v;
+	int i, rc = 0;
+
+	for (i = 0; i < SERVE_CACHE_MAX; i++) {
+		e = &serve_cache[i];
+		if (e->when && e->kind == kind && e->id == id && e->nsid == nsid) {
+			if (kind == SERVE_IDENTIFY || now - e->when <= (__u64) serve_fresh_ms) {
+				serve_stats.hits++;
+				*entry = e;
+				return 0;
+			}
+			victim = e;
+			break;
+		}
+		if (e->when < victim->when)
+			victim = e;
+	}
+
+	e = victim;
+	switch (kind) {
+		case SERVE_IDENTIFY:
+			rc = nvmed_info_ctx_identify(dev_info, id, nsid, buf);
+			memcpy(e->data, buf, 4096);
+			e->len = 4096;
+			break;
+		case SERVE_LOG:
+			rc = nvmed_info_ctx_get_log(dev_info, id, nsid, buf, 512);
+			memcpy(e->data, buf, 512);
+			e->len = 512;
+			break;
+		case SERVE_REGS:
+			rc = nvmed_info_ctx_read_bar(dev_info, e->data, 64);
+			e->len = 64;
+			break;
+		case SERVE_FEATURE:
+			rc = nvmed_info_ctx_get_feature(dev_info, id, FEATURE_SEL_CURRENT, 0, 0, NULL, 0, &v);
+			v = htole32(v);
+			memcpy(e->data, &v, 4);
+			e->len = 4;
+			break;
+		case SERVE_CONFIG:
+			memset(e->data, 0, 256);
+			rc = nvmed_info_ctx_read_config(dev_info, e->data, 256);
+			rc = (rc < 0)? rc : 0;
+			e->len = 256;
+			break;
+	}
+	serve_stats.fetches++;
+	if (rc) {
+		e->when = 0;
+		return rc;
+	}
+	e->kind = kind;
+	e->id = id;
+	e->nsid = nsid;
+	e->when = now;
+	*entry = e;
+	return 0;
+}
+
+// Client sockets are non-blocking, so that a client which does not read its
+// replies cannot stall the others; it is dropped instead
+static void serve_send (int fd, const void *p, int len)
+{
+	const char *c = (const char *) p;
+	int n;
+
+	while (len > 0 && !serve_broken) {
+		n = send(fd, c, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n <= 0) {
+			serve_broken = 1;
+			return;
+		}
+		c += n;
+		len -= n;
+	}
+}
+
+static void serve_reply (int fd, const void *data, int len)
+{
+	char hdr[32];
+
+	snprintf(hdr, sizeof(hdr), "OK %d\n", len);
+	serve_send(fd, hdr, strlen(hdr));
+	serve_send(fd, data, len);
+}
+
+static void serve_error (int fd, int code, const char *msg)
+{
+	char line[128];
+
+	serve_stats.errors++;
+	snprintf(line, sizeof(line), "ERR %d %s\n", code, msg);
+	serve_send(fd, line, strlen(line));
+}
+
+static void serve_fields (int fd, char **argv, int argc)
+{
+	static const int kinds[] = { SERVE_IDENTIFY, SERVE_IDENTIFY, SERVE_LOG, SERVE_REGS, SERVE_CONFIG };
+	static const int ids[] = { CNS_CONTROLLER, CNS_NAMESPACE, LOG_SMART_INFO, 0, 0 };
+	struct serve_entry *e;
+	struct diff_field *f;
+	char out[4096];
+	int a, n, i, page, nsid = 1;
+
+	n = snprintf(out, sizeof(out), "{");
+	for (a = 1; a < argc; a++) {
+		if (!strncmp(argv[a], "nsid=", 5)) {
+			nsid = atoi(argv[a] + 5);
+			continue;
+		}
+		// Only known names reach the reply, so the keys need no escaping
+		f = nvmed_info_field_lookup(argv[a], &page, &i);
+		if (f == NULL) {
+			serve_error(fd, 22, "Unknown field");
+			return;
+		}
+		if (n > 1)
+			n += snprintf(out + n, sizeof(out) - n, ",");
+		n += snprintf(out + n, sizeof(out) - n, "\"%s\":", argv[a]);
+
+		if (serve_get(kinds[page], ids[page],
+					(page == FIELD_PAGE_NAMESPACE)? nsid : 0, &e))
+			n += snprintf(out + n, sizeof(out) - n, "null");
+		else
+			n += nvmed_info_field_format(page, e->data, f, i, out + n, sizeof(out) - n);
+
+		if (n >= (int) sizeof(out) - 64) {
+			serve_error(fd, 7, "Too many fields");
+			return;
+		}
+	}
+	n += snprintf(out + n, sizeof(out) - n, "}");
+	serve_reply(fd, out, n);
+}
+
+static void serve_request (int fd, char *line)
+{
+	struct serve_entry *e = NULL;
+	char *argv[64], *save;
+	char out[256];
+	int argc = 0, id, rc = -1;
+
+	serve_stats.requests++;
+	for (argv[argc] = strtok_r(line, " \t\r", &save); argv[argc] && argc < 63; )
+		argv[++argc] = strtok_r(NULL, " \t\r", &save);
+	if (argc == 0)
+		return;
+
+	if (!strcmp(argv[0], "identify") && argc >= 2) {
+		if (!strcmp(argv[1], "controller"))
+			rc = serve_get(SERVE_IDENTIFY, CNS_CONTROLLER, 0, &e);
+		else if (!strcmp(argv[1], "namespace") && argc >= 3)
+			rc = serve_get(SERVE_IDENTIFY, CNS_NAMESPACE, atoi(argv[2]), &e);
+		else {
+			serve_error(fd, 22, "Usage: identify controller | identify namespace <nsid>");
+			return;
+		}
+	} else if (!strcmp(argv[0], "log") && argc >= 2) {
+		id = strtol(argv[1], NULL, 0);
+		if (!serve_allowed(serve_lids, id)) {
+			serve_error(fd, 1, "Log page not served");
+			return;
+		}
+		rc = serve_get(SERVE_LOG, id, (argc >= 3)? atoi(argv[2]) : 0, &e);
+	} else if (!strcmp(argv[0], "regs"))
+		rc = serve_get(SERVE_REGS, 0, 0, &e);
+	else if (!strcmp(argv[0], "feature") && argc >= 2) {
+		id = strtol(argv[1], NULL, 0);
+		if (!serve_allowed(serve_fids, id)) {
+			serve_error(fd, 1, "Feature not served");
+			return;
+		}
+		rc = serve_get(SERVE_FEATURE, id, 0, &e);
+	} else if (!strcmp(argv[0], "field")) {
+		serve_fields(fd, argv, argc);
+		return;
+	} else if (!strcmp(argv[0], "stats")) {
+		snprintf(out, sizeof(out), "{\"requests\":%llu,\"fetches\":%llu,\"hits\":%llu,\"errors\":%llu}",
+			(unsigned long long) serve_stats.requests, (unsigned long long) serve_stats.fetches,
+			(unsigned long long) serve_stats.hits, (unsigned long long) serve_stats.errors);
+		serve_reply(fd, out, strlen(out));
+		return;
+	} else {
+		serve_error(fd, 22, "Unknown request");
+		return;
+	}
+
+	if (rc) {
+		snprintf(out, sizeof(out), "%s failed", argv[0]);
+		serve_error(fd, (rc < 0)? -rc : rc, out);
+		return;
+	}
+	serve_reply(fd, e->data, e->len);
+}
+
+// Handles the complete lines received from a client; returns -1 when the
+// client is gone
+static int serve_read (struct serve_client *c)
+{
+	char *nl;
+	int n;
+
+	n = recv(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len, 0);
+	if (n <= 0)
+		return -1;
+	c->len += n;
+	c->line[c->len] = '\0';
+
+	while ((nl = strchr(c->line, '\n')) != NULL) {
+		*nl = '\0';
+		serve_broken = 0;
+		serve_request(c->fd, c->line);
+		if (serve_broken)
+			return -1;
+		c->len -= nl + 1 - c->line;
+		memmove(c->line, nl + 1, c->len + 1);
+	}
+	if (c->len == sizeof(c->line) - 1)
+		return -1;						// a line too long to be a request
+	return 0;
+}
+
+// Usage: serve [--socket PATH] [--fresh-ms N] [--group NAME]
+int nvmed_info_serve (NVMED *nvmed, char **cmd_args)
+{
+	struct sockaddr_un addr;
+	struct group *grp = NULL;
+	struct pollfd fds[SERVE_CLIENTS_MAX + 1];
+	struct serve_entry *e;
+	const char *path, *dev;
+	int i, n, fd, lfd;
+
+	serve_fresh_ms = nvmed_info_opt_long(cmd_args, "--fresh-ms", 1000);
+	if (serve_fresh_ms < 0) {
+		printf("Invalid --fresh-ms\n");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	path = nvmed_info_ctx_path(dev_info);
+	dev = strrchr(path, '/');
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "/run/nvmed_info.%s.sock", dev? dev + 1 : path);
+	for (i = 0; cmd_args && cmd_args[i]; i++) {
+		if (!strcmp(cmd_args[i], "--socket") && cmd_args[i+1])
+			snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", cmd_args[i+1]);
+		if (!strcmp(cmd_args[i], "--group") && cmd_args[i+1] && (grp = getgrnam(cmd_args[i+1])) == NULL) {
+			printf("Unknown group \"%s\"\n", cmd_args[i+1]);
+			return -1;
+		}
+	}
+
+	// The IDENTIFY Controller page is warmed before the first client
+	if (serve_get(SERVE_IDENTIFY, CNS_CONTROLLER, 0, &e)) {
+		printf("IDENTIFY Controller failed\n");
+		return -1;
+	}
+
+	lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(addr.sun_path);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(lfd, 16) < 0) {
+		printf("Cannot listen on \"%s\"\n", addr.sun_path);
+		if (lfd >= 0)
+			close(lfd);
+		return -1;
+	}
+	// Only the owner and the group may connect
+	if (chmod(addr.sun_path, 0660) < 0 || (grp && chown(addr.sun_path, -1, grp->gr_gid) < 0)) {
+		printf("Cannot set the owner or mode of \"%s\"\n", addr.sun_path);
+		close(lfd);
+		unlink(addr.sun_path);
+		return -1;
+	}
+
+	for (i = 0; i < SERVE_CLIENTS_MAX; i++)
+		serve_clients[i].fd = -1;
+	serve_stop = 0;
+	signal(SIGINT, serve_signal);
+	signal(SIGTERM, serve_signal);
+
+	P ("Serving %s on %s (freshness window: %ld msec)\n", path, addr.sun_path, serve_fresh_ms);
+	fflush(stdout);
+
+	while (!serve_stop) {
+		fds[0].fd = lfd;
+		fds[0].events = POLLIN;
+		for (i = 0; i < SERVE_CLIENTS_MAX; i++) {
+			fds[i + 1].fd = serve_clients[i].fd;
+			fds[i + 1].events = POLLIN;
+			fds[i + 1].revents = 0;
+		}
+
+		n = poll(fds, SERVE_CLIENTS_MAX + 1, 1000);
+		if (n <= 0)
+			continue;
+
+		if (fds[0].revents & POLLIN) {
+			fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			for (i = 0; fd >= 0 && i < SERVE_CLIENTS_MAX; i++) {
+				if (serve_clients[i].fd < 0) {
+					serve_clients[i].fd = fd;
+					serve_clients[i].len = 0;
+					break;
+				}
+			}
+			if (fd >= 0 && i == SERVE_CLIENTS_MAX) {
+				serve_error(fd, 16, "Too many clients");
+				close(fd);
+			}
+		}
+
+		for (i = 0; i < SERVE_CLIENTS_MAX; i++) {
+			if (serve_clients[i].fd < 0 || !(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			if (serve_read(&serve_clients[i]) < 0) {
+				close(serve_clients[i].fd);
+				serve_clients[i].fd = -1;
+			}
+		}
+	}
+
+	for (i = 0; i < SERVE_CLIENTS_MAX; i++)
+		if (serve_clients[i].fd >= 0)
+			close(serve_clients[i].fd);
+	close(lfd);
+	unlink(addr.sun_path);
+
+	P ("%llu requests, %llu commands to the controller\n", (unsigned long long) serve_stats.requests,
+		(unsigned long long) serve_stats.fetches);
+	return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef _NVMED_INFO_SHM_H
+#define _NVMED_INFO_SHM_H
+
+// Health of a drive published by "nvmed_info <dev> publish" into a POSIX
+// shared memory segment, "/nvmed_info.<device name>" by default
+// (/dev/shm/nvmed_info.nvme0n1).
+//
+// The publisher is the only writer.  It makes seq odd, updates health and
+// makes seq even again, so a reader never needs a lock or a system call:
+// it copies health and retries if seq was odd or changed meanwhile, which
+// nvmed_info_shm_read() below does.  All members have fixed sizes and
+// offsets; integers are in host byte order.
+//
+//	int fd = shm_open("/nvmed_info.nvme0n1", O_RDONLY, 0);
+//	const struct nvmed_info_shm *shm = mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+//	struct nvmed_info_health h;
+//
+//	if (nvmed_info_shm_read(shm, &h) == 0)
+//		printf("%d C\n", h.composite_temp - 273);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+#include <linux/types.h>
+
+#define NVMED_INFO_SHM_MAGIC		0x4d48534f464e4944ULL		// "DINFOSHM"
+#define NVMED_INFO_SHM_VERSION		1
+
+// Bits of nvmed_info_health.valid
+#define NVMED_INFO_SHM_SMART		(1 << 0)
+#define NVMED_INFO_SHM_REGS			(1 << 1)
+#define NVMED_INFO_SHM_LINK			(1 << 2)
+
+struct nvmed_info_health {
+	__u64 time_ns;						//   0: CLOCK_REALTIME of the sample
+	__u64 samples;						//   8: samples published so far
+	__u32 valid;						//  16: NVMED_INFO_SHM_* parts below are current
+	__u32 rsvd0;						//  20
+
+	// SMART / Health Information; 128-bit counters saturated to 64 bits
+	__u8 critical_warning;				//  24
+	__u8 avail_spare;					//  25: percent
+	__u8 spare_thresh;					//  26: percent
+	__u8 percent_used;					//  27
+	__u16 composite_temp;				//  28: Kelvin
+	__u16 wctemp;						//  30: Kelvin, from IDENTIFY
+	__u16 cctemp;						//  32: Kelvin, from IDENTIFY
+	__u16 temp_sensor[8];				//  34: Kelvin, 0 if not implemented
+	__u16 rsvd1;						//  50
+	__u32 warning_temp_time;			//  52: minutes
+	__u32 critical_temp_time;			//  56: minutes
+	__u32 rsvd2;						//  60
+	__u64 data_units_read;				//  64: 1000 * 512 bytes
+	__u64 data_units_written;			//  72: 1000 * 512 bytes
+	__u64 host_read_cmds;				//  80
+	__u64 host_write_cmds;				//  88
+	__u64 power_on_hours;				//  96
+	__u64 unsafe_shutdowns;				// 104
+	__u64 media_errors;					// 112
+	__u64 num_err_log_entries;			// 120
+
+	// Controller Status (CSTS)
+	__u32 csts;							// 128
+	__u8 csts_rdy;						// 132
+	__u8 csts_cfs;						// 133: Controller Fatal Status
+	__u8 csts_shst;						// 134: Shutdown Status
+	__u8 rsvd3;							// 135
+
+	// PCI Express link
+	__u8 link_max_speed;				// 136: Gen N
+	__u8 link_max_width;				// 137: lanes
+	__u8 link_cur_speed;				// 138: Gen N
+	__u8 link_cur_width;				// 139: lanes
+	__u32 rsvd4;						// 140
+};										// 144 bytes
+
+struct nvmed_info_shm {
+	__u64 magic;						//   0: NVMED_INFO_SHM_MAGIC
+	__u32 version;						//   8: NVMED_INFO_SHM_VERSION
+	__u32 size;							//  12: sizeof(struct nvmed_info_shm)
+	char sn[24];						//  16: Serial Number
+	char path[64];						//  40: device path
+	__u32 interval_ms;					// 104: publishing interval
+	__u32 pid;							// 108: publisher
+	__u32 seq;							// 112: odd while health is being updated
+	__u32 rsvd;							// 116
+	__u64 rsvd2;						// 120
+	struct nvmed_info_health health;	// 128
+};										// 272 bytes
+
+#if !defined(__cplusplus) && defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+_Static_assert(sizeof(struct nvmed_info_health) == 144, "nvmed_info_health layout");
+_Static_assert(sizeof(struct nvmed_info_shm) == 272, "nvmed_info_shm layout");
+#endif
+
+// Copies a consistent health sample; returns 0, or -1 if the segment is not
+// published or the writer kept it busy for too long
+static inline int nvmed_info_shm_read (const struct nvmed_info_shm *shm, struct nvmed_info_health *h)
+{
+	__u32 seq;
+	int tries;
+
+	if (shm->magic != NVMED_INFO_SHM_MAGIC || shm->version != NVMED_INFO_SHM_VERSION)
+		return -1;
+
+	for (tries = 0; tries < 1000; tries++) {
+		seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		memcpy(h, (const void *) &shm->health, sizeof(*h));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -1;
+}
+
+// Writer side, for the publisher
+static inline void nvmed_info_shm_write_begin (struct nvmed_info_shm *shm)
+{
+	__atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void nvmed_info_shm_write_end (struct nvmed_info_shm *shm)
+{
+	__atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NVMED_INFO_SHM_H */
@@ -0,0 +1,607 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <endian.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+int nvmed_info_snapshot_capture (NVMED *nvmed, int nsid, struct snapshot *s)
+{
+	__u8 *buf = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	int rc;
+
+	memset(s, 0, sizeof(*s));
+	memcpy(s->magic, SNAPSHOT_MAGIC, sizeof(s->magic));
+	s->version = htole32(SNAPSHOT_VERSION);
+	s->nsid = htole32(nsid);
+	s->time = htole64(time(NULL));
+
+	rc = nvmed_info_ctx_identify(dev_info, CNS_CONTROLLER, 0, buf);
+	if (rc) {
+		printf("IDENTIFY Controller failed (%d)\n", rc);
+		return -1;
+	}
+	memcpy(s->ctrl, buf, sizeof(s->ctrl));
+
+	rc = nvmed_info_ctx_identify(dev_info, CNS_NAMESPACE, nsid, buf);
+	if (rc) {
+		printf("IDENTIFY Namespace %d failed (%d)\n", nsid, rc);
+		return -1;
+	}
+	memcpy(s->ns, buf, sizeof(s->ns));
+
+	rc = nvmed_info_ctx_get_log(dev_info, LOG_SMART_INFO, 0, buf, sizeof(s->smart));
+	if (rc) {
+		printf("GET LOG PAGE (SMART / Health Information) failed (%d)\n", rc);
+		return -1;
+	}
+	memcpy(s->smart, buf, sizeof(s->smart));
+
+	rc = nvmed_info_ctx_read_bar(dev_info, s->regs, sizeof(s->regs));
+	if (rc) {
+		printf("Reading the controller registers failed (%d)\n", rc);
+		return -1;
+	}
+	return 0;
+}
+
+int nvmed_info_snapshot_load (char *path, struct snapshot *s)
+{
+	int fd, len;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("Cannot open the snapshot \"%s\"\n", path);
+		return -1;
+	}
+	len = read(fd, s, sizeof(*s));
+	close(fd);
+
+	if (len != (int) sizeof(*s) || memcmp(s->magic, SNAPSHOT_MAGIC, sizeof(s->magic))
+			|| le32toh(s->version) != SNAPSHOT_VERSION) {
+		printf("\"%s\" is not an nvmed_info snapshot\n", path);
+		return -1;
+	}
+	return 0;
+}
+
+// Usage: snapshot <file> [nsid]
+int nvmed_info_snapshot (NVMED *nvmed, char **cmd_args)
+{
+	struct snapshot s;
+	int fd, nsid = 1;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL) {
+		printf("Usage: snapshot <file> [nsid]\n");
+		return -1;
+	}
+	if (cmd_args[1])
+		nsid = atoi(cmd_args[1]);
+
+	if (nvmed_info_snapshot_capture(nvmed, nsid, &s) < 0)
+		return -1;
+
+	fd = open(cmd_args[0], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || write(fd, &s, sizeof(s)) != (int) sizeof(s)) {
+		printf("Cannot write the snapshot \"%s\"\n", cmd_args[0]);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	close(fd);
+
+	P ("Snapshot of %s (namespace %d) saved to %s\n", nvmed_info_ctx_path(dev_info), nsid, cmd_args[0]);
+	return 0;
+}
+
+
+#define DF(st, m, off, len, type, hex) \
+	{#m, off, len, offsetof(st, m), type, hex, 1, 0, 0}
+#define DA(st, m, f, off, len, type, n, stride) \
+	{#m "." #f, off, len, offsetof(st, m[0].f), type, 0, n, stride, sizeof(((st *) 0)->m[0])}
+
+#define DC(m, off, len, type, hex)	DF(struct nvmed_info_controller, m, off, len, type, hex)
+static struct diff_field diff_controller[] = {
+	DC(vid, 0, 2, DIFF_U16, 1),
+	DC(ssvid, 2, 2, DIFF_U16, 1),
+	DC(sn, 4, 20, DIFF_STR, 0),
+	DC(mn, 24, 40, DIFF_STR, 0),
+	DC(fr, 64, 8, DIFF_STR, 0),
+	DC(rab, 72, 1, DIFF_U8, 0),
+	DC(ieee, 73, 3, DIFF_U32, 1),
+	DC(cmic, 76, 1, DIFF_U8, 1),
+	DC(mdts, 77, 1, DIFF_U8, 0),
+	DC(cntlid, 78, 2, DIFF_U16, 1),
+	DC(ver, 80, 4, DIFF_U32, 1),
+	DC(rtd3r, 84, 4, DIFF_U32, 0),
+	DC(rtd3e, 88, 4, DIFF_U32, 0),
+	DC(oaes, 92, 4, DIFF_U32, 1),
+	DC(ctratt, 96, 4, DIFF_U32, 1),
+	DC(oacs, 256, 2, DIFF_U16, 1),
+	DC(acl, 258, 1, DIFF_U8, 0),
+	DC(aerl, 259, 1, DIFF_U8, 0),
+	DC(frmw, 260, 1, DIFF_U8, 1),
+	DC(lpa, 261, 1, DIFF_U8, 1),
+	DC(elpe, 262, 1, DIFF_U8, 0),
+	DC(npss, 263, 1, DIFF_U8, 0),
+	DC(avscc, 264, 1, DIFF_U8, 1),
+	DC(apsta, 265, 1, DIFF_U8, 1),
+	DC(wctemp, 266, 2, DIFF_U16, 0),
+	DC(cctemp, 268, 2, DIFF_U16, 0),
+	DC(mtfa, 270, 2, DIFF_U16, 0),
+	DC(hmpre, 272, 4, DIFF_U32, 0),
+	DC(hmmin, 276, 4, DIFF_U32, 0),
+	DC(tnvmcap, 280, 16, DIFF_U64, 0),
+	DC(unvmcap, 296, 16, DIFF_U64, 0),
+	DC(rpmbs, 312, 4, DIFF_U32, 1),
+	DC(kas, 320, 2, DIFF_U16, 0),
+	DC(hctma, 322, 2, DIFF_U16, 1),
+	DC(mntmt, 324, 2, DIFF_U16, 0),
+	DC(mxtmt, 326, 2, DIFF_U16, 0),
+	DC(hmminds, 332, 4, DIFF_U32, 0),
+	DC(hmmaxd, 336, 2, DIFF_U16, 0),
+	DC(nsetidmax, 338, 2, DIFF_U16, 0),
+	DC(sqes, 512, 1, DIFF_U8, 1),
+	DC(cqes, 513, 1, DIFF_U8, 1),
+	DC(maxcmd, 514, 2, DIFF_U16, 0),
+	DC(nn, 516, 4, DIFF_U32, 0),
+	DC(oncs, 520, 2, DIFF_U16, 1),
+	DC(fuses, 522, 2, DIFF_U16, 1),
+	DC(fna, 524, 1, DIFF_U8, 1),
+	DC(vwc, 525, 1, DIFF_U8, 1),
+	DC(awun, 526, 2, DIFF_U16, 0),
+	DC(awupf, 528, 2, DIFF_U16, 0),
+	DC(nvscc, 530, 1, DIFF_U8, 1),
+	DC(acwu, 532, 2, DIFF_U16, 0),
+	DC(sgls, 536, 4, DIFF_U32, 1),
+	DA(struct nvmed_info_controller, psd, mp, PSD0 + 0, 2, DIFF_U16, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, mxps, PSD0 + 3, 1, DIFF_INT, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, nops, PSD0 + 3, 1, DIFF_INT, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, enlat, PSD0 + 4, 4, DIFF_U32, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, exlat, PSD0 + 8, 4, DIFF_U32, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, rrt, PSD0 + 12, 1, DIFF_INT, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, rrl, PSD0 + 13, 1, DIFF_INT, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, rwt, PSD0 + 14, 1, DIFF_INT, MAX_POWER_STATES, PSD_SIZE),
+	DA(struct nvmed_info_controller, psd, rwl, PSD0 + 15, 1, DIFF_INT, MAX_POWER_STATES, PSD_SIZE),
+	{NULL, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+#undef DC
+
+#define DN(m, off, len, type, hex)	DF(struct nvmed_info_namespace, m, off, len, type, hex)
+static struct diff_field diff_namespace[] = {
+	DN(nsze, 0, 8, DIFF_U64, 0),
+	DN(ncap, 8, 8, DIFF_U64, 0),
+	DN(nuse, 16, 8, DIFF_U64, 0),
+	DN(nsfeat, 24, 1, DIFF_U8, 1),
+	DN(nlbaf, 25, 1, DIFF_U8, 0),
+	DN(flbas, 26, 1, DIFF_U8, 1),
+	DN(mc, 27, 1, DIFF_U8, 1),
+	DN(dpc, 28, 1, DIFF_U8, 1),
+	DN(dps, 29, 1, DIFF_U8, 1),
+	DN(nmic, 30, 1, DIFF_U8, 1),
+	DN(rescap, 31, 1, DIFF_U8, 1),
+	DN(fpi, 32, 1, DIFF_U8, 1),
+	DN(nawun, 34, 2, DIFF_U16, 0),
+	DN(nawupf, 36, 2, DIFF_U16, 0),
+	DN(nacwu, 38, 2, DIFF_U16, 0),
+	DN(nabsn, 40, 2, DIFF_U16, 0),
+	DN(nabo, 42, 2, DIFF_U16, 0),
+	DN(nabspf, 44, 2, DIFF_U16, 0),
+	DN(nvmcap, 48, 16, DIFF_U64, 0),
+	DN(npwg, 64, 2, DIFF_U16, 0),
+	DN(npwa, 66, 2, DIFF_U16, 0),
+	DN(npdg, 68, 2, DIFF_U16, 0),
+	DN(npda, 70, 2, DIFF_U16, 0),
+	DN(nows, 72, 2, DIFF_U16, 0),
+	DN(nguid, 104, 16, DIFF_BYTES, 0),
+	DN(eui64, 120, 8, DIFF_BYTES, 0),
+	DA(struct nvmed_info_namespace, lbaf, ms, 128, 2, DIFF_U16, 16, 4),
+	DA(struct nvmed_info_namespace, lbaf, lbads, 130, 1, DIFF_U8, 16, 4),
+	DA(struct nvmed_info_namespace, lbaf, rp, 131, 1, DIFF_U8, 16, 4),
+	{NULL, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+#undef DN
+
+#define DS(m, off, len, type, hex)	DF(struct nvmed_info_smart, m, off, len, type, hex)
+struct diff_field diff_smart[] = {
+	DS(critical_warning, 0, 1, DIFF_U8, 1),
+	DS(composite_temp, 1, 2, DIFF_U16, 0),
+	DS(avail_spare, 3, 1, DIFF_U8, 0),
+	DS(spare_thresh, 4, 1, DIFF_U8, 0),
+	DS(percent_used, 5, 1, DIFF_U8, 0),
+	DS(data_units_read, 32, 16, DIFF_U64, 0),
+	DS(data_units_written, 48, 16, DIFF_U64, 0),
+	DS(host_read_cmds, 64, 16, DIFF_U64, 0),
+	DS(host_write_cmds, 80, 16, DIFF_U64, 0),
+	DS(ctrl_busy_time, 96, 16, DIFF_U64, 0),
+	DS(power_cycles, 112, 16, DIFF_U64, 0),
+	DS(power_on_hours, 128, 16, DIFF_U64, 0),
+	DS(unsafe_shutdowns, 144, 16, DIFF_U64, 0),
+	DS(media_errors, 160, 16, DIFF_U64, 0),
+	DS(num_err_log_entries, 176, 16, DIFF_U64, 0),
+	DS(warning_temp_time, 192, 4, DIFF_U32, 0),
+	DS(critical_temp_time, 196, 4, DIFF_U32, 0),
+	{"temp_sensor", 200, 2, offsetof(struct nvmed_info_smart, temp_sensor), DIFF_U16, 0, 8, 2, sizeof(__u16)},
+	{NULL, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+#undef DS
+
+// Looks up a field by name, such as "mdts", "temp_sensor[2]" or
+// "psd[3].enlat"; *i is set to the array index
+static struct diff_field *diff_field_find (struct diff_field *table, const char *name, int *i)
+{
+	struct diff_field *f;
+	const char *b, *e;
+	char key[64];
+
+	*i = 0;
+	b = strchr(name, '[');
+	if (b) {
+		e = strchr(b, ']');
+		if (e == NULL)
+			return NULL;
+		*i = atoi(b + 1);
+		snprintf(key, sizeof(key), "%.*s%s", (int) (b - name), name, e + 1);
+	} else
+		snprintf(key, sizeof(key), "%s", name);
+
+	for (f = table; f->name; f++)
+		if (!strcmp(f->name, key))
+			return (*i >= 0 && *i < f->count)? f : NULL;
+	return NULL;
+}
+
+struct diff_field *nvmed_info_smart_field (const char *name, int *i)
+{
+	return diff_field_find(diff_smart, name, i);
+}
+
+#define DR(m, off, len, type, hex)	DF(struct nvmed_info_regs, m, off, len, type, hex)
+static struct diff_field diff_regs[] = {
+	DR(cap, 0, 8, DIFF_U64, 1),
+	DR(mqes, 0, 2, DIFF_U32, 0),
+	DR(cqr, 2, 1, DIFF_U8, 0),
+	DR(ams, 2, 1, DIFF_U8, 0),
+	DR(to, 3, 1, DIFF_U8, 0),
+	DR(dstrd, 4, 1, DIFF_U8, 0),
+	DR(nssrs, 4, 1, DIFF_U8, 0),
+	DR(css, 4, 2, DIFF_U8, 1),
+	DR(mpsmin, 6, 1, DIFF_U8, 0),
+	DR(mpsmax, 6, 1, DIFF_U8, 0),
+	DR(vs, 8, 4, DIFF_U32, 1),
+	DR(cc, 20, 4, DIFF_U32, 1),
+	DR(cc_en, 20, 1, DIFF_U8, 0),
+	DR(cc_css, 20, 1, DIFF_U8, 0),
+	DR(cc_mps, 20, 2, DIFF_U8, 0),
+	DR(cc_ams, 21, 1, DIFF_U8, 0),
+	DR(cc_shn, 21, 1, DIFF_U8, 0),
+	DR(cc_iosqes, 22, 1, DIFF_U8, 0),
+	DR(cc_iocqes, 22, 1, DIFF_U8, 0),
+	DR(csts, 28, 4, DIFF_U32, 1),
+	DR(csts_rdy, 28, 1, DIFF_U8, 0),
+	DR(csts_cfs, 28, 1, DIFF_U8, 0),
+	DR(csts_shst, 28, 1, DIFF_U8, 0),
+	DR(csts_nssro, 28, 1, DIFF_U8, 0),
+	DR(csts_pp, 28, 1, DIFF_U8, 0),
+	DR(aqa, 36, 4, DIFF_U32, 1),
+	DR(cmbloc, 56, 4, DIFF_U32, 1),
+	DR(cmbsz, 60, 4, DIFF_U32, 1),
+	// Offset and size are both scaled by CMBSZ.SZU
+	DR(cmb_bir, 56, 1, DIFF_U8, 0),
+	DR(cmb_offset, 56, 8, DIFF_U64, 1),
+	DR(cmb_size, 56, 8, DIFF_U64, 0),
+	{NULL, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+#undef DR
+
+// Link fields are not at fixed offsets of the configuration space
+#define DL(m)	DF(struct nvmed_info_link, m, 0, 0, DIFF_U8, 0)
+static struct diff_field diff_link[] = {
+	DF(struct nvmed_info_link, vendor_id, 0, 2, DIFF_U16, 1),
+	DF(struct nvmed_info_link, device_id, 2, 2, DIFF_U16, 1),
+	DL(max_speed),
+	DL(max_width),
+	DL(cur_speed),
+	DL(cur_width),
+	{"speed", 0, 0, offsetof(struct nvmed_info_link, cur_speed), DIFF_U8, 0, 1, 0, 0},
+	{"width", 0, 0, offsetof(struct nvmed_info_link, cur_width), DIFF_U8, 0, 1, 0, 0},
+	DF(struct nvmed_info_link, mps, 0, 0, DIFF_U16, 0),
+	DF(struct nvmed_info_link, mrrs, 0, 0, DIFF_U16, 0),
+	{NULL, 0, 0, 0, 0, 0, 0, 0, 0}
+};
+#undef DL
+
+static void diff_decode_controller (const __u8 *p, void *d) { nvmed_info_decode_controller(p, d); }
+static void diff_decode_namespace (const __u8 *p, void *d) { nvmed_info_decode_namespace(p, d); }
+static void diff_decode_smart (const __u8 *p, void *d) { nvmed_info_decode_smart(p, d); }
+static void diff_decode_regs (const __u8 *p, void *d) { nvmed_info_decode_regs(p, d); }
+static void diff_decode_link (const __u8 *p, void *d) { nvmed_info_decode_link(p, 256, d); }
+
+struct diff_page {
+	const char *key;					// FIELD_PAGE_* order
+	const char *alias;
+	const char *title;
+	size_t off;							// offset in struct snapshot
+	int len;
+	void (*decode)(const __u8 *p, void *d);
+	size_t size;						// size of the decoded structure
+	struct diff_field *fields;
+};
+
+static struct diff_page diff_pages[] = {
+	{"controller", "ctrl", "IDENTIFY Controller", offsetof(struct snapshot, ctrl), 4096, diff_decode_controller,
+		sizeof(struct nvmed_info_controller), diff_controller},
+	{"namespace", "ns", "IDENTIFY Namespace", offsetof(struct snapshot, ns), 4096, diff_decode_namespace,
+		sizeof(struct nvmed_info_namespace), diff_namespace},
+	{"smart", NULL, "SMART / Health Information", offsetof(struct snapshot, smart), 512, diff_decode_smart,
+		sizeof(struct nvmed_info_smart), diff_smart},
+	{"regs", NULL, "Controller Registers", offsetof(struct snapshot, regs), 64, diff_decode_regs,
+		sizeof(struct nvmed_info_regs), diff_regs},
+	{"link", NULL, "PCI Express Link", 0, 256, diff_decode_link,
+		sizeof(struct nvmed_info_link), diff_link},
+	{NULL, NULL, NULL, 0, 0, NULL, 0, NULL}
+};
+
+// Looks up "<page>.<field>", where page is controller (ctrl), namespace
+// (ns), smart, regs or link; *page is set to FIELD_PAGE_*
+struct diff_field *nvmed_info_field_lookup (const char *name, int *page, int *i)
+{
+	struct diff_page *pg;
+	size_t len = strcspn(name, ".");
+
+	if (name[len] != '.')
+		return NULL;
+	for (pg = diff_pages; pg->key; pg++) {
+		if ((strlen(pg->key) == len && !strncmp(pg->key, name, len)) ||
+				(pg->alias && strlen(pg->alias) == len && !strncmp(pg->alias, name, len))) {
+			*page = pg - diff_pages;
+			return diff_field_find(pg->fields, name + len + 1, i);
+		}
+	}
+	return NULL;
+}
+
+int nvmed_info_field_page_len (int page)
+{
+	return diff_pages[page].len;
+}
+
+// Decodes a raw page and formats one field as a JSON value
+int nvmed_info_field_format (int page, const __u8 *raw, struct diff_field *f, int i, char *out, int len)
+{
+	struct diff_page *pg = &diff_pages[page];
+	const __u8 *v;
+	__u8 *d;
+	int j, n = 0;
+
+	d = (__u8 *) malloc(pg->size);
+	if (d == NULL)
+		return -1;
+	pg->decode(raw, d);
+	v = d + f->member + i * f->member_stride;
+
+	switch (f->type) {
+		case DIFF_STR:
+			n = snprintf(out, len, "\"");
+			for (j = 0; v[j] && n < len - 3; j++)
+				if (v[j] >= 0x20 && v[j] < 0x7f && v[j] != '"' && v[j] != '\\')
+					out[n++] = v[j];
+			n += snprintf(out + n, len - n, "\"");
+			break;
+		case DIFF_BYTES:
+			n = snprintf(out, len, "\"");
+			for (j = 0; j < f->len && n < len - 3; j++)
+				n += snprintf(out + n, len - n, "%02x", v[j]);
+			n += snprintf(out + n, len - n, "\"");
+			break;
+		default:
+			n = snprintf(out, len, "%llu", (unsigned long long) nvmed_info_diff_value(v, f->type));
+			break;
+	}
+	free(d);
+	return n;
+}
+
+#define DIFF_BLOCK		64
+
+// Returns a bitmap of the 64-byte blocks that differ, comparing 64 bits at a
+// time; pages are at most 64 blocks long and 8-byte aligned in the snapshot.
+static __u64 diff_blocks (const __u8 *a, const __u8 *b, int len)
+{
+	const __u64 *x = (const __u64 *) a;
+	const __u64 *y = (const __u64 *) b;
+	__u64 map = 0;
+	int i, words = DIFF_BLOCK / sizeof(__u64);
+
+	for (i = 0; i < len / (int) sizeof(__u64); i++) {
+		if (x[i] != y[i]) {
+			map |= 1ULL << (i / words);
+			i |= words - 1;				// skip the rest of the block
+		}
+	}
+	return map;
+}
+
+static int diff_touched (__u64 map, int off, int len)
+{
+	int b;
+
+	for (b = off / DIFF_BLOCK; b <= (off + len - 1) / DIFF_BLOCK; b++)
+		if (map & (1ULL << b))
+			return 1;
+	return 0;
+}
+
+__u64 nvmed_info_diff_value (const __u8 *d, int type)
+{
+	switch (type) {
+		case DIFF_U8:	return *d;
+		case DIFF_U16:	return *((const __u16 *) d);
+		case DIFF_U32:	return *((const __u32 *) d);
+		case DIFF_U64:	return *((const __u64 *) d);
+		case DIFF_INT:	return *((const int *) d);
+	}
+	return 0;
+}
+
+static void diff_print_bytes (const __u8 *d, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		P ("%02x", d[i]);
+}
+
+// Prints one field if it changed; returns 1 if it did
+static int diff_field_print (struct diff_field *f, const char *name, const __u8 *a, const __u8 *b)
+{
+	__u64 va, vb;
+
+	switch (f->type) {
+		case DIFF_STR:
+			if (!strcmp((const char *) a, (const char *) b))
+				return 0;
+			P ("  %-24s \"%s\" -> \"%s\"\n", name, a, b);
+			return 1;
+
+		case DIFF_BYTES:
+			if (!memcmp(a, b, f->len))
+				return 0;
+			P ("  %-24s ", name);
+			diff_print_bytes(a, f->len);
+			P (" -> ");
+			diff_print_bytes(b, f->len);
+			P ("\n");
+			return 1;
+	}
+
+	va = nvmed_info_diff_value(a, f->type);
+	vb = nvmed_info_diff_value(b, f->type);
+	if (va == vb)
+		return 0;
+	if (f->hex)
+		P ("  %-24s %#20llx -> %#-20llx\n", name, (unsigned long long) va, (unsigned long long) vb);
+	else
+		P ("  %-24s %20llu -> %-20llu (%+lld)\n", name, (unsigned long long) va,
+			(unsigned long long) vb, (long long) (vb - va));
+	return 1;
+}
+
+static int diff_page (struct diff_page *pg, const __u8 *a, const __u8 *b, int *blocks)
+{
+	struct diff_field *f;
+	__u8 *da, *db;
+	char name[64];
+	__u64 map;
+	int i, off, changed = 0;
+
+	map = diff_blocks(a, b, pg->len);
+	*blocks += __builtin_popcountll(map);
+	if (map == 0)
+		return 0;
+
+	da = (__u8 *) malloc(pg->size);
+	db = (__u8 *) malloc(pg->size);
+	if (da == NULL || db == NULL) {
+		printf("Memory allocation failed.\n");
+		free(da);
+		free(db);
+		return -1;
+	}
+	pg->decode(a, da);
+	pg->decode(b, db);
+
+	P ("[%s]\n", pg->title);
+	for (f = pg->fields; f->name; f++) {
+		for (i = 0; i < f->count; i++) {
+			off = f->off + i * f->stride;
+			if (!diff_touched(map, off, f->len))
+				continue;
+			if (f->count > 1)
+				snprintf(name, sizeof(name), "%.*s[%d]%s", (int) strcspn(f->name, "."), f->name,
+					i, f->name + strcspn(f->name, "."));
+			else
+				snprintf(name, sizeof(name), "%s", f->name);
+			changed += diff_field_print(f, name,
+					da + f->member + i * f->member_stride, db + f->member + i * f->member_stride);
+		}
+	}
+	P ("\n");
+
+	free(da);
+	free(db);
+	return changed;
+}
+
+static void diff_print_source (const char *label, const char *name, struct snapshot *s)
+{
+	time_t t = le64toh(s->time);
+	char when[32];
+
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+	P ("%s: %s (namespace %u, %s)\n", label, name, le32toh(s->nsid), when);
+}
+
+// Usage: diff <A> [B]; without B, A is compared with the live device
+int nvmed_info_diff (NVMED *nvmed, char **cmd_args)
+{
+	struct snapshot *a, *b;
+	struct diff_page *pg;
+	int rc, changed = 0, blocks = 0, total = 0;
+
+	if (cmd_args == NULL || cmd_args[0] == NULL || (nvmed == NULL && cmd_args[1] == NULL)) {
+		printf("Usage: nvmed_info diff <snapshot A> <snapshot B>\n");
+		printf("       nvmed_info <device_path> diff <snapshot A> [snapshot B]\n");
+		return -1;
+	}
+
+	a = (struct snapshot *) malloc(sizeof(*a));
+	b = (struct snapshot *) malloc(sizeof(*b));
+	if (a == NULL || b == NULL) {
+		printf("Memory allocation failed.\n");
+		rc = -1;
+		goto out;
+	}
+
+	rc = nvmed_info_snapshot_load(cmd_args[0], a);
+	if (rc == 0) {
+		if (cmd_args[1])
+			rc = nvmed_info_snapshot_load(cmd_args[1], b);
+		else
+			rc = nvmed_info_snapshot_capture(nvmed, le32toh(a->nsid), b);
+	}
+	if (rc < 0)
+		goto out;
+
+	PRINT_NVMED_INFO;
+	diff_print_source("A", cmd_args[0], a);
+	diff_print_source("B", cmd_args[1]? cmd_args[1] : nvmed_info_ctx_path(dev_info), b);
+	P ("\n");
+
+	// The link is not kept in snapshots
+	for (pg = diff_pages; pg < diff_pages + FIELD_PAGE_LINK; pg++) {
+		rc = diff_page(pg, (__u8 *) a + pg->off, (__u8 *) b + pg->off, &blocks);
+		if (rc < 0)
+			goto out;
+		changed += rc;
+		total += (pg->len + DIFF_BLOCK - 1) / DIFF_BLOCK;
+	}
+
+	if (changed == 0)
+		P ("No decoded field changed\n");
+	P ("%d field%s changed (%d of %d blocks differ)\n\n", changed, (changed == 1)? "" : "s",
+		blocks, total);
+	rc = 0;
+
+out:
+	free(a);
+	free(b);
+	return rc;
+}
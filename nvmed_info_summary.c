@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+static char summary_value[64];
+
+static void summary_row (const char *title, const char *src, const char *fmt, ...)
+	__attribute__ ((format (printf, 3, 4)));
+
+static void summary_row (const char *title, const char *src, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (src == NULL) {
+		P ("%-40s  %-42s  %s\n", title, "-", "-");
+		return;
+	}
+	va_start(ap, fmt);
+	vsnprintf(summary_value, sizeof(summary_value), fmt, ap);
+	va_end(ap);
+	P ("%-40s  %-42s  %s\n", title, summary_value, src);
+}
+
+static const char *summary_bytes (__u64 v)
+{
+	static char s[32];
+	static const char *units[] = { "B", "KB", "MB", "GB", "TB", "PB" };
+	double d = v;
+	int u = 0;
+
+	while (d >= 1000 && u < 5) {
+		d /= 1000;
+		u++;
+	}
+	snprintf(s, sizeof(s), "%.1f %s", d, units[u]);
+	return s;
+}
+
+// Usage: summary [--sysfs-only]
+// Fills the controller summary from sysfs, which needs neither root nor the
+// nvmed module, and falls back to admin commands only for what the kernel
+// does not expose, when the device can be opened for them.
+int nvmed_info_summary (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_inventory inv;
+	struct nvmed_info_controller ctrl;
+	struct nvmed_info_namespace ns;
+	struct nvmed_info_link link;
+	const char *path = nvmed_info_ctx_path(dev_info);
+	const char *admin = "admin", *sysfs = "sysfs", *src;
+	int admin_ok, have_ctrl = 0, have_ns = 0, have_link = 0;
+	__u32 queues = 0;
+	int rc, lbads;
+
+	memset(&ctrl, 0, sizeof(ctrl));
+	memset(&ns, 0, sizeof(ns));
+	memset(&link, 0, sizeof(link));
+	if (nvmed_info_read_inventory(path, &inv))
+		printf("%s: no controller under /sys/class/nvme\n", path);
+
+	// Admin commands need write access to the device
+	admin_ok = !nvmed_info_opt_flag(cmd_args, "--sysfs-only") && access(path, R_OK | W_OK) == 0;
+	if (admin_ok) {
+		have_ctrl = (nvmed_info_read_controller(dev_info, &ctrl) == 0);
+		if (have_ctrl && !(inv.valid & NVMED_INFO_INV_NAMESPACE))
+			have_ns = (nvmed_info_read_namespace(dev_info, inv.nsid? inv.nsid : 1, &ns) == 0);
+		if (!(inv.valid & NVMED_INFO_INV_LINK))
+			have_link = (nvmed_info_read_link(dev_info, &link) == 0);
+		if (!(inv.valid & NVMED_INFO_INV_QUEUES) &&
+				nvmed_info_ctx_get_feature(dev_info, FEATURE_NUMBER_OF_QUEUES, FEATURE_SEL_CURRENT,
+					0, 0, NULL, 0, &queues) == 0)
+			queues = (queues & 0xffff) + 1;
+	}
+
+	PRINT_NVMED_INFO;
+	P ("Controller Summary (%s%s%s)\n", path, inv.ctrl[0]? ", " : "", inv.ctrl);
+	P ("Field                                     Value                                       Source\n");
+	P ("----------------------------------------  ------------------------------------------  ------\n");
+
+	P ("\n[Identity]\n");
+	src = (inv.valid & NVMED_INFO_INV_IDENTITY)? sysfs : have_ctrl? admin : NULL;
+	summary_row("Model Number (MN)", src, "%s", (src == sysfs)? inv.mn : ctrl.mn);
+	summary_row("Serial Number (SN)", src, "%s", (src == sysfs)? inv.sn : ctrl.sn);
+	summary_row("Firmware Revision (FR)", src, "%s", (src == sysfs)? inv.fr : ctrl.fr);
+	src = (inv.valid & NVMED_INFO_INV_PCI)? sysfs : have_ctrl? admin : NULL;
+	summary_row("PCI Vendor ID (VID)", src, "0x%04x", (src == sysfs)? inv.vid : ctrl.vid);
+	summary_row("PCI Subsystem Vendor ID (SSVID)", src, "0x%04x", (src == sysfs)? inv.ssvid : ctrl.ssvid);
+	src = (inv.valid & NVMED_INFO_INV_CNTLID)? sysfs : have_ctrl? admin : NULL;
+	summary_row("Controller ID (CNTLID)", src, "0x%x", (src == sysfs)? inv.cntlid : ctrl.cntlid);
+	src = have_ctrl? admin : NULL;
+	summary_row("Version (VER)", src, "%d.%d.%d", (ctrl.ver >> 16) & 0xffff, (ctrl.ver >> 8) & 0xff, ctrl.ver & 0xff);
+	summary_row("Maximum Data Transfer Size (MDTS)", src, "%d %s", ctrl.mdts, ctrl.mdts? "(2^n pages)" : "(No restriction)");
+	summary_row("Number of Namespaces (NN)", src, "%u", ctrl.nn);
+	summary_row("Number of Power States (NPSS + 1)", src, "%d", ctrl.npss + 1);
+	summary_row("Warning / Critical Temperature", src, "%d / %d C", ctrl.wctemp - 273, ctrl.cctemp - 273);
+
+	P ("\n[PCI Express]\n");
+	src = (inv.valid & NVMED_INFO_INV_PCI)? sysfs : NULL;
+	summary_row("PCI Address", src, "%s", inv.address);
+	summary_row("NUMA Node", src, "%d", inv.numa_node);
+	src = (inv.valid & NVMED_INFO_INV_LINK)? sysfs : have_link? admin : NULL;
+	if (src == sysfs)
+		link = inv.link;
+	summary_row("Link Speed (current / max)", src, "Gen%d / Gen%d", link.cur_speed, link.max_speed);
+	summary_row("Link Width (current / max)", src, "x%d / x%d", link.cur_width, link.max_width);
+
+	P ("\n[Queues]\n");
+	src = (inv.valid & NVMED_INFO_INV_QUEUES)? sysfs : queues? admin : NULL;
+	summary_row("I/O Queues", src, "%u", (src == sysfs)? inv.queue_count : queues);
+	src = (inv.valid & NVMED_INFO_INV_QUEUES)? sysfs : NULL;
+	summary_row("Queue Size (entries)", src, "%u", inv.queue_size);
+
+	P ("\n[Namespace]\n");
+	src = (inv.valid & NVMED_INFO_INV_NAMESPACE)? sysfs : have_ns? admin : NULL;
+	if (src == admin) {
+		lbads = ns.lbaf[ns.flbas & 0xf].lbads;
+		inv.lba_size = 1U << lbads;
+		inv.capacity = ns.nsze << lbads;
+	}
+	summary_row("Capacity", src, "%s", summary_bytes(inv.capacity));
+	summary_row("Logical Block Size", src, "%u bytes", inv.lba_size);
+	src = (inv.valid & NVMED_INFO_INV_VWC)? sysfs : have_ctrl? admin : NULL;
+	summary_row("Volatile Write Cache", src, "%s", (src == sysfs)? (inv.vwc? "Enabled" : "Disabled") :
+		(ctrl.vwc & 0x1)? "Present" : "Not present");
+
+	rc = (inv.valid || have_ctrl)? 0 : -1;
+	if (!admin_ok)
+		P ("\nAdmin fallback skipped (%s); fields shown as \"-\" need it\n",
+			nvmed_info_opt_flag(cmd_args, "--sysfs-only")? "--sysfs-only" : "no write access to the device");
+	P ("\n\n");
+	return rc;
+}
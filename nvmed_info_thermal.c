@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nvme_hdr.h"
+#include "nvmed.h"
+#include "lib_nvmed.h"
+#include "nvmed_info.h"
+
+
+struct nvmed_info_cmd thermal_cmds[] = {
+	{"report", 3, "Temperatures, thresholds and time throttled", nvmed_info_thermal_report},
+	{"set", 1, "Set an over or under temperature threshold", nvmed_info_thermal_set},
+	{"reset", 3, "Restore the default thresholds of a sensor", nvmed_info_thermal_reset},
+	{NULL, 0, NULL, NULL}
+};
+
+#define KELVIN				273
+#define THERMAL_SENSORS		9			// TMPSEL 0 is the composite temperature
+
+// Temperature Threshold, CDW11 (Figure 116, p.128)
+#define THSEL_OVER			0
+#define THSEL_UNDER			1
+#define TT_CDW11(tmpsel, thsel, tmpth)	(((thsel) << 20) | ((tmpsel) << 16) | (tmpth))
+
+// Asynchronous Event Configuration: temperature critical warning
+#define AEC_TEMPERATURE		(1 << 1)
+
+// SMART / Health: thermal management fields added in NVMe 1.3
+struct thermal_smart {
+	struct nvmed_info_smart s;
+	__u32 tmt_count[2];					// Thermal Management Temperature 1/2 Transition Count
+	__u32 tmt_time[2];					// Total Time for TMT 1/2 (seconds)
+};
+
+static int thermal_read_smart (struct thermal_smart *t)
+{
+	__u8 *p = (__u8 *) nvmed_info_ctx_buffer(dev_info);
+	int rc;
+
+	if (p == NULL)
+		return -1;
+	rc = nvmed_info_ctx_get_log(dev_info, LOG_SMART_INFO, 0, p, 512);
+	if (rc)
+		return rc;
+	nvmed_info_decode_smart(p, &t->s);
+	t->tmt_count[0] = U32(216);
+	t->tmt_count[1] = U32(220);
+	t->tmt_time[0] = U32(224);
+	t->tmt_time[1] = U32(228);
+	return 0;
+}
+
+// Returns the threshold in Kelvin, or -1 if it cannot be read
+static int thermal_threshold (int tmpsel, int thsel, int sel)
+{
+	__u32 res;
+
+	if (nvmed_info_ctx_get_feature(dev_info, FEATURE_TEMPERATURE_THRESHOLD, sel, 0,
+			TT_CDW11(tmpsel, thsel, 0), NULL, 0, &res))
+		return -1;
+	return res & 0xffff;
+}
+
+static const char *thermal_name (int tmpsel)
+{
+	static char s[24];
+
+	if (tmpsel == 0)
+		return "Composite";
+	snprintf(s, sizeof(s), "Sensor %d", tmpsel);
+	return s;
+}
+
+// Thresholds of 0 (under) and 0xffff (over) are the disabled defaults
+static const char *thermal_celsius (int k, int disabled)
+{
+	static char s[4][16];
+	static int i;
+
+	i = (i + 1) % 4;
+	if (k < 0 || k == disabled)
+		snprintf(s[i], sizeof(s[i]), "-");
+	else
+		snprintf(s[i], sizeof(s[i]), "%d C", k - KELVIN);
+	return s[i];
+}
+
+int nvmed_info_thermal (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_cmd *c;
+
+	if (cmd_args[0] == NULL || cmd_args[0][0] == '-')
+		return nvmed_info_thermal_report(nvmed, cmd_args);
+
+	c = cmd_lookup(thermal_cmds, cmd_args[0]);
+	if (c)
+		return c->cmd_fn(nvmed, &cmd_args[1]);
+	else {
+		nvmed_info_thermal_help(cmd_args[0]);
+		return -1;
+	}
+}
+
+int nvmed_info_thermal_help (char *s)
+{
+	return cmd_help(s, "THERMAL subcommands", thermal_cmds);
+}
+
+// Usage: thermal report [--interval-s N]
+// With an interval, SMART / Health is read again after N seconds and the
+// time spent throttling in between is shown next to the lifetime totals.
+int nvmed_info_thermal_report (NVMED *nvmed, char **cmd_args)
+{
+	struct nvmed_info_controller ctrl;
+	struct thermal_smart t0, t1;
+	int i, k, over, under, hottest = -1, rc;
+	long interval;
+	__u32 aec = 0, hctm = 0, d;
+
+	interval = nvmed_info_opt_long(cmd_args, "--interval-s", 0);
+	if (interval < 0) {
+		printf("--interval-s must not be negative\n");
+		return -1;
+	}
+	rc = nvmed_info_read_controller(dev_info, &ctrl);
+	if (rc == 0)
+		rc = thermal_read_smart(&t0);
+	if (rc) {
+		printf("Cannot read the controller information (%d)\n", rc);
+		return -1;
+	}
+	t1 = t0;
+	if (interval) {
+		sleep(interval);
+		rc = thermal_read_smart(&t1);
+		if (rc) {
+			printf("GET LOG PAGE (SMART / Health Information) failed (%d)\n", rc);
+			return -1;
+		}
+	}
+	if (ctrl.hctma & 0x1)
+		nvmed_info_ctx_get_feature(dev_info, FEATURE_HOST_THERMAL_MGMT, FEATURE_SEL_CURRENT, 0, 0,
+			NULL, 0, &hctm);
+	nvmed_info_ctx_get_feature(dev_info, FEATURE_ASYNC_EVENT_CONFIG, FEATURE_SEL_CURRENT, 0, 0,
+		NULL, 0, &aec);
+
+	PRINT_NVMED_INFO;
+	P ("THERMAL (%s)\n", nvmed_info_ctx_path(dev_info));
+
+	P ("\n[Controller]\n");
+	P ("%-44s  %s\n", "Warning Composite Temperature (WCTEMP)", thermal_celsius(ctrl.wctemp, 0));
+	P ("%-44s  %s\n", "Critical Composite Temperature (CCTEMP)", thermal_celsius(ctrl.cctemp, 0));
+	if (ctrl.hctma & 0x1) {
+		P ("%-44s  %s .. %s\n", "Thermal Management Temperature range", thermal_celsius(ctrl.mntmt, 0),
+			thermal_celsius(ctrl.mxtmt, 0));
+		P ("%-44s  %s / %s\n", "Host Controlled TMT1 / TMT2", thermal_celsius(hctm >> 16, 0),
+			thermal_celsius(hctm & 0xffff, 0));
+	} else
+		P ("%-44s  %s\n", "Host Controlled Thermal Management", "Not supported");
+	P ("%-44s  %s\n", "Temperature warning (SMART Critical Warning)",
+		(t1.s.critical_warning & 0x2)? "SET" : "Clear");
+
+	P ("\n[Sensors]\n");
+	P ("Sensor      Current  Over Threshold  Under Threshold  Headroom\n");
+	P ("----------  -------  --------------  ---------------  --------\n");
+	for (i = 0; i < THERMAL_SENSORS; i++) {
+		k = i? t1.s.temp_sensor[i-1] : t1.s.composite_temp;
+		if (k == 0)
+			continue;
+		over = thermal_threshold(i, THSEL_OVER, FEATURE_SEL_CURRENT);
+		under = thermal_threshold(i, THSEL_UNDER, FEATURE_SEL_CURRENT);
+		// Headroom is to the lower of the over threshold and, for the
+		// composite temperature, WCTEMP, where throttling begins
+		if (i == 0 && ctrl.wctemp && (over < 0 || over == 0xffff || ctrl.wctemp < over))
+			over = ctrl.wctemp;
+		P ("%-10s  %5d C  %14s  %15s  ", thermal_name(i), k - KELVIN, thermal_celsius(over, 0xffff),
+			thermal_celsius(under, 0));
+		if (over > 0 && over != 0xffff)
+			P ("%6d C\n", over - k);
+		else
+			P ("%8s\n", "-");
+		if (i && (hottest < 0 || k > t1.s.temp_sensor[hottest-1]))
+			hottest = i;
+	}
+	if (hottest > 0)
+		P ("Hottest sensor: %s at %d C\n", thermal_name(hottest), t1.s.temp_sensor[hottest-1] - KELVIN);
+
+	P ("\n%-44s  %8s", "[Time Throttled]", "Lifetime");
+	if (interval)
+		P ("  %9s", "Interval");
+	P ("\n");
+	P ("%-44s  %8u", "Warning Composite Temperature Time (min)", t1.s.warning_temp_time);
+	if (interval)
+		P ("  %9u", t1.s.warning_temp_time - t0.s.warning_temp_time);
+	P ("\n%-44s  %8u", "Critical Composite Temperature Time (min)", t1.s.critical_temp_time);
+	if (interval)
+		P ("  %9u", t1.s.critical_temp_time - t0.s.critical_temp_time);
+	P ("\n");
+	for (i = 0; i < 2; i++) {
+		P ("%-44s  %8u", i? "Thermal Management Temperature 2 Time (s)" :
+			"Thermal Management Temperature 1 Time (s)", t1.tmt_time[i]);
+		if (interval) {
+			d = t1.tmt_time[i] - t0.tmt_time[i];
+			P ("  %9u (%.0f%%)", d, 100.0 * d / interval);
+		}
+		P ("\n%-44s  %8u", i? "Thermal Management Temperature 2 Transitions" :
+			"Thermal Management Temperature 1 Transitions", t1.tmt_count[i]);
+		if (interval)
+			P ("  %9u", t1.tmt_count[i] - t0.tmt_count[i]);
+		P ("\n");
+	}
+
+	P ("\n[Notes]\n");
+	if (ctrl.wctemp && t1.s.composite_temp >= ctrl.wctemp)
+		P ("  - The composite temperature is at or above WCTEMP; the controller may be throttling.\n");
+	if (interval && (t1.tmt_time[0] != t0.tmt_time[0] || t1.tmt_time[1] != t0.tmt_time[1] ||
+			t1.s.warning_temp_time != t0.s.warning_temp_time))
+		P ("  - The controller throttled during the last %ld s; throughput drops in that window\n"
+		   "    are likely thermal.\n", interval);
+	if (t1.tmt_time[1])
+		P ("  - %u s were spent at TMT2, where the controller throttles heavily.\n", t1.tmt_time[1]);
+	if (!(aec & AEC_TEMPERATURE))
+		P ("  - Temperature events are disabled (AEC bit 1); \"thermal set\" enables them.\n");
+	P ("  - Thresholds set with \"thermal set\" raise an asynchronous event when crossed;\n"
+	   "    \"events\" waits for them.\n");
+	P ("\n\n");
+	return 0;
+}
+
+// Usage: thermal set [--sensor N] [--over C] [--under C] [--save]
+// Temperatures are in Celsius; the temperature critical warning is enabled
+// in the Asynchronous Event Configuration so that a crossing raises an AER.
+int nvmed_info_thermal_set (NVMED *nvmed, char **cmd_args)
+{
+	long sensor, over, under;
+	int save, rc, thsel;
+	long c;
+	__u32 aec;
+
+	sensor = nvmed_info_opt_long(cmd_args, "--sensor", 0);
+	over = nvmed_info_opt_long(cmd_args, "--over", -KELVIN - 1);
+	under = nvmed_info_opt_long(cmd_args, "--under", -KELVIN - 1);
+	save = nvmed_info_opt_flag(cmd_args, "--save");
+	if (sensor < 0 || sensor >= THERMAL_SENSORS) {
+		printf("--sensor must be between 0 (composite) and %d\n", THERMAL_SENSORS - 1);
+		return -1;
+	}
+	if (over < -KELVIN && under < -KELVIN) {
+		printf("Give --over C and/or --under C\n");
+		return -1;
+	}
+
+	for (thsel = THSEL_OVER; thsel <= THSEL_UNDER; thsel++) {
+		c = (thsel == THSEL_OVER)? over : under;
+		if (c < -KELVIN)
+			continue;
+		rc = nvmed_info_ctx_set_feature(dev_info, FEATURE_TEMPERATURE_THRESHOLD, 0,
+				TT_CDW11(sensor, thsel, (__u32) (c + KELVIN) & 0xffff), save, NULL, 0, NULL);
+		if (rc) {
+			printf("SET FEATURES Temperature Threshold failed (%d)\n", rc);
+			return -1;
+		}
+		P ("%s %s threshold set to %ld C%s\n", thermal_name(sensor),
+			(thsel == THSEL_OVER)? "over" : "under", c, save? " (saved)" : "");
+	}
+
+	rc = nvmed_info_ctx_get_feature(dev_info, FEATURE_ASYNC_EVENT_CONFIG, FEATURE_SEL_CURRENT, 0, 0,
+			NULL, 0, &aec);
+	if (rc == 0 && !(aec & AEC_TEMPERATURE)) {
+		rc = nvmed_info_ctx_set_feature(dev_info, FEATURE_ASYNC_EVENT_CONFIG, 0, aec | AEC_TEMPERATURE,
+				save, NULL, 0, NULL);
+		if (rc == 0)
+			P ("Temperature events enabled in the Asynchronous Event Configuration\n");
+	}
+	if (rc)
+		printf("Enabling temperature events failed (%d)\n", rc);
+	return rc? -1 : 0;
+}
+
+// Usage: thermal reset [--sensor N] [--save]
+int nvmed_info_thermal_reset (NVMED *nvmed, char **cmd_args)
+{
+	long sensor;
+	int thsel, k, rc;
+
+	sensor = nvmed_info_opt_long(cmd_args, "--sensor", 0);
+	if (sensor < 0 || sensor >= THERMAL_SENSORS) {
+		printf("--sensor must be between 0 (composite) and %d\n", THERMAL_SENSORS - 1);
+		return -1;
+	}
+
+	for (thsel = THSEL_OVER; thsel <= THSEL_UNDER; thsel++) {
+		k = thermal_threshold(sensor, thsel, FEATURE_SEL_DEFAULT);
+		if (k < 0) {
+			printf("Reading the default %s threshold failed\n", (thsel == THSEL_OVER)? "over" : "under");
+			return -1;
+		}
+		rc = nvmed_info_ctx_set_feature(dev_info, FEATURE_TEMPERATURE_THRESHOLD, 0,
+				TT_CDW11(sensor, thsel, k), nvmed_info_opt_flag(cmd_args, "--save"), NULL, 0, NULL);
+		if (rc) {
+			printf("SET FEATURES Temperature Threshold failed (%d)\n", rc);
+			return -1;
+		}
+		P ("%s %s threshold restored to %s\n", thermal_name(sensor),
+			(thsel == THSEL_OVER)? "over" : "under",
+			thermal_celsius(k, (thsel == THSEL_OVER)? 0xffff : 0));
+	}
+	return 0;
+}
@@ -39,7 +39,7 @@ int nvmed_info_admin_command (NVMED *nvmed, struct nvme_admin_cmd *cmd)
 {
 	int rc;
 
-	rc = ioctl (dev_fd, NVME_IOCTL_ADMIN_CMD, cmd);
+	rc = nvmed_info_ctx_admin (dev_info, cmd);
 	if (rc < 0) {
 		printf("ioctl() failed, rc = %d.\n", rc);
 		return -1;
@@ -84,6 +84,31 @@ int cmd_help (char *invalid_cmd, char *cmd_name, struct nvmed_info_cmd *c)
 	return -1;
 }
 
+// Parses "--name value" style options; returns the value or def if absent.
+long nvmed_info_opt_long (char **cmd_args, char *name, long def)
+{
+	int i;
+
+	if (cmd_args == NULL)
+		return def;
+	for (i = 0; cmd_args[i]; i++)
+		if (!strcmp(cmd_args[i], name) && cmd_args[i+1])
+			return strtol(cmd_args[i+1], NULL, 0);
+	return def;
+}
+
+int nvmed_info_opt_flag (char **cmd_args, char *name)
+{
+	int i;
+
+	if (cmd_args == NULL)
+		return 0;
+	for (i = 0; cmd_args[i]; i++)
+		if (!strcmp(cmd_args[i], name))
+			return 1;
+	return 0;
+}
+
 #if 0
 void *alloc_buffer (int bytes)
 {
@@ -119,18 +144,18 @@ void print_bytes (__u8 *p, int n)
 	{
 		col = ((n - i) >= BYTES_PER_LINE)? BYTES_PER_LINE : (n - i);
 
-		printf ("[%04x] %04d: ", i, i);
+		P ("[%04x] %04d: ", i, i);
 		for (j = 0; j < col; j++)
-			printf ("%02x ", p[i+j]);
+			P ("%02x ", p[i+j]);
 		for (j = col; j < BYTES_PER_LINE; j++)
-			printf ("   ");
+			P ("   ");
 
-		printf ("   ");
+		P ("   ");
 		for (j = 0; j < col; j++)
-			printf ("%1c", (isprint (p[i+j]))? p[i+j] : '.');
+			P ("%1c", (isprint (p[i+j]))? p[i+j] : '.');
 		for (j = col; j < BYTES_PER_LINE; j++)
-			printf (" ");
-		printf ("\n");
+			P (" ");
+		P ("\n");
 	}
 }
 
@@ -145,16 +170,16 @@ void print_something (enum print_format format, __u8 *p, int offset, int end, ch
 	for (i = offset; i < end; i += 4)
 	{
 		if (i == offset)
-			printf ("%04d:%04d  ", offset, end);
+			P ("%04d:%04d  ", offset, end);
 		else
-			printf ("           ");
+			P ("           ");
 
 		col = ((end + 1 - i) < 4)? (end + 1 - i) : 4;
 		for (j = 0; j < col; j++)
-			printf ("%02x ", p[i+j]);
+			P ("%02x ", p[i+j]);
 		for (j = col; j < 4; j++)
-			printf ("  ");
-		printf (" ");
+			P ("  ");
+		P (" ");
 		switch (format)
 		{
 			case FORMAT_STRING:
@@ -162,20 +187,20 @@ void print_something (enum print_format format, __u8 *p, int offset, int end, ch
 				{
 					strncpy (s, (char *) &p[offset], end + 1 - offset);
 					s[end + 1 - offset] = '\0';
-					printf ("%s: %s", title, s);
+					P ("%s: %s", title, s);
 				}
 				break;
 
 			case FORMAT_ID:
 				if (i == offset)
-					printf ("%s:", title);
+					P ("%s:", title);
 				if (((i == offset) && (end + 1 - offset) <= 4) || (i == offset + 4))
 				{
 					for (j = end; j >= offset; j--)
 					{
-						printf ("%02x", p[j]);
+						P ("%02x", p[j]);
 						if (j != offset)
-							printf ("-");
+							P ("-");
 					}
 				}
 				break;
@@ -186,14 +211,14 @@ void print_something (enum print_format format, __u8 *p, int offset, int end, ch
 					value = 0;
 					for (j = end; j >= offset; j--)
 					value = (value << 8) + p[j];
-					printf ("%s: %llu %s", title, value, unit);
+					P ("%s: %llu %s", title, value, unit);
 				}
 				break;
 
 			default:
-				printf ("UNKNOWN FORMAT");
+				P ("UNKNOWN FORMAT");
 		}
-		printf ("\n");
+		P ("\n");
 	}
 }
 